@@ -1,14 +1,17 @@
 #include <iostream>
 #include <memory>
 #include <unistd.h>
+#include <sys/resource.h>
 
 #include "./src/core.h"
 #include "./src/fs.h"
 #include "./src/parser2.h"
+#include "./src/loader.h"
 #include "./src/checker/vm2.h"
 #include "./src/checker/module2.h"
 #include "./src/checker/debug.h"
 #include "./src/checker/compiler.h"
+#include "./src/checker/archive.h"
 
 using namespace tr;
 
@@ -39,8 +42,183 @@ void compileAndRun(const string &code, const string &fileName) {
     std::cout << fmt::format("typerunner: {} iterations (it): cold {:.9f}ms/it, warm {:.9f}ms/it\n", iterations, cold.count() / iterations, warm.count() / iterations);
 }
 
+/**
+ * bench --archive <files...>
+ *
+ * Compares the startup of loading all modules from individual .tsb files against loading them from one archive.
+ */
+int archiveStartup(int argc, char *argv[]) {
+    auto dir = std::filesystem::temp_directory_path() / fmt::format("typerunner-bench-{}", getpid());
+    std::filesystem::create_directories(dir);
+
+    vector<string> paths;
+    vector<string> binFiles;
+    checker::ArchiveWriter writer;
+    for (auto i = 2; i<argc; i++) {
+        string file = argv[i];
+        if (!fileExists(file)) {
+            std::cout << "File not found " << file << "\n";
+            return 4;
+        }
+        auto code = fileRead(file);
+        checker::Compiler compiler;
+        Parser parser;
+        auto result = parser.parseSourceFile(file, code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+        auto bin = compiler.compileSourceFile(result).build();
+
+        auto binFile = (dir / fmt::format("{}.tsb", i)).string();
+        fileWrite(binFile, bin);
+        binFiles.push_back(binFile);
+        //the same path in several arguments still measures one load per argument
+        auto path = fmt::format("{}:{}", i, file);
+        writer.add(path, std::move(bin));
+        paths.push_back(path);
+    }
+    auto archiveFile = (dir / "modules.tsa").string();
+    writer.write(archiveFile);
+
+    auto iterations = 100;
+    auto individual = benchRun(iterations, [&] {
+        for (auto &&binFile: binFiles) {
+            auto mapped = fileMap(binFile);
+            auto module = std::make_shared<vm2::Module>(mapped->view(), mapped, binFile, "");
+            vm2::parseHeader(module);
+        }
+    });
+    auto archived = benchRun(iterations, [&] {
+        auto archive = checker::Archive::open(archiveFile);
+        for (auto &&path: paths) {
+            auto module = archive->module(path);
+            vm2::parseHeader(module);
+        }
+    });
+
+    std::cout << fmt::format("{} modules, {} iterations (it): individual files {:.9f}ms/it, archive {:.9f}ms/it\n", paths.size(), iterations, individual.count() / iterations, archived.count() / iterations);
+    std::filesystem::remove_all(dir);
+    return 0;
+}
+
+void parseThroughput(const string &fileName, const string &code) {
+    //about 100 MB per measurement, so multi-megabyte files finish too
+    auto iterations = std::clamp<int>(100'000'000 / std::max<size_t>(code.size(), 1), 10, 1000);
+    auto took = benchRun(iterations, [&] {
+        Parser parser;
+        auto result = parser.parseSourceFile(fileName, code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+    });
+    auto seconds = took.count() / 1000;
+    std::cout << fmt::format("{}: {} bytes, {} iterations (it): {:.9f}ms/it, {:.2f} MB/s\n", fileName, code.size(), iterations, took.count() / iterations, code.size() * iterations / seconds / 1024 / 1024);
+}
+
+/**
+ * bench --parse <file>
+ *
+ * Parse throughput, including freeing the AST. A .d.ts file is also parsed as .ts, to compare the
+ * declaration file path of the parser with the general one.
+ */
+int parseThroughput(const string &file) {
+    if (!fileExists(file)) {
+        std::cout << "File not found " << file << "\n";
+        return 4;
+    }
+    auto code = fileRead(file);
+    parseThroughput(file, code);
+    if (fileExtensionIs(file, ".d.ts")) parseThroughput(file.substr(0, file.size() - 5) + ".ts", code);
+    return 0;
+}
+
+/**
+ * bench --load [--read] <dir>
+ *
+ * Parses all .ts files in `dir` and keeps their SourceFiles alive, like loading a project. Files are memory-mapped
+ * (Parser::parseFile()), or with --read first read into a string (fileRead()). Peak RSS is per process,
+ * so run both variants separately to compare it.
+ */
+int loadDirectory(int argc, char *argv[]) {
+    auto read = argc>3 && string_view(argv[2]) == "--read";
+    string dir = argv[read ? 3 : 2];
+    vector<string> files;
+    for (auto &&entry: std::filesystem::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file() && fileExtensionIs(entry.path().string(), ".ts")) files.push_back(entry.path().string());
+    }
+
+    size_t bytes = 0;
+    vector<shared<SourceFile>> sourceFiles;
+    auto took = benchRun(1, [&] {
+        Parser parser;
+        for (auto &&file: files) {
+            auto sourceFile = read
+                              ? parser.parseSourceFile(file, fileRead(file), types::ScriptTarget::Latest, false, {}, {})
+                              : parser.parseFile(file);
+            bytes += sourceFile->text.size();
+            sourceFiles.push_back(sourceFile);
+        }
+    });
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << fmt::format("{} files, {} bytes, {}: {:.3f}ms, peak RSS {} KB\n", files.size(), bytes, read ? "read" : "mapped", took.count(), usage.ru_maxrss);
+    return 0;
+}
+
+/**
+ * bench --project [files] [threads]
+ *
+ * Loads a synthetic project of `files` (default 10000) small files in 100 directories and compiles each file,
+ * once serially (fileExists, fileRead, parse, compile) and once with FileLoader, which parses on worker threads
+ * while the calling thread compiles the files that are done.
+ */
+int projectLoad(int argc, char *argv[]) {
+    auto count = argc>2 ? std::stoi(argv[2]) : 10'000;
+    auto threads = argc>3 ? std::stoi(argv[3]) : 0;
+    auto dir = std::filesystem::temp_directory_path() / fmt::format("typerunner-bench-project-{}", getpid());
+
+    vector<string> paths;
+    for (auto i = 0; i<count; i++) {
+        auto sub = dir / fmt::format("{}", i % 100);
+        if (i<100) std::filesystem::create_directories(sub);
+        auto path = (sub / fmt::format("file{}.ts", i)).string();
+        string code;
+        for (auto j = 0; j<10; j++) {
+            code += fmt::format("type T{0} = {{ id: number, name: string, tags: string[] }};\nconst v{0}: T{0} = {{ id: {1}, name: 'n{1}', tags: [] }};\n", j, i);
+        }
+        fileWrite(path, code);
+        paths.push_back(path);
+    }
+
+    size_t bytes = 0;
+    auto serial = benchRun(1, [&] {
+        for (auto &&path: paths) {
+            if (!fileExists(path)) continue;
+            auto code = fileRead(path);
+            Parser parser;
+            auto result = parser.parseSourceFile(path, code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+            checker::Compiler compiler;
+            bytes += compiler.compileSourceFile(result).build().size();
+        }
+    });
+
+    size_t loadedBytes = 0;
+    FileLoader loader(threads);
+    auto loaded = benchRun(1, [&] {
+        loader.load(paths, [&](LoadedFile &file) {
+            if (!file.sourceFile) return;
+            checker::Compiler compiler;
+            loadedBytes += compiler.compileSourceFile(file.sourceFile).build().size();
+        });
+    });
+
+    std::cout << fmt::format("{} files, {} bytes of bytecode: serial {:.3f}ms, loader {:.3f}ms ({} bytes)\n", paths.size(), bytes, serial.count(), loaded.count(), loadedBytes);
+    std::filesystem::remove_all(dir);
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     ZoneScoped;
+    if (argc>1 && string_view(argv[1]) == "--archive") return archiveStartup(argc, argv);
+    if (argc>2 && string_view(argv[1]) == "--parse") return parseThroughput(argv[2]);
+    if (argc>2 && string_view(argv[1]) == "--load") return loadDirectory(argc, argv);
+    if (argc>1 && string_view(argv[1]) == "--project") return projectLoad(argc, argv);
+
     std::string file;
     auto cwd = std::filesystem::current_path();
 
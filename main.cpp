@@ -5,41 +5,137 @@
 #include "./src/core.h"
 #include "./src/fs.h"
 #include "./src/parser2.h"
+#include "./src/loader.h"
 #include "./src/checker/vm2.h"
 #include "./src/checker/module2.h"
 #include "./src/checker/debug.h"
 #include "./src/checker/compiler.h"
+#include "./src/checker/cache.h"
+#include "./src/checker/archive.h"
+#include "./src/checker/lib.h"
 
 using namespace tr;
 
-void run(const string &bytecode, const string &code, const string &fileName) {
+string compile(const shared<SourceFile> &sourceFile) {
+    checker::Compiler compiler;
+    compiler.lib = &vm2::lib->symbols;
+    return compiler.compileSourceFile(sourceFile).build();
+}
+
+//with `owner` the code is parsed without copying it, see Parser::parseSourceFile()
+string compile(string_view code, const string &file, std::shared_ptr<void> owner = nullptr) {
+    Parser parser;
+    return compile(parser.parseSourceFile(file, code, types::ScriptTarget::Latest, false, ScriptKind::TS, {}, std::move(owner)));
+}
+
+checker::BytecodeCache createCache() {
+    //bytecode depends on the lib it was compiled against
+    auto lib = fmt::format("lib:{:016x}", bytecode::readHeader(vm2::lib->bin).checksum);
+    return checker::BytecodeCache(checker::BytecodeCache::defaultDirectory(), 512 * 1024 * 1024, lib);
+}
+
+void run(const shared<MappedFile> &bytecode, const string &file, const string &fileName) {
     ZoneScoped;
-    auto module = std::make_shared<vm2::Module>(bytecode, fileName, code);
+    //zero-copy, the source is only read when there are errors to print
+    auto module = std::make_shared<vm2::Module>(bytecode->view(), bytecode, fileName, file);
     bench(1, [&]{
         vm2::run(module);
         module->printErrors();
     });
 }
 
-void compileAndRun(const string &code, const string &file, const string &fileName) {
+void compileAndRun(const shared<MappedFile> &source, const string &file, const string &fileName, checker::BytecodeCache &cache) {
     ZoneScoped;
-    auto bytecodePath = file + ".tsb";
-    auto buffer = fileRead(file);
-    checker::Compiler compiler;
-    Parser parser;
-    auto result = parser.parseSourceFile(file, buffer, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
-    auto program = compiler.compileSourceFile(result);
-    auto bin = program.build();
-    fileWrite(bytecodePath, bin);
-    std::filesystem::last_write_time(bytecodePath, std::filesystem::last_write_time(file));
+    auto code = source->view();
+    auto bin = compile(code, file, source);
+    cache.put(code, bin);
     checker::printBin(bin);
-    auto module = make_shared<vm2::Module>(bin, fileName, code);
+    auto module = make_shared<vm2::Module>(bin, fileName, string(code));
     vm2::run(module);
     module->printErrors();
 }
 
+/**
+ * typescript_main --pack <archive.tsa> <files...>
+ *
+ * Compiles all files (or takes them from the bytecode cache) into one archive.
+ */
+int pack(int argc, char *argv[]) {
+    if (argc<4) {
+        std::cout << "Usage: " << argv[0] << " --pack <archive.tsa> <files...>\n";
+        return 1;
+    }
+    auto cache = createCache();
+    checker::ArchiveWriter writer;
+    for (auto i = 3; i<argc; i++) {
+        string file = argv[i];
+        if (!fileExists(file)) {
+            std::cout << "File not found " << file << "\n";
+            return 4;
+        }
+        auto code = fileRead(file);
+        auto bin = cache.get(code);
+        if (!bin) {
+            bin = compile(code, file);
+            cache.put(code, *bin);
+        }
+        writer.add(file, std::move(*bin));
+    }
+    writer.write(argv[2]);
+    std::cout << "Packed " << writer.size() << " modules into " << argv[2] << "\n";
+    return 0;
+}
+
+/**
+ * typescript_main --check <files...>
+ *
+ * Checks all files. They are loaded and parsed in parallel (see FileLoader) and each is compiled and run
+ * as soon as it is parsed, while the others are still loading.
+ */
+int check(int argc, char *argv[]) {
+    vector<string> files;
+    for (auto i = 2; i<argc; i++) files.push_back(argv[i]);
+    auto status = 0;
+    FileLoader().load(files, [&](LoadedFile &file) {
+        if (!file.sourceFile) {
+            std::cout << file.error << "\n";
+            status = 4;
+            return;
+        }
+        auto module = make_shared<vm2::Module>(compile(file.sourceFile), file.path, string(file.sourceFile->text));
+        vm2::run(module);
+        module->printErrors();
+    });
+    return status;
+}
+
+/**
+ * typescript_main <archive.tsa> [modules...]
+ *
+ * Runs the given modules of the archive, or all of them.
+ */
+int runArchive(int argc, char *argv[]) {
+    auto archive = checker::Archive::open(argv[1]);
+    vector<string> paths;
+    for (auto i = 2; i<argc; i++) paths.push_back(argv[i]);
+    if (paths.empty()) {
+        for (unsigned int i = 0; i<archive->size(); i++) paths.push_back(string(archive->path(i)));
+    }
+    for (auto &&path: paths) {
+        auto module = archive->module(path);
+        vm2::run(module);
+        module->printErrors();
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     ZoneScoped;
+    vm2::setLib(checker::loadLib());
+    if (argc>1 && string_view(argv[1]) == "--pack") return pack(argc, argv);
+    if (argc>1 && string_view(argv[1]) == "--check") return check(argc, argv);
+    if (argc>1 && string_view(argv[1]).ends_with(".tsa")) return runArchive(argc, argv);
+
     std::string file;
     auto cwd = std::filesystem::current_path();
 
@@ -53,14 +149,14 @@ int main(int argc, char *argv[]) {
         std::cout << "File not found " << file << "\n";
         return 4;
     }
-    auto code = fileRead(file);
-    auto bytecode = file + ".tsb";
+    auto source = fileMap(file);
     auto relative = std::filesystem::relative(file, cwd);
 
-    if (fileExists(bytecode) && std::filesystem::last_write_time(bytecode) == std::filesystem::last_write_time(file)) {
-        run(fileRead(bytecode), code, relative.string());
+    auto cache = createCache();
+    if (auto bytecode = cache.map(source->view())) {
+        run(bytecode, file, relative.string());
     } else {
-        compileAndRun(code, file, relative.string());
+        compileAndRun(source, file, relative.string(), cache);
     }
     return 0;
 }
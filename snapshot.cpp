@@ -0,0 +1,19 @@
+#include <iostream>
+
+#include "./src/core.h"
+#include "./src/fs.h"
+#include "./src/checker/lib.h"
+
+using namespace tr;
+
+/**
+ * Build step: compiles the lib declarations to the snapshot checker::loadLib() maps at startup.
+ */
+int main(int argc, char *argv[]) {
+    if (argc<2) {
+        std::cout << "Usage: " << argv[0] << " <lib.tsb>\n";
+        return 1;
+    }
+    fileWrite(argv[1], checker::compileLib());
+    return 0;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <string_view>
+#include <algorithm>
+
+namespace tr {
+    /**
+     * Bump-pointer allocator. Allocations are never freed individually, all memory is released at once
+     * when the arena is destroyed.
+     *
+     * Used for the AST: all nodes of one parse live in one arena (see Factory::make()), so parsing does
+     * one pointer bump per node instead of a malloc, and freeing a SourceFile does not free each node.
+     * Blocks of destroyed arenas are kept per thread for the next one, so parsing file after file
+     * works on memory that is already mapped and likely cached.
+     */
+    class Arena {
+        using Block = std::unique_ptr<std::byte[]>;
+
+        std::vector<Block> blocks; //all blockSize
+        std::vector<Block> large; //allocations bigger than a block
+        std::byte *current = nullptr;
+        std::byte *end = nullptr;
+        std::size_t used = 0;
+        std::vector<std::shared_ptr<void>> retained;
+
+        static std::vector<Block> &recycled() {
+            thread_local std::vector<Block> blocks;
+            return blocks;
+        }
+
+        void grow() {
+            auto &free = recycled();
+            if (free.empty()) {
+                blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(blockSize));
+            } else {
+                blocks.push_back(std::move(free.back()));
+                free.pop_back();
+            }
+            current = blocks.back().get();
+            end = current + blockSize;
+        }
+
+    public:
+        static constexpr std::size_t blockSize = 64 * 1024;
+        unsigned int generation = 0; //number of previous arenas kept alive through retain(), see Parser::updateSourceFile()
+        static constexpr std::size_t maxRecycledBlocks = 64;
+
+        Arena() = default;
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        ~Arena() {
+            auto &free = recycled();
+            for (auto &&block: blocks) {
+                if (free.size()>=maxRecycledBlocks) break;
+                free.push_back(std::move(block));
+            }
+        }
+
+        void *allocate(std::size_t size, std::size_t alignment) {
+            auto address = (reinterpret_cast<std::uintptr_t>(current) + alignment - 1) & ~(alignment - 1);
+            if (!current || address + size>reinterpret_cast<std::uintptr_t>(end)) {
+                if (size + alignment>blockSize) {
+                    //gets its own allocation, the current block stays in use
+                    large.push_back(std::make_unique_for_overwrite<std::byte[]>(size + alignment));
+                    used += size;
+                    address = (reinterpret_cast<std::uintptr_t>(large.back().get()) + alignment - 1) & ~(alignment - 1);
+                    return reinterpret_cast<void *>(address);
+                }
+                grow();
+                address = (reinterpret_cast<std::uintptr_t>(current) + alignment - 1) & ~(alignment - 1);
+            }
+            current = reinterpret_cast<std::byte *>(address + size);
+            used += size;
+            return reinterpret_cast<void *>(address);
+        }
+
+        //copy of text that lives as long as the arena
+        std::string_view store(std::string_view text) {
+            if (text.empty()) return {};
+            auto data = static_cast<char *>(allocate(text.size(), 1));
+            std::memcpy(data, text.data(), text.size());
+            return {data, text.size()};
+        }
+
+        /**
+         * Keeps `owner` alive as long as this arena, e.g. the mapping the texts of the nodes point into. Used by
+         * incremental parsing as well: nodes reused from the previous SourceFile still live in its arena, so the
+         * arena of the new SourceFile keeps the previous arena (and what that one retains) alive.
+         */
+        void retain(std::shared_ptr<void> owner) {
+            retained.push_back(std::move(owner));
+        }
+
+        //bytes handed out
+        std::size_t size() const {
+            return used;
+        }
+
+        std::size_t blockCount() const {
+            return blocks.size();
+        }
+    };
+
+    /**
+     * Allocator for std::allocate_shared that places the object (and its control block) in an arena.
+     * The arena has to outlive the object, see ArenaOwner.
+     */
+    template<typename T>
+    struct ArenaAllocator {
+        using value_type = T;
+        Arena *arena;
+
+        explicit ArenaAllocator(Arena *arena): arena(arena) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other): arena(other.arena) {}
+
+        T *allocate(std::size_t n) {
+            return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *, std::size_t) {
+            //freed with the arena
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U> &other) const {
+            return arena == other.arena;
+        }
+    };
+
+    /**
+     * Allocator for std::allocate_shared that allocates on the heap and keeps an arena alive until the object
+     * and its control block are gone. Used for the root of everything allocated in the arena
+     * (e.g. the SourceFile), so the arena is freed right after the root was destroyed.
+     */
+    template<typename T>
+    struct ArenaOwner {
+        using value_type = T;
+        std::shared_ptr<Arena> arena;
+
+        explicit ArenaOwner(std::shared_ptr<Arena> arena): arena(std::move(arena)) {}
+
+        template<typename U>
+        ArenaOwner(const ArenaOwner<U> &other): arena(other.arena) {}
+
+        T *allocate(std::size_t n) {
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T *pointer, std::size_t n) {
+            std::allocator<T>().deallocate(pointer, n);
+        }
+
+        template<typename U>
+        bool operator==(const ArenaOwner<U> &other) const {
+            return arena == other.arena;
+        }
+    };
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define TYPERUNNER_ASCII_SIMD
+#endif
+
+/**
+ * Fast paths for the scanner: skipping runs of ASCII characters 16 (SSE2) or 32 (AVX2) bytes at a time.
+ *
+ * All functions stop at the first non-ASCII byte, so the caller continues with the UTF-8 decoder (charCodeAt) from there.
+ * Without SSE2 the same is done byte by byte.
+ */
+namespace tr::utf {
+#ifdef TYPERUNNER_ASCII_SIMD
+    namespace simd {
+#if defined(__AVX2__)
+        struct Bytes {
+            static constexpr int size = 32;
+            __m256i v;
+
+            static Bytes load(const char *p) { return {_mm256_loadu_si256((const __m256i *) p)}; }
+            static Bytes set(char c) { return {_mm256_set1_epi8(c)}; }
+            Bytes operator==(Bytes o) const { return {_mm256_cmpeq_epi8(v, o.v)}; }
+            Bytes operator|(Bytes o) const { return {_mm256_or_si256(v, o.v)}; }
+            Bytes operator-(Bytes o) const { return {_mm256_sub_epi8(v, o.v)}; }
+            //signed
+            Bytes operator<(Bytes o) const { return {_mm256_cmpgt_epi8(o.v, v)}; }
+            //one bit per byte, the highest bit of each byte
+            unsigned int mask() const { return (unsigned int) _mm256_movemask_epi8(v); }
+        };
+#else
+        struct Bytes {
+            static constexpr int size = 16;
+            __m128i v;
+
+            static Bytes load(const char *p) { return {_mm_loadu_si128((const __m128i *) p)}; }
+            static Bytes set(char c) { return {_mm_set1_epi8(c)}; }
+            Bytes operator==(Bytes o) const { return {_mm_cmpeq_epi8(v, o.v)}; }
+            Bytes operator|(Bytes o) const { return {_mm_or_si128(v, o.v)}; }
+            Bytes operator-(Bytes o) const { return {_mm_sub_epi8(v, o.v)}; }
+            //signed
+            Bytes operator<(Bytes o) const { return {_mm_cmplt_epi8(v, o.v)}; }
+            //one bit per byte, the highest bit of each byte
+            unsigned int mask() const { return (unsigned int) _mm_movemask_epi8(v); }
+        };
+#endif
+        constexpr unsigned int all = Bytes::size == 32 ? 0xFFFFFFFF : 0xFFFF;
+
+        //bytes in [from, from + count)
+        inline Bytes inRange(Bytes bytes, unsigned char from, unsigned char count) {
+            //shifts the range to start at -128, so a signed compare works as unsigned one
+            return (bytes - Bytes::set((char) (from + 128))) < Bytes::set((char) (count - 128));
+        }
+
+        template<char ...Stops>
+        inline Bytes anyOf(Bytes bytes) {
+            return ((bytes == Bytes::set(Stops)) | ...);
+        }
+    }
+#endif
+
+    inline bool isAsciiIdentifierPart(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$';
+    }
+
+    //space, tab, vertical tab, form feed, and with lineBreaks also \n and \r
+    inline bool isAsciiWhitespace(unsigned char c, bool lineBreaks) {
+        return c == ' ' || c == '\t' || c == '\v' || c == '\f' || (lineBreaks && (c == '\n' || c == '\r'));
+    }
+
+    /**
+     * Returns the position of the first byte in [pos, end) that is not [a-zA-Z0-9_$], or end.
+     */
+    inline int skipAsciiIdentifierPart(std::string_view text, int pos, int end) {
+        auto data = text.data();
+#ifdef TYPERUNNER_ASCII_SIMD
+        using namespace simd;
+        for (; pos + Bytes::size <= end; pos += Bytes::size) {
+            auto bytes = Bytes::load(data + pos);
+            auto part = inRange(bytes | Bytes::set(0x20), 'a', 26) | inRange(bytes, '0', 10) | anyOf<'_', '$'>(bytes);
+            //non-ASCII bytes never match, so they stop too
+            if (auto stops = ~part.mask() & all) return pos + __builtin_ctz(stops);
+        }
+#endif
+        while (pos < end && isAsciiIdentifierPart(data[pos])) pos++;
+        return pos;
+    }
+
+    /**
+     * Returns the position of the first byte in [pos, end) that is not ASCII whitespace, or end.
+     * With `lineBreak` given, \n and \r are skipped as well and `lineBreak` is set when there was one.
+     */
+    inline int skipAsciiWhitespace(std::string_view text, int pos, int end, bool *lineBreak = nullptr) {
+        auto data = text.data();
+#ifdef TYPERUNNER_ASCII_SIMD
+        using namespace simd;
+        for (; pos + Bytes::size <= end; pos += Bytes::size) {
+            auto bytes = Bytes::load(data + pos);
+            auto lineBreaks = anyOf<'\n', '\r'>(bytes).mask();
+            auto whitespace = anyOf<' ', '\t', '\v', '\f'>(bytes).mask() | (lineBreak ? lineBreaks : 0);
+            if (auto stops = ~whitespace & all) {
+                auto offset = __builtin_ctz(stops);
+                if (lineBreak && (lineBreaks & ((1u << offset) - 1))) *lineBreak = true;
+                return pos + offset;
+            }
+            if (lineBreak && lineBreaks) *lineBreak = true;
+        }
+#endif
+        for (; pos < end && isAsciiWhitespace(data[pos], lineBreak); pos++) {
+            if (data[pos] == '\n' || data[pos] == '\r') *lineBreak = true;
+        }
+        return pos;
+    }
+
+    /**
+     * Returns the position of the first byte in [pos, end) that is one of `Stops` or not ASCII, or end.
+     * Used for comment and string bodies, e.g. skipAsciiUntil<'*', '\n', '\r'>.
+     */
+    template<char ...Stops>
+    inline int skipAsciiUntil(std::string_view text, int pos, int end) {
+        auto data = text.data();
+#ifdef TYPERUNNER_ASCII_SIMD
+        using namespace simd;
+        for (; pos + Bytes::size <= end; pos += Bytes::size) {
+            auto bytes = Bytes::load(data + pos);
+            //highest bit set = non-ASCII
+            if (auto stops = (anyOf<Stops...>(bytes) | bytes).mask()) return pos + __builtin_ctz(stops);
+        }
+#endif
+        while (pos < end && (unsigned char) data[pos] <= 0x7F && ((data[pos] != Stops) && ...)) pos++;
+        return pos;
+    }
+}
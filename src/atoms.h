@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "hash.h"
+
+namespace tr {
+    /**
+     * Identifier texts of one SourceFile, each distinct text interned once.
+     *
+     * The parser interns every Identifier (see Parser::createIdentifier()) and stores the id in Identifier::atom.
+     * Ids are dense and start at 1, 0 means "not interned" (e.g. identifiers created by the factory outside of a parse).
+     * The hash is hash::runtime_hash of the text, computed once here, so the compiler keys symbols and storage
+     * by id and never hashes or compares identifier texts again.
+     *
+     * Texts are views, usually into SourceFile::text, so the table must not outlive the file.
+     */
+    class AtomTable {
+        struct Atom {
+            std::string_view text;
+            uint64_t hash;
+        };
+
+        std::vector<Atom> atoms{Atom{{}, 0}};
+        std::vector<unsigned int> slots; //open addressing with linear probing, atom id or 0 if empty. Size is a power of two.
+
+        void grow() {
+            slots.assign(slots.empty() ? 64 : slots.size() * 2, 0);
+            const auto mask = slots.size() - 1;
+            for (unsigned int id = 1; id<atoms.size(); id++) {
+                auto i = atoms[id].hash & mask;
+                while (slots[i]) i = (i + 1) & mask;
+                slots[i] = id;
+            }
+        }
+
+    public:
+        unsigned int intern(std::string_view text) {
+            //at most half full
+            if (atoms.size() * 2>slots.size()) grow();
+
+            const auto hash = hash::runtime_hash(text);
+            const auto mask = slots.size() - 1;
+            auto i = hash & mask;
+            for (; slots[i]; i = (i + 1) & mask) {
+                auto &atom = atoms[slots[i]];
+                if (atom.hash == hash && atom.text == text) return slots[i];
+            }
+            slots[i] = atoms.size();
+            atoms.push_back({text, hash});
+            return slots[i];
+        }
+
+        std::string_view text(unsigned int atom) const {
+            return atoms[atom].text;
+        }
+
+        uint64_t hash(unsigned int atom) const {
+            return atoms[atom].hash;
+        }
+
+        //number of ids handed out plus one, so a vector of this size can be indexed by atom
+        unsigned int size() const {
+            return atoms.size();
+        }
+
+        void clear() {
+            atoms.resize(1);
+            slots.clear();
+        }
+    };
+}
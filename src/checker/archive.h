@@ -0,0 +1,224 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "../hash.h"
+#include "../fs.h"
+#include "./bytecode.h"
+#include "./module2.h"
+
+namespace tr::checker {
+    using std::string;
+    using std::string_view;
+    using std::vector;
+
+    /**
+     * Archive of many compiled modules, so a project can load all its precompiled dependencies with one mmap.
+     *
+     * Layout:
+     *
+     *  - header
+     *  - index: entries sorted by path hash (then path), so lookups are a binary search without building a map.
+     *  - paths: the module paths, referenced by the index.
+     *  - modules: the binaries of Program::build(), each 8 byte aligned so their headers can be read in place.
+     *
+     * Opening an archive only validates header and index. Module binaries are paged in when they are used,
+     * and their checksum and structure are verified once by vm2::parseHeader.
+     */
+    namespace archive {
+        constexpr uint32_t magic = 0x41425254; //"TRBA" little endian
+        constexpr uint16_t version = 1;
+
+        struct Header {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t headerSize;
+            uint64_t compilerHash;
+            uint32_t moduleCount;
+            uint32_t indexOffset;
+            uint32_t pathsOffset;
+            uint32_t pathsSize;
+        };
+
+        struct Entry {
+            uint64_t pathHash;
+            uint32_t pathOffset;
+            uint32_t pathSize;
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        constexpr unsigned int headerSize = sizeof(Header);
+        constexpr unsigned int entrySize = sizeof(Entry);
+        constexpr unsigned int alignment = 8;
+
+        inline uint64_t pathHash(string_view path) {
+            return hash::xxh64::hash(path.data(), path.size(), 0);
+        }
+    }
+
+    class ArchiveWriter {
+        struct Item {
+            string path;
+            string bin;
+        };
+        vector<Item> items;
+        std::unordered_set<string> paths;
+
+        static unsigned int align(unsigned int offset) {
+            return (offset + archive::alignment - 1) & ~(archive::alignment - 1);
+        }
+
+    public:
+        /**
+         * Adds the binary of a module (see Program::build()). Paths have to be unique.
+         */
+        void add(const string &path, string bin) {
+            bytecode::readHeader(bin);
+            if (!paths.insert(path).second) throw std::runtime_error(fmt::format("Module {} already in archive", path));
+            items.push_back({path, std::move(bin)});
+        }
+
+        unsigned int size() {
+            return items.size();
+        }
+
+        string build() {
+            std::sort(items.begin(), items.end(), [](auto &a, auto &b) {
+                auto hashA = archive::pathHash(a.path);
+                auto hashB = archive::pathHash(b.path);
+                return hashA == hashB ? a.path < b.path : hashA < hashB;
+            });
+
+            unsigned int pathsOffset = archive::headerSize + items.size() * archive::entrySize;
+            unsigned int pathsSize = 0;
+            for (auto &&item: items) pathsSize += item.path.size();
+
+            unsigned int size = align(pathsOffset + pathsSize);
+            vector<unsigned int> offsets;
+            offsets.reserve(items.size());
+            for (auto &&item: items) {
+                offsets.push_back(size);
+                size = align(size + item.bin.size());
+            }
+
+            string bin(size, '\0');
+            archive::Header header{
+                    .magic = archive::magic,
+                    .version = archive::version,
+                    .headerSize = archive::headerSize,
+                    .compilerHash = bytecode::compilerHash(),
+                    .moduleCount = (uint32_t) items.size(),
+                    .indexOffset = archive::headerSize,
+                    .pathsOffset = pathsOffset,
+                    .pathsSize = pathsSize,
+            };
+            std::memcpy(bin.data(), &header, archive::headerSize);
+
+            unsigned int pathOffset = pathsOffset;
+            for (unsigned int i = 0; i<items.size(); i++) {
+                auto &item = items[i];
+                archive::Entry entry{
+                        .pathHash = archive::pathHash(item.path),
+                        .pathOffset = pathOffset,
+                        .pathSize = (uint32_t) item.path.size(),
+                        .offset = offsets[i],
+                        .size = (uint32_t) item.bin.size(),
+                };
+                std::memcpy(bin.data() + archive::headerSize + i * archive::entrySize, &entry, archive::entrySize);
+                std::memcpy(bin.data() + pathOffset, item.path.data(), item.path.size());
+                std::memcpy(bin.data() + offsets[i], item.bin.data(), item.bin.size());
+                pathOffset += item.path.size();
+            }
+            return bin;
+        }
+
+        void write(const string &file) {
+            auto bin = build();
+            std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+            stream.write(bin.data(), bin.size());
+            if (!stream) throw std::runtime_error(fmt::format("Could not write archive {}", file));
+        }
+    };
+
+    class Archive {
+        string_view data;
+        std::shared_ptr<const void> owner; //keeps data alive, e.g. a MappedFile
+        const archive::Header *header;
+
+        const archive::Entry &entry(unsigned int i) const {
+            return *(const archive::Entry *) (data.data() + header->indexOffset + i * archive::entrySize);
+        }
+
+    public:
+        /**
+         * `data` is not copied and has to stay valid as long as `owner` lives.
+         */
+        Archive(string_view data, std::shared_ptr<const void> owner): data(data), owner(std::move(owner)) {
+            if (data.size()<archive::headerSize) throw std::runtime_error("Invalid archive: too small");
+            header = (const archive::Header *) data.data();
+            if (header->magic != archive::magic) throw std::runtime_error("Invalid archive: wrong magic number");
+            if (header->version != archive::version) throw std::runtime_error(fmt::format("Invalid archive: version {} not supported, expected {}", header->version, archive::version));
+            if (header->headerSize != archive::headerSize) throw std::runtime_error("Invalid archive: wrong header size");
+            if (header->compilerHash != bytecode::compilerHash()) throw std::runtime_error("Invalid archive: built by a different compiler version");
+            if ((uint64_t) header->indexOffset + (uint64_t) header->moduleCount * archive::entrySize > data.size()
+                || (uint64_t) header->pathsOffset + header->pathsSize > data.size()) {
+                throw std::runtime_error("Invalid archive: truncated");
+            }
+        }
+
+        /**
+         * Maps the whole archive with one mmap.
+         */
+        static shared<Archive> open(const string &file) {
+            auto mapped = fileMap(file);
+            return std::make_shared<Archive>(mapped->view(), mapped);
+        }
+
+        unsigned int size() const {
+            return header->moduleCount;
+        }
+
+        string_view path(unsigned int i) const {
+            auto &e = entry(i);
+            if ((uint64_t) e.pathOffset + e.pathSize > data.size()) throw std::runtime_error("Invalid archive: path out of bounds");
+            return data.substr(e.pathOffset, e.pathSize);
+        }
+
+        /**
+         * Returns the binary of the module, without copying it.
+         */
+        std::optional<string_view> find(string_view path) const {
+            auto hash = archive::pathHash(path);
+            unsigned int low = 0, high = header->moduleCount;
+            while (low<high) {
+                auto middle = low + (high - low) / 2;
+                if (entry(middle).pathHash<hash) low = middle + 1; else high = middle;
+            }
+            for (; low<header->moduleCount && entry(low).pathHash == hash; low++) {
+                if (this->path(low) != path) continue;
+                auto &e = entry(low);
+                if ((uint64_t) e.offset + e.size > data.size()) throw std::runtime_error("Invalid archive: module out of bounds");
+                return data.substr(e.offset, e.size);
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * Creates a zero-copy module that keeps the archive mapped.
+         * Diagnostics load the source from `path`, if it exists.
+         */
+        shared<vm2::Module> module(string_view path) {
+            auto bin = find(path);
+            if (!bin) throw std::runtime_error(fmt::format("Module {} not found in archive", path));
+            return std::make_shared<vm2::Module>(*bin, owner, string(path), string(path));
+        }
+    };
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <fmt/format.h>
+#include "../hash.h"
+#include "./utils.h"
+
+namespace tr::bytecode {
+    using std::string;
+    using std::string_view;
+    using std::vector;
+
+    /**
+     * Bump this whenever the compiler emits different bytecode for the same source,
+     * so binaries of older builds are rejected and cache entries are not used anymore.
+     */
+    constexpr auto compilerVersion = "typerunner-4";
+
+    constexpr uint32_t magic = 0x43425254; //"TRBC" little endian
+    constexpr uint16_t version = 2;
+
+    inline uint64_t compilerHash() {
+        return hash::runtime_hash(compilerVersion);
+    }
+
+    /**
+     * Every binary starts with this header, followed by the sections in this order:
+     *
+     *  - storage: entries of uint64 hash, uint16 size, data. Storage addresses are absolute offsets in the binary.
+     *  - subroutine table: entries of varint name address (0 if nameless), varint code size, uint8 flags. The first is main.
+     *  - code: OPs of all subroutines, in the order of the subroutine table.
+     *  - source map: entries of varint bytecodePos delta (starting at codeOffset), varint zigzag sourcePos delta, varint sourceEnd - sourcePos.
+     *
+     * The code keeps fixed-width operands, since the VM executes it in place. The tables are read once by
+     * vm2::parseHeader() into their decoded form, the source map only when diagnostics need positions.
+     * The source map is last and has its own checksum, so it can be detached (see withoutSourceMap()) and is only
+     * verified when it is decoded. `checksum` is the xxh64 of everything between header and source map.
+     */
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint64_t compilerHash;
+        uint64_t checksum;
+        uint64_t sourceMapChecksum; //also kept when the source map is detached, so an attached one can be verified
+        uint32_t storageOffset;
+        uint32_t storageSize;
+        uint32_t subroutinesOffset;
+        uint32_t subroutinesSize;
+        uint32_t subroutineCount;
+        uint32_t codeOffset;
+        uint32_t codeSize;
+        uint32_t sourceMapOffset;
+        uint32_t sourceMapSize;
+    };
+
+    constexpr unsigned int headerSize = sizeof(Header);
+
+    struct SubroutineEntry {
+        uint32_t nameAddress;
+        uint32_t address;
+        uint8_t flags;
+    };
+
+    struct SourceMapEntry {
+        uint32_t bytecodePos;
+        uint32_t sourcePos;
+        uint32_t sourceEnd;
+    };
+
+    inline uint64_t checksum(string_view bin) {
+        auto &header = *(const Header *) bin.data();
+        return hash::xxh64::hash(bin.data() + headerSize, header.codeOffset + header.codeSize - headerSize, 0);
+    }
+
+    inline uint64_t sourceMapChecksum(string_view map) {
+        return hash::xxh64::hash(map.data(), map.size(), 0);
+    }
+
+    /**
+     * Returns the header of `bin` and throws when it is not a binary of this compiler.
+     * This is O(1), the checksum is only verified with verifyChecksum().
+     */
+    inline const Header &readHeader(string_view bin) {
+        if (bin.size()<headerSize) throw std::runtime_error("Invalid bytecode: too small");
+        auto &header = *(const Header *) bin.data();
+        if (header.magic != magic) throw std::runtime_error("Invalid bytecode: wrong magic number");
+        if (header.version != version) throw std::runtime_error(fmt::format("Invalid bytecode: version {} not supported, expected {}", header.version, version));
+        if (header.headerSize != headerSize) throw std::runtime_error("Invalid bytecode: wrong header size");
+        if (header.compilerHash != compilerHash()) throw std::runtime_error("Invalid bytecode: built by a different compiler version");
+        if ((uint64_t) header.codeOffset + header.codeSize != header.sourceMapOffset || (uint64_t) header.sourceMapOffset + header.sourceMapSize != bin.size()) {
+            throw std::runtime_error("Invalid bytecode: truncated");
+        }
+        return header;
+    }
+
+    inline void verifyChecksum(string_view bin) {
+        if (readHeader(bin).checksum != checksum(bin)) throw std::runtime_error("Invalid bytecode: checksum mismatch");
+    }
+
+    /**
+     * Decodes the subroutine table. Throws when it does not match the code section.
+     */
+    inline vector<SubroutineEntry> readSubroutines(string_view bin) {
+        auto &header = readHeader(bin);
+        if ((uint64_t) header.subroutinesOffset + header.subroutinesSize>header.codeOffset) throw std::runtime_error("Invalid bytecode: subroutine table out of bounds");
+        auto table = bin.substr(0, header.subroutinesOffset + header.subroutinesSize);
+        vector<SubroutineEntry> result;
+        result.reserve(header.subroutineCount);
+
+        unsigned int i = header.subroutinesOffset;
+        uint64_t address = header.codeOffset;
+        for (unsigned int j = 0; j<header.subroutineCount; j++) {
+            const auto nameAddress = vm::readVarint(table, i);
+            const auto size = vm::readVarint(table, i);
+            if (i>=table.size()) throw std::runtime_error("Invalid bytecode: truncated subroutine table");
+            result.push_back({nameAddress, (uint32_t) address, (uint8_t) table[i++]});
+            address += size;
+        }
+        if (i != table.size() || address != header.codeOffset + header.codeSize) throw std::runtime_error("Invalid bytecode: subroutine table does not match code");
+        return result;
+    }
+
+    /**
+     * The source map section of `bin`, empty when it was detached.
+     */
+    inline string_view sourceMap(string_view bin) {
+        auto &header = readHeader(bin);
+        return bin.substr(header.sourceMapOffset, header.sourceMapSize);
+    }
+
+    /**
+     * Throws when `map` (the one of `bin` or a detached one) is not the source map `bin` was built with.
+     */
+    inline void verifySourceMap(string_view bin, string_view map) {
+        if (readHeader(bin).sourceMapChecksum != sourceMapChecksum(map)) throw std::runtime_error("Invalid bytecode: source map checksum mismatch");
+    }
+
+    /**
+     * Decodes a source map section. Its bytecode positions are relative to the code section, `codeOffset` makes them
+     * absolute in the binary it belongs to.
+     */
+    inline vector<SourceMapEntry> readSourceMap(string_view map, uint32_t codeOffset) {
+        vector<SourceMapEntry> result;
+        uint32_t bytecodePos = codeOffset;
+        uint32_t sourcePos = 0;
+        for (unsigned int i = 0; i<map.size();) {
+            bytecodePos += vm::readVarint(map, i);
+            sourcePos += vm::unzigzag(vm::readVarint(map, i));
+            result.push_back({bytecodePos, sourcePos, sourcePos + vm::readVarint(map, i)});
+        }
+        return result;
+    }
+
+    /**
+     * Copy of `bin` without its source map, e.g. for a shared cache that ships the map separately
+     * (see vm2::Module::attachSourceMap()). It runs the same, only diagnostics have no position.
+     * Both checksums stay valid.
+     */
+    inline string withoutSourceMap(string_view bin) {
+        auto &header = readHeader(bin);
+        string result(bin.substr(0, header.sourceMapOffset));
+        ((Header *) result.data())->sourceMapSize = 0;
+        return result;
+    }
+
+    /**
+     * Name hash -> subroutine index of all named subroutines (type aliases, interfaces, ...) of `bin`.
+     * The hash is the one of the storage entry of the name, so OP::CallLib can be resolved without reading the name.
+     */
+    inline std::unordered_map<uint64_t, unsigned int> symbols(string_view bin) {
+        auto subroutines = readSubroutines(bin);
+        std::unordered_map<uint64_t, unsigned int> result;
+        result.reserve(subroutines.size());
+        for (unsigned int i = 1; i<subroutines.size(); i++) {
+            if (!subroutines[i].nameAddress) continue;
+            uint64_t nameHash;
+            std::memcpy(&nameHash, bin.data() + subroutines[i].nameAddress, 8);
+            result.emplace(nameHash, i);
+        }
+        return result;
+    }
+}
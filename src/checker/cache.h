@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include <fmt/format.h>
+#include "../hash.h"
+#include "./bytecode.h"
+#include "../fs.h"
+
+namespace tr::checker {
+    using std::string;
+    using std::string_view;
+    using std::vector;
+    namespace fs = std::filesystem;
+
+    /**
+     * Content-addressed cache of compiled bytecode.
+     *
+     * Entries are keyed by the hash of the source code, the compiler version and the compiler options,
+     * so they are independent of file paths and modification times and can be shared between checkouts.
+     * Entries are written to a temporary file and renamed into place, so concurrent readers either see
+     * a complete entry or none. Once the directory exceeds maxSize, the least recently used entries are removed.
+     */
+    class BytecodeCache {
+        //size of the directory as of the last evict() plus everything put() since, so not every put() has to scan it
+        std::optional<uintmax_t> estimatedSize;
+
+    public:
+        fs::path directory;
+        uintmax_t maxSize;
+        string options;
+
+        //temporary files older than this are left over from a crashed writer, see evict()
+        fs::file_time_type::duration staleTemp = std::chrono::hours(1);
+
+        explicit BytecodeCache(fs::path directory, uintmax_t maxSize = 512 * 1024 * 1024, string options = ""): directory(std::move(directory)), maxSize(maxSize), options(std::move(options)) {}
+
+        /**
+         * $TYPERUNNER_CACHE_DIR, $XDG_CACHE_HOME/typerunner, ~/.cache/typerunner, or the temp directory as fallback.
+         */
+        static fs::path defaultDirectory() {
+            if (auto dir = std::getenv("TYPERUNNER_CACHE_DIR"); dir && *dir) return dir;
+            if (auto dir = std::getenv("XDG_CACHE_HOME"); dir && *dir) return fs::path(dir) / "typerunner";
+            if (auto dir = std::getenv("HOME"); dir && *dir) return fs::path(dir) / ".cache" / "typerunner";
+            return fs::temp_directory_path() / "typerunner";
+        }
+
+        uint64_t key(string_view code) {
+            const auto seed = hash::runtime_hash(fmt::format("{}:{}", bytecode::compilerVersion, options));
+            return hash::xxh64::hash(code.data(), code.size(), seed);
+        }
+
+        fs::path path(uint64_t key) {
+            return directory / fmt::format("{:016x}.tsb", key);
+        }
+
+        std::optional<string> get(string_view code) {
+            auto file = path(key(code));
+            std::ifstream stream(file, std::ios::binary);
+            if (!stream) return std::nullopt;
+            string bin((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            try {
+                //stale or corrupt entries are ignored and overwritten by the next put()
+                bytecode::verifyChecksum(bin);
+                bytecode::verifySourceMap(bin, bytecode::sourceMap(bin));
+            } catch (std::runtime_error &error) {
+                return std::nullopt;
+            }
+
+            //mark as recently used for eviction
+            std::error_code error;
+            fs::last_write_time(file, fs::file_time_type::clock::now(), error);
+            return bin;
+        }
+
+        /**
+         * Like get(), but maps the entry into memory instead of reading it, see vm2::Module for zero-copy loading.
+         * Entries are never modified in place (only replaced via rename), so the mapping stays valid.
+         * The source map is not touched here, it is verified when diagnostics need it (see vm2::Module::getSourceMap()).
+         */
+        std::shared_ptr<MappedFile> map(string_view code) {
+            auto file = path(key(code));
+            std::shared_ptr<MappedFile> mapped;
+            try {
+                mapped = fileMap(file.string());
+                bytecode::verifyChecksum(mapped->view());
+            } catch (std::runtime_error &error) {
+                return nullptr;
+            }
+
+            std::error_code error;
+            fs::last_write_time(file, fs::file_time_type::clock::now(), error);
+            return mapped;
+        }
+
+        /**
+         * Stores the bytecode. Failures (read-only file system, full disk, ...) are ignored, the cache is optional.
+         */
+        void put(string_view code, string_view bin) {
+            std::error_code error;
+            fs::create_directories(directory, error);
+            if (error) return;
+
+            auto file = path(key(code));
+            auto temp = file;
+            static std::atomic<unsigned int> writes = 0;
+            temp += fmt::format(".{}.{}.tmp", getpid(), writes++);
+            {
+                std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+                if (!stream) return;
+                stream.write(bin.data(), bin.size());
+                if (!stream) {
+                    stream.close();
+                    fs::remove(temp, error);
+                    return;
+                }
+            }
+
+            //atomic on POSIX, a concurrent writer of the same key writes the same content
+            fs::rename(temp, file, error);
+            if (error) {
+                fs::remove(temp, error);
+                return;
+            }
+
+            //other processes write to the same directory, so the size is only an estimate until evict() scans again
+            if (estimatedSize) *estimatedSize += bin.size();
+            if (!estimatedSize || *estimatedSize > maxSize) evict();
+        }
+
+        /**
+         * Removes the least recently used entries until the cache is smaller than maxSize,
+         * and temporary files of writers that did not finish (older than staleTemp).
+         */
+        void evict() {
+            struct Entry {
+                fs::path path;
+                uintmax_t size;
+                fs::file_time_type time;
+            };
+            vector<Entry> entries;
+            uintmax_t size = 0;
+            auto staleBefore = fs::file_time_type::clock::now() - staleTemp;
+
+            std::error_code error;
+            for (auto &&item: fs::directory_iterator(directory, error)) {
+                auto extension = item.path().extension();
+                if (extension != ".tsb" && extension != ".tmp") continue;
+                std::error_code itemError;
+                auto itemSize = item.file_size(itemError);
+                auto time = item.last_write_time(itemError);
+                //removed in the meantime by another process
+                if (itemError) continue;
+                if (extension == ".tmp") {
+                    if (time < staleBefore) fs::remove(item.path(), itemError);
+                    continue;
+                }
+                entries.push_back({item.path(), itemSize, time});
+                size += itemSize;
+            }
+            estimatedSize = size;
+            if (size <= maxSize) return;
+
+            std::sort(entries.begin(), entries.end(), [](auto &a, auto &b) { return a.time < b.time; });
+            for (auto &&entry: entries) {
+                if (size <= maxSize) break;
+                fs::remove(entry.path, error);
+                size -= entry.size;
+            }
+            estimatedSize = size;
+        }
+    };
+}
@@ -3,10 +3,16 @@
 #include <string>
 #include <functional>
 #include <utility>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "./instructions.h"
 #include "./utils.h"
+#include "./bytecode.h"
 #include "../node_test.h"
+#include "../parser2.h"
+#include "../visitor.h"
 
 namespace tr::checker {
 
@@ -57,7 +63,8 @@ namespace tr::checker {
     struct Subroutine;
 
     struct Symbol {
-        string name;
+        string_view name;
+        unsigned int atom{}; //see Program::atom()
         bool active = true; //will be switched to false when it goes out of scope
         SymbolType type = SymbolType::Type;
         unsigned int index{}; //symbol index of the current frame
@@ -65,6 +72,7 @@ namespace tr::checker {
         unsigned int end{};
         unsigned int declarations = 1;
         sharedOpt<Subroutine> routine = nullptr;
+        int shadowed = -1; //index of the previous symbol in the same subroutine with the same atom, -1 if none
     };
 
     struct FoundSymbol {
@@ -117,6 +125,10 @@ namespace tr::checker {
         unsigned int nameAddress{};
         SymbolType type = SymbolType::Type;
         vector<Symbol> symbols{};
+        unordered_map<unsigned int, int> symbolTable; //name atom to index of the latest symbol in symbols, older ones are reachable via Symbol::shadowed
+
+        /** @see instructions::SubroutineFlag */
+        unsigned int flags = 0;
 
         vector<Section> sections;
         unsigned int activeSection = 0;
@@ -231,6 +243,63 @@ namespace tr::checker {
                     }
                 }
             }
+
+            fuse();
+        }
+
+        /**
+         * Peephole pass that replaces frequent OP sequences with superinstructions (see instructions::OP::LoadsDistribute).
+         * Only the first OP byte of a sequence is rewritten, so all addresses stay the same.
+         */
+        void fuse() {
+            vector<unsigned int> ips;
+            for (unsigned int i = 0; i<ops.size(); i++) {
+                ips.push_back(i);
+                vm::eatParams((OP) ops[i], &i);
+            }
+
+            auto opAt = [&](unsigned int k) {
+                return k<ips.size() ? (OP) ops[ips[k]] : OP::Noop;
+            };
+
+            for (unsigned int k = 0; k<ips.size(); k++) {
+                const auto op = opAt(k);
+                const auto next = opAt(k + 1);
+                switch (op) {
+                    case OP::Loads: {
+                        if (next == OP::Distribute) {
+                            ops[ips[k]] = OP::LoadsDistribute;
+                            k += 1;
+                        } else if (next == OP::Extends && opAt(k + 2) == OP::JumpCondition) {
+                            ops[ips[k]] = OP::LoadsExtendsJumpCondition;
+                            k += 2;
+                        }
+                        break;
+                    }
+                    case OP::Extends: {
+                        if (next == OP::JumpCondition) {
+                            ops[ips[k]] = OP::ExtendsJumpCondition;
+                            k += 1;
+                        }
+                        break;
+                    }
+                    case OP::String:
+                    case OP::Number: {
+                        if (next == OP::StringLiteral && opAt(k + 2) == OP::PropertySignature) {
+                            ops[ips[k]] = op == OP::String ? OP::StringPropertySignature : OP::NumberPropertySignature;
+                            k += 2;
+                        }
+                        break;
+                    }
+                    case OP::StringLiteral: {
+                        if (next == OP::PropertySignature) {
+                            ops[ips[k]] = OP::StringLiteralPropertySignature;
+                            k += 1;
+                        }
+                        break;
+                    }
+                }
+            }
         }
 
         void pushSourceMap(unsigned int sourcePos, unsigned int sourceEnd) {
@@ -249,16 +318,50 @@ namespace tr::checker {
         //}
 
         unsigned int getFlags() {
-            unsigned int flags = 0;
             return flags;
         }
     };
 
+    /**
+     * OPs that build always the same type, independent of arguments or the state of other subroutines.
+     */
+    inline bool isConstantOp(OP op) {
+        switch (op) {
+            case OP::Never:
+            case OP::Any:
+            case OP::Unknown:
+            case OP::String:
+            case OP::Number:
+            case OP::Boolean:
+            case OP::Null:
+            case OP::Undefined:
+            case OP::StringLiteral:
+            case OP::NumberLiteral:
+            case OP::True:
+            case OP::False:
+            case OP::PropertySignature:
+            case OP::StringLiteralPropertySignature:
+            case OP::StringPropertySignature:
+            case OP::NumberPropertySignature:
+            case OP::ObjectLiteral:
+            case OP::Union:
+            case OP::Array:
+            case OP::Tuple:
+            case OP::TupleMember:
+            case OP::Optional:
+            case OP::Slots:
+            case OP::Return:
+                return true;
+        }
+        return false;
+    }
+
     struct StorageItem {
         string_view value;
+        uint64_t hash{};
         unsigned int address{};
 
-        explicit StorageItem(const string_view &value): value(value) {}
+        explicit StorageItem(const string_view &value, uint64_t hash, unsigned int address): value(value), hash(hash), address(address) {}
     };
 
     struct FrameOffset {
@@ -428,8 +531,11 @@ namespace tr::checker {
 
     class Program {
     public:
-        vector<string_view> storage; //all kind of literals, as strings
-        unordered_map<uint64_t, reference_wrapper<StorageItem>> storageMap; //used to deduplicated storage entries
+        vector<StorageItem> storage; //all kind of literals, as strings
+        unordered_map<uint64_t, unsigned int> storageMap; //hash to index in storage, used to deduplicate storage entries
+
+        AtomTable *atoms = nullptr; //identifier texts of the compiled file, see Compiler::compileSourceFile()
+        vector<unsigned int> atomStorage; //atom to storage address, 0 if not registered yet
 
         unsigned int storageIndex{};
 
@@ -477,7 +583,8 @@ namespace tr::checker {
         shared<Subroutine> popSubroutine() {
             if (activeSubroutines.empty()) throw runtime_error("No active subroutine found");
             auto subroutine = activeSubroutines.back();
-            if (subroutine->ops.empty()) {
+            //main is empty in declaration-only files
+            if (subroutine->ops.empty() && subroutine->index != 0) {
                 throw runtime_error("Routine is empty");
             }
 
@@ -498,14 +605,33 @@ namespace tr::checker {
             return activeSubroutines.back();
         }
 
-        FoundSymbol findSymbol(const string_view &identifier) {
+        /**
+         * Id of the identifier's text in the file's AtomTable. Identifiers the parser did not create (e.g. synthesized ones)
+         * are interned on first use, so all identifiers with the same text share one atom.
+         */
+        unsigned int atom(const shared<Identifier> &identifier) {
+            if (!identifier->atom) {
+                if (!atoms) throw runtime_error("Program has no atom table");
+                identifier->atom = atoms->intern(identifier->escapedText);
+            }
+            return identifier->atom;
+        }
+
+        FoundSymbol findSymbol(const shared<Identifier> &identifier) {
+            return findSymbol(atom(identifier));
+        }
+
+        FoundSymbol findSymbol(unsigned int atom) {
             unsigned int offset = 0;
             for (auto subroutine = activeSubroutines.rbegin(); subroutine != activeSubroutines.rend(); ++subroutine) {
                 auto &symbols = (*subroutine)->symbols;
-                //we go in reverse to fetch the closest
-                for (auto it = symbols.rbegin(); it != symbols.rend(); ++it) {
-                    if (it->active && it->name == identifier) {
-                        return FoundSymbol(&(*it), offset);
+                auto found = (*subroutine)->symbolTable.find(atom);
+                if (found != (*subroutine)->symbolTable.end()) {
+                    //the chain goes from the latest to the oldest, so we fetch the closest
+                    for (auto i = found->second; i>=0; i = symbols[i].shadowed) {
+                        if (symbols[i].active) {
+                            return FoundSymbol(&symbols[i], offset);
+                        }
                     }
                 }
                 offset++;
@@ -630,7 +756,7 @@ namespace tr::checker {
         }
 
         void restoreSymbolCheckout(unsigned int checkpoint) {
-            auto symbols = currentSubroutine()->symbols;
+            auto &symbols = currentSubroutine()->symbols;
             for (; checkpoint<symbols.size(); checkpoint++) {
                 symbols[checkpoint].active = false;
             }
@@ -645,33 +771,43 @@ namespace tr::checker {
          * Symbols will be created first before a body is extracted. This makes sure all
          * symbols are known before their reference is used.
          */
-        Symbol &pushSymbol(string_view name, SymbolType type, const shared<Node> &node) {
-            auto subroutine = currentSubroutine();
-            for (auto &&v: subroutine->symbols) {
-                if (type != SymbolType::TypeVariable && v.name == name) {
-                    v.declarations++;
-                    return v;
+        Symbol &pushSymbol(const shared<Identifier> &name, SymbolType type, const shared<Node> &node) {
+            auto &subroutine = currentSubroutine();
+            const auto atom = this->atom(name);
+            auto &latest = subroutine->symbolTable.try_emplace(atom, -1).first->second;
+            if (type != SymbolType::TypeVariable) {
+                //redeclaration, the first declaration wins
+                Symbol *first = nullptr;
+                for (auto i = latest; i>=0; i = subroutine->symbols[i].shadowed) {
+                    first = &subroutine->symbols[i];
+                }
+                if (first) {
+                    first->declarations++;
+                    return *first;
                 }
             }
 
             Symbol symbol;
-            symbol.name = string(name);
+            symbol.name = name->escapedText;
+            symbol.atom = atom;
             symbol.type = type;
-            symbol.index = currentSubroutine()->symbols.size();
+            symbol.index = subroutine->symbols.size();
             symbol.pos = node->pos;
             symbol.end = node->end;
+            symbol.shadowed = latest;
+            latest = symbol.index;
             if (type == SymbolType::TypeVariable) subroutine->slots++;
             subroutine->symbols.push_back(symbol);
             return subroutine->symbols.back();
         }
 
-        Symbol &pushSymbolForRoutine(string_view name, SymbolType type, const shared<Node> &node) {
+        Symbol &pushSymbolForRoutine(const shared<Identifier> &name, SymbolType type, const shared<Node> &node) {
             auto &symbol = pushSymbol(name, type, node);
             if (symbol.routine) return symbol;
 
-            auto routine = make_shared<Subroutine>(name);
+            auto routine = make_shared<Subroutine>(symbol.name);
             routine->type = type;
-            routine->nameAddress = registerStorage(routine->identifier);
+            routine->nameAddress = registerStorage(symbol.atom);
             routine->index = subroutines.size();
             subroutines.push_back(routine);
             symbol.routine = routine;
@@ -679,12 +815,37 @@ namespace tr::checker {
             return symbol;
         }
 
-        //note: make sure the same name is not added twice. needs hashmap
+        /**
+         * Returns the address of `s` in the storage. The same text is stored only once.
+         */
         unsigned int registerStorage(const string_view &s) {
-            if (!storageIndex) storageIndex = 1 + 4; //jump+address
+            return registerStorage(s, hash::runtime_hash(s));
+        }
+
+        /**
+         * Same as registerStorage(string_view) with the precomputed hash of the atom. The address is cached per atom.
+         */
+        unsigned int registerStorage(unsigned int atom) {
+            if (atomStorage.size()<=atom) atomStorage.resize(std::max(atom + 1, atoms->size()));
+            auto &address = atomStorage[atom];
+            if (!address) address = registerStorage(atoms->text(atom), atoms->hash(atom));
+            return address;
+        }
+
+        unsigned int registerStorage(const string_view &s, uint64_t hash) {
+            if (!storageIndex) storageIndex = bytecode::headerSize; //storage is the first section
+
+            auto found = storageMap.find(hash);
+            if (found != storageMap.end()) {
+                auto &item = storage[found->second];
+                if (item.value == s) return item.address;
+                //hash collision, store it separately
+            } else {
+                storageMap.emplace(hash, storage.size());
+            }
 
             const auto address = storageIndex;
-            storage.push_back(s);
+            storage.emplace_back(s, hash, address);
             storageIndex += 8 + 2 + s.size(); //hash + size + data
             return address;
         }
@@ -697,95 +858,225 @@ namespace tr::checker {
             pushAddress(registerStorage(s));
         }
 
+        void pushStorage(const shared<Identifier> &identifier) {
+            pushAddress(registerStorage(atom(identifier)));
+        }
+
         void pushStringLiteral(string_view s, const shared<Node> &node) {
             pushOp(OP::StringLiteral, node);
             pushStorage(s);
         }
 
-        string build() {
-            vector<unsigned char> bin;
-            unsigned int address = 0;
+        void pushStringLiteral(const shared<Identifier> &identifier) {
+            pushOp(OP::StringLiteral, identifier);
+            pushStorage(identifier);
+        }
 
-            address = 5; //we add JUMP + index when building the program to jump over all subroutines&storages
-            bin.push_back(OP::Jump);
-            vm::writeUint32(bin, bin.size(), 0); //set after storage handling
+        /**
+         * Marks closed, non-generic subroutines (e.g. `type Person = {name: string}` or `const a: string`) as constant.
+         * A subroutine is constant when it only consists of constant OPs and calls only other constant subroutines without arguments.
+         * Recursive references are never marked, since a subroutine is only marked once all its callees are.
+         */
+        void markConstantSubroutines() {
+            vector<bool> constant(subroutines.size(), false);
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto &&routine: subroutines) {
+                    if (routine->index == 0 || constant[routine->index]) continue;
+                    if (routine->type != SymbolType::Type && routine->type != SymbolType::Variable) continue;
+
+                    auto &ops = routine->ops;
+                    bool closed = true;
+                    for (unsigned int i = 0; closed && i<ops.size(); i++) {
+                        const auto op = (OP) ops[i];
+                        if (op == OP::Call) {
+                            const auto address = vm::readUint32(ops, i + 1);
+                            const auto arguments = vm::readUint16(ops, i + 5);
+                            closed = arguments == 0 && address<constant.size() && constant[address];
+                        } else {
+                            closed = isConstantOp(op);
+                        }
+                        vm::eatParams(op, &i);
+                    }
 
-            for (auto &&item: storage) {
-                address += 8 + 2 + item.size(); //hash+size+data
+                    if (closed) {
+                        constant[routine->index] = true;
+                        routine->flags |= instructions::SubroutineFlag::Constant;
+                        changed = true;
+                    }
+                }
             }
+        }
 
-            //set initial jump position to right after the storage data
-            vm::writeUint32(bin, 1, address);
-            //push all storage data to the binary
-            for (auto &&item: storage) {
-                vm::writeUint64(bin, bin.size(), hash::runtime_hash(item));
-                vm::writeUint16(bin, bin.size(), item.size());
-                bin.insert(bin.end(), item.begin(), item.end());
-            }
+        unsigned int subroutineTableSize() {
+            unsigned int size = 0;
+            for (auto &&routine: subroutines) size += vm::varintSize(routine->nameAddress) + vm::varintSize(routine->ops.size()) + 1;
+            return size;
+        }
 
-            //collect sourcemap data
-            unsigned int sourceMapSize = 0;
+        /**
+         * Source map entries are delta encoded, see bytecode::Header. Positions are relative to the code section,
+         * so the size does not depend on where the code starts.
+         */
+        template<typename F>
+        void forEachSourceMapDelta(F &&callback) {
+            uint32_t bytecodePos = 0;
+            uint32_t sourcePos = 0;
+            uint32_t routineAddress = 0;
             for (auto &&routine: subroutines) {
-                sourceMapSize += routine->sourceMap.map.size() * (4 * 3);
+                for (auto &&map: routine->sourceMap.map) {
+                    callback(routineAddress + map.bytecodePos - bytecodePos, vm::zigzag((int32_t) (map.sourcePos - sourcePos)), map.sourceEnd - map.sourcePos);
+                    bytecodePos = routineAddress + map.bytecodePos;
+                    sourcePos = map.sourcePos;
+                }
+                routineAddress += routine->ops.size();
             }
+        }
 
-            //write sourcemap
-            bin.push_back(OP::SourceMap);
-            vm::writeUint32(bin, bin.size(), sourceMapSize);
-            address += 1 + 4 + sourceMapSize; //OP::SourceMap + uint32 size
+        unsigned int sourceMapSize() {
+            unsigned int size = 0;
+            forEachSourceMapDelta([&size](uint32_t bytecodePos, uint32_t sourcePos, uint32_t length) {
+                size += vm::varintSize(bytecodePos) + vm::varintSize(sourcePos) + vm::varintSize(length);
+            });
+            return size;
+        }
 
-            unsigned int bytecodePosOffset = address;
-            bytecodePosOffset += subroutines.size() * (1 + 4 + 4 + 1); //OP::Subroutine + uint32 name address + uint32 routine address + flags
-            bytecodePosOffset += 1; //OP::Main
+        /**
+         * Exact size of the binary build() produces.
+         */
+        unsigned int buildSize() {
+            unsigned int size = bytecode::headerSize;
+            for (auto &&item: storage) size += 8 + 2 + item.value.size(); //hash+size+data
+            size += subroutineTableSize();
+            for (auto &&routine: subroutines) size += routine->ops.size();
+            size += sourceMapSize();
+            return size;
+        }
 
-            for (auto &&routine: subroutines) {
-                for (auto &&map: routine->sourceMap.map) {
-                    vm::writeUint32(bin, bin.size(), bytecodePosOffset + map.bytecodePos);
-                    vm::writeUint32(bin, bin.size(), map.sourcePos);
-                    vm::writeUint32(bin, bin.size(), map.sourceEnd);
-                }
-                bytecodePosOffset += routine->ops.size();
-            }
+        string build() {
+            string bin;
+            bin.resize(buildSize());
+            build(bin.data());
+            return bin;
+        }
 
-            address += 1; //OP::Main
-            address += subroutines.size() * (1 + 4 + 4 + 1); //OP::Subroutine + uint32 name address + uint32 routine address + flags
+        /**
+         * Writes the binary in one pass into `bin`, which needs to have at least buildSize() bytes (e.g. a mmap-ed file).
+         * @see bytecode::Header for the layout
+         */
+        void build(char *bin) {
+            markConstantSubroutines();
 
-            //after the storage data follows the subroutine meta-data.
-            for (auto &&routine: subroutines) {
-                bin.push_back(OP::Subroutine);
-                vm::writeUint32(bin, bin.size(), routine->nameAddress);
-                vm::writeUint32(bin, bin.size(), address);
-                bin.push_back(routine->getFlags());
-                address += routine->ops.size();
+            auto &header = *(bytecode::Header *) bin;
+            header.magic = bytecode::magic;
+            header.version = bytecode::version;
+            header.headerSize = bytecode::headerSize;
+            header.compilerHash = bytecode::compilerHash();
+
+            unsigned int i = bytecode::headerSize;
+            header.storageOffset = i;
+            for (auto &&item: storage) {
+                vm::writeUint64(bin, i, item.hash);
+                vm::writeUint16(bin, i + 8, item.value.size());
+                std::memcpy(bin + i + 8 + 2, item.value.data(), item.value.size());
+                i += 8 + 2 + item.value.size();
             }
+            header.storageSize = i - header.storageOffset;
 
-            //after subroutine meta-data follows the actual subroutine code, which we jump over.
-            //this marks the end of the header.
-            bin.push_back(OP::Main);
+            header.subroutinesOffset = i;
+            header.subroutineCount = subroutines.size();
+            for (auto &&routine: subroutines) {
+                i = vm::writeVarint(bin, i, routine->nameAddress);
+                i = vm::writeVarint(bin, i, routine->ops.size());
+                bin[i++] = routine->getFlags();
+            }
+            header.subroutinesSize = i - header.subroutinesOffset;
 
+            header.codeOffset = i;
             for (auto &&routine: subroutines) {
                 if (routine->slots) {
                     vm::writeUint16(routine->ops, routine->slotIP + 1, routine->slots);
                 }
-                bin.insert(bin.end(), routine->ops.begin(), routine->ops.end());
+                std::memcpy(bin + i, routine->ops.data(), routine->ops.size());
+                i += routine->ops.size();
             }
-
-            return string(bin.begin(), bin.end());
+            header.codeSize = i - header.codeOffset;
+
+            header.sourceMapOffset = i;
+            forEachSourceMapDelta([&](uint32_t bytecodePos, uint32_t sourcePos, uint32_t length) {
+                i = vm::writeVarint(bin, i, bytecodePos);
+                i = vm::writeVarint(bin, i, sourcePos);
+                i = vm::writeVarint(bin, i, length);
+            });
+            header.sourceMapSize = i - header.sourceMapOffset;
+            header.sourceMapChecksum = bytecode::sourceMapChecksum({bin + header.sourceMapOffset, header.sourceMapSize});
+            header.checksum = bytecode::checksum({bin, i});
         }
     };
 
     class Compiler {
     public:
+        /**
+         * Global types of the lib snapshot (see bytecode::symbols()). References not found in the file
+         * are resolved against it and compiled to OP::CallLib. The VM needs the same lib, see vm2::setLib().
+         */
+        const std::unordered_map<uint64_t, unsigned int> *lib = nullptr;
+
+        sharedOpt<SourceFile> file; //the one being compiled, see compileSourceFile()
+        Parser bodyParser; //parses function bodies skipped by Parser::lazyBodies when they are needed, see pushFunction()
+
+        /**
+         * handle() recurses once per nesting level of the AST. Nodes deeper than this are not compiled but reported
+         * (ErrorCode::TooDeep), so adversarial input like `string[][]...` with thousands of `[]` (which the parser
+         * builds in a loop) can not overflow the native stack.
+         */
+        unsigned int maxDepth = 1000;
+        std::unordered_set<Node *> tooDeep; //roots of the subtrees not compiled, see findTooDeep()
+        std::unordered_map<Node *, unsigned int> lazyDepths; //depth of the lazy bodies below the file, see findTooDeep()
+
+        Compiler() {
+            bodyParser.lazyBodies = true;
+        }
+
         Program compileSourceFile(const shared<SourceFile> &file) {
             Program program;
+            program.atoms = &file->atoms;
+            this->file = file;
 
+            findTooDeep(file);
             handle(file, program);
 
             program.popSubroutine(); //main
+            this->file = nullptr;
+            tooDeep.clear();
+            lazyDepths.clear();
 
             return program;
         }
 
+        /**
+         * Marks the nodes at maxDepth below the file, handle() does not descend into them. Uses the stackless walk(),
+         * so the check itself works at any depth. `root` is `rootDepth` levels below the file. Lazy function bodies
+         * are checked when they are parsed, starting at the depth remembered for them here.
+         */
+        void findTooDeep(const shared<Node> &root, unsigned int rootDepth = 0) {
+            walk(root, [this, rootDepth](const shared<Node> &node, unsigned int depth) {
+                depth += rootDepth;
+                if (depth>=maxDepth) {
+                    tooDeep.insert(node.get());
+                    return VisitResult::Skip;
+                }
+                if (node->kind == SyntaxKind::Block && to<Block>(node)->lazy) lazyDepths[node.get()] = depth;
+                return VisitResult::Continue;
+            });
+        }
+
+        void parseLazyBody(const shared<Block> &block) {
+            bodyParser.parseLazyBody(file, block);
+            findTooDeep(block, lazyDepths[block.get()]);
+        }
+
         void pushName(sharedOpt<Node> name, Program &program) {
             if (!name) {
                 program.pushOp(OP::Never);
@@ -793,7 +1084,7 @@ namespace tr::checker {
             }
 
             if (name->kind == SyntaxKind::Identifier) {
-                program.pushStringLiteral(to<Identifier>(name)->escapedText, name);
+                program.pushStringLiteral(to<Identifier>(name));
             } else {
                 //computed type name like `[a]: string`
                 handle(name, program);
@@ -823,8 +1114,18 @@ namespace tr::checker {
                 throw std::runtime_error("function type not supported");
             }
 
+            if (auto block = to<Block>(body); block && block->lazy) {
+                //skipped by Parser::lazyBodies, so only declarations are checked: a declared return type is
+                //taken as is and the body only parsed when the return type has to be inferred from it
+                if (type) {
+                    body = nullptr;
+                } else {
+                    parseLazyBody(block);
+                }
+            }
+
             auto pushBodyType = [&] {
-                unsigned int bodyAddress;
+                unsigned int bodyAddress = 0; //0 is main, so never a body
                 if (body) {
                     bodyAddress = program.pushSubroutineNameLess();
                     program.pushOp(OP::TypeArgument);
@@ -908,6 +1209,15 @@ namespace tr::checker {
         }
 
         void handle(const shared<Node> &node, Program &program) {
+            if (!tooDeep.empty() && tooDeep.contains(node.get())) {
+                program.pushError(ErrorCode::TooDeep, node);
+                //statements put nothing on the stack, everything else a type
+                if (node->kind != SyntaxKind::Block && (node->kind<SyntaxKind::FirstStatement || node->kind>SyntaxKind::LastStatement)) {
+                    program.pushOp(OP::Never, node);
+                }
+                return;
+            }
+
             switch (node->kind) {
                 case SyntaxKind::SourceFile: {
                     for (auto &&statement: to<SourceFile>(node)->statements->list) {
@@ -1029,9 +1339,19 @@ namespace tr::checker {
 //                    debug("type reference {}", to<TypeReferenceNode>(node)->typeName->to<Identifier>().escapedText);
 //                    program.pushOp(OP::Number);
                     const auto n = to<TypeReferenceNode>(node);
-                    const auto name = to<Identifier>(n->typeName)->escapedText;
+                    const auto name = program.atom(to<Identifier>(n->typeName));
                     auto foundSymbol = program.findSymbol(name);
-                    if (!foundSymbol.symbol) {
+                    if (!foundSymbol.symbol && lib && lib->contains(program.atoms->hash(name))) {
+                        if (n->typeArguments) {
+                            for (auto &&p: n->typeArguments->list) {
+                                handle(p, program);
+                            }
+                        }
+                        program.pushOp(OP::CallLib, n->typeName);
+                        //storage references the text, so not the local copy
+                        program.pushStorage(to<Identifier>(n->typeName));
+                        program.pushUint16(n->typeArguments ? n->typeArguments->length() : 0);
+                    } else if (!foundSymbol.symbol) {
                         program.pushOp(OP::Never, n->typeName);
                         program.pushError(ErrorCode::CannotFind, n->typeName);
                     } else {
@@ -1064,7 +1384,7 @@ namespace tr::checker {
                 case SyntaxKind::TypeAliasDeclaration: {
                     const auto n = to<TypeAliasDeclaration>(node);
 
-                    auto &symbol = program.pushSymbolForRoutine(n->name->escapedText, SymbolType::Type, n); //move this to earlier symbol-scan round
+                    auto &symbol = program.pushSymbolForRoutine(n->name, SymbolType::Type, n); //move this to earlier symbol-scan round
                     if (symbol.declarations>1) {
                         //todo: for functions/variable embed an error that symbol was declared twice in the same scope
                     } else {
@@ -1097,7 +1417,7 @@ namespace tr::checker {
                     }
                     program.pushOp(OP::Parameter, node);
                     if (auto id = to<Identifier>(n->name)) {
-                        program.pushStorage(id->escapedText);
+                        program.pushStorage(id);
                     } else {
                         program.pushStorage("");
                     }
@@ -1110,7 +1430,7 @@ namespace tr::checker {
                 }
                 case SyntaxKind::TypeParameter: {
                     const auto n = to<TypeParameterDeclaration>(node);
-                    auto &symbol = program.pushSymbol(n->name->escapedText, SymbolType::TypeArgument, n);
+                    auto &symbol = program.pushSymbol(n->name, SymbolType::TypeArgument, n);
                     auto subroutine = program.currentSubroutine();
                     if (n->defaultType) {
                         program.pushSubroutineNameLess();
@@ -1131,7 +1451,7 @@ namespace tr::checker {
                 case SyntaxKind::FunctionDeclaration: {
                     const auto n = to<FunctionDeclaration>(node);
                     if (const auto id = to<Identifier>(n->name)) {
-                        auto &symbol = program.pushSymbolForRoutine(id->escapedText, SymbolType::Function, id); //move this to earlier symbol-scan round
+                        auto &symbol = program.pushSymbolForRoutine(id, SymbolType::Function, id); //move this to earlier symbol-scan round
                         if (symbol.declarations>1) {
                             //todo: embed error since function is declared twice
                         } else {
@@ -1153,7 +1473,7 @@ namespace tr::checker {
                 }
                 case SyntaxKind::Identifier: {
                     const auto n = to<Identifier>(node);
-                    auto foundSymbol = program.findSymbol(n->escapedText);
+                    auto foundSymbol = program.findSymbol(n);
                     if (!foundSymbol.symbol) {
                         program.pushOp(OP::Never, n);
                         program.pushError(ErrorCode::CannotFind, n);
@@ -1338,6 +1658,9 @@ namespace tr::checker {
                 }
                 case SyntaxKind::Block: {
                     const auto n = to<Block>(node);
+                    if (n->lazy) {
+                        parseLazyBody(n);
+                    }
                     for (auto &&statement: n->statements->list) {
                         handle(statement, program);
                     }
@@ -1392,7 +1715,7 @@ namespace tr::checker {
 
                         //Distribute creates implicit TypeVariable on the stack and populates it
                         //todo: we have to move it to the beginning of the subroutine
-                        auto symbol = program.pushSymbol(distributiveOverIdentifier->escapedText, SymbolType::TypeVariable, distributiveOverIdentifier);
+                        auto symbol = program.pushSymbol(distributiveOverIdentifier, SymbolType::TypeVariable, distributiveOverIdentifier);
 
                         program.pushOp(OP::Distribute);
                         distributeJumpIp = program.ip();
@@ -1500,7 +1823,7 @@ namespace tr::checker {
                         throw std::runtime_error("class without name not supported");
                     }
 
-                    auto &symbol = program.pushSymbolForRoutine(n->name->escapedText, SymbolType::Class, n); //move this to earlier symbol-scan round
+                    auto &symbol = program.pushSymbolForRoutine(n->name, SymbolType::Class, n); //move this to earlier symbol-scan round
                     if (symbol.declarations>1) {
                         //todo: for functions/variable embed an error that symbol was declared twice in the same scope
                         throw std::runtime_error("Nope");
@@ -1593,8 +1916,7 @@ namespace tr::checker {
                     switch (n->operatorToken->kind) {
                         case SyntaxKind::EqualsToken: {
                             if (n->left->kind == SyntaxKind::Identifier) {
-                                const auto name = to<Identifier>(n->left)->escapedText;
-                                auto foundSymbol = program.findSymbol(name);
+                                auto foundSymbol = program.findSymbol(to<Identifier>(n->left));
                                 if (!foundSymbol.symbol) {
                                     program.pushOp(OP::Never, n->left);
                                     program.pushError(ErrorCode::CannotFind, n->left);
@@ -1625,7 +1947,7 @@ namespace tr::checker {
                 case SyntaxKind::VariableDeclaration: {
                     const auto n = to<VariableDeclaration>(node);
                     if (const auto id = to<Identifier>(n->name)) {
-                        auto &symbol = program.pushSymbolForRoutine(id->escapedText, SymbolType::Variable, id); //move this to earlier symbol-scan round
+                        auto &symbol = program.pushSymbolForRoutine(id, SymbolType::Variable, id); //move this to earlier symbol-scan round
                         if (symbol.declarations>1) {
                             //todo: embed error since variable is declared twice
                         } else {
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <string>
+#include <map>
 #include "./instructions.h"
 #include "../core.h"
 #include "./utils.h"
+#include "./bytecode.h"
 
 namespace tr::checker {
     using std::string_view;
@@ -33,30 +35,47 @@ namespace tr::checker {
         vector<PrintSubroutine> subroutines;
         vector<DebugSourceMapEntry> sourceMap;
         PrintSubroutine *activeSubroutine = nullptr;
+
+        //how often each OP appears in subroutine bodies. A superinstruction counts as one OP, since it is one dispatch.
+        std::map<OP, unsigned int> opCounts;
+        unsigned int ops = 0;
     };
 
     inline DebugBinResult parseBin(string_view bin, bool print = false) {
-        const auto end = bin.size();
-        unsigned int storageEnd = 0;
-        bool newSubRoutine = false;
-        bool firstJump = false;
+        bool newSubRoutine = true;
         bool newLine = false;
         DebugBinResult result;
-        if (print) std::cout << fmt::format("Bin {} bytes: ", bin.size());
-
-        for (unsigned int i = 0; i < end; i++) {
-            if (storageEnd) {
-                while (i < storageEnd) {
-                    auto size = vm::readUint16(bin, i + 8);
-                    auto data = bin.substr(i + 8 + 2, size);
-                    if (print) std::cout << fmt::format("(Storage ({})\"{}\") ", size, data);
-                    result.storages.push_back(string(data));
-                    i += 8 + 2 + size;
-                }
-                debug("");
-                storageEnd = 0;
-            }
+        auto &header = bytecode::readHeader(bin);
+        const auto end = header.codeOffset + header.codeSize;
+        if (print) std::cout << fmt::format("Bin {} bytes, version {}: ", bin.size(), header.version);
+
+        for (unsigned int i = header.storageOffset; i<header.storageOffset + header.storageSize;) {
+            auto size = vm::readUint16(bin, i + 8);
+            auto data = bin.substr(i + 8 + 2, size);
+            if (print) std::cout << fmt::format("(Storage ({})\"{}\") ", size, data);
+            result.storages.push_back(string(data));
+            i += 8 + 2 + size;
+        }
+        if (print) std::cout << "\n";
+
+        for (auto &&entry: bytecode::readSourceMap(bytecode::sourceMap(bin), header.codeOffset)) {
+            DebugSourceMapEntry sourceMapEntry{
+                    .op = (OP) (bin[entry.bytecodePos]),
+                    .bytecodePos = entry.bytecodePos,
+                    .sourcePos = entry.sourcePos,
+                    .sourceEnd = entry.sourceEnd,
+            };
+            result.sourceMap.push_back(sourceMapEntry);
+            if (print) debug("Map [{}]{} to {}:{}", sourceMapEntry.bytecodePos, sourceMapEntry.op, sourceMapEntry.sourcePos, sourceMapEntry.sourceEnd);
+        }
+
+        for (auto &&entry: bytecode::readSubroutines(bin)) {
+            string name = entry.nameAddress ? string(vm::readStorage(bin, entry.nameAddress + 8)) : "";
+            if (print) std::cout << fmt::format("(Subroutine {}[{}]) ", name, entry.address);
+            result.subroutines.push_back({.name = name, .address = entry.address});
+        }
 
+        for (unsigned int i = header.codeOffset; i < end; i++) {
             if (newSubRoutine) {
                 auto found = false;
                 unsigned int j = 0;
@@ -85,44 +104,16 @@ namespace tr::checker {
                     vm::eatParams(op, &i);
                     break;
                 }
-                case OP::SourceMap: {
-                    auto size = vm::readUint32(bin, i + 1);
-                    auto start = i + 1;
-                    i += 4 + size;
-                    params += fmt::format(" {}->{} ({})", start, i, size / (4 * 3)); //each entry has 3x 4bytes (uint32)
-
-                    for (unsigned int j = start + 4; j < i; j += 4 * 3) {
-                        DebugSourceMapEntry sourceMapEntry{
-                                                                   .op = (OP)(bin[vm::readUint32(bin, j)]),
-                                                                   .bytecodePos = vm::readUint32(bin, j),
-                                                                   .sourcePos = vm::readUint32(bin, j + 4),
-                                                                   .sourceEnd =  vm::readUint32(bin, j + 8),
-                                                           };
-                        result.sourceMap.push_back(sourceMapEntry);
-                        if (print) debug("Map [{}]{} to {}:{}", sourceMapEntry.bytecodePos, sourceMapEntry.op, sourceMapEntry.sourcePos, sourceMapEntry.sourceEnd);
-                    }
-                    break;
-                }
-                case OP::Subroutine: {
-                    auto nameAddress = vm::readUint32(bin, i + 1);
-                    auto address = vm::readUint32(bin, i + 5);
-                    string name = nameAddress ? string(vm::readStorage(bin, nameAddress + 8)) : "";
-                    params += fmt::format(" {}[{}]", name, address);
+                case OP::CallLib: {
+                    params += fmt::format(" {}[{}]", vm::readStorage(bin, vm::readUint32(bin, i + 1) + 8), vm::readUint16(bin, i + 5));
                     vm::eatParams(op, &i);
-                    result.subroutines.push_back({.name = name, .address = address});
                     break;
                 }
                 case OP::Jump: {
                     auto address = vm::readInt32(bin, i + 1);
                     params += fmt::format(" [{}, +{}]", startI + address, address);
                     vm::eatParams(op, &i);
-                    if (!firstJump) storageEnd = address;
-                    if (firstJump) newLine = true;
-                    firstJump = true;
-                    break;
-                }
-                case OP::Main: {
-                    newSubRoutine = true;
+                    newLine = true;
                     break;
                 }
                 case OP::Return: {
@@ -193,12 +184,39 @@ namespace tr::checker {
                 case OP::Parameter:
                 case OP::NumberLiteral:
                 case OP::BigIntLiteral:
-                case OP::StringLiteral: {
+                case OP::StringLiteral:
+                case OP::StringLiteralPropertySignature: {
                     auto address = vm::readUint32(bin, i + 1);
                     params += fmt::format(" \"{}\"", vm::readStorage(bin, address + 8));
                     vm::eatParams(op, &i);
                     break;
                 }
+                case OP::StringPropertySignature:
+                case OP::NumberPropertySignature: {
+                    auto address = vm::readUint32(bin, i + 2);
+                    params += fmt::format(" \"{}\"", vm::readStorage(bin, address + 8));
+                    vm::eatParams(op, &i);
+                    break;
+                }
+                case OP::LoadsDistribute: {
+                    params += fmt::format(" {} {} &{} [{}, +{}]", vm::readUint16(bin, i + 1), vm::readUint16(bin, i + 3),
+                                          vm::readUint16(bin, i + 6), startI + 5 + vm::readUint32(bin, i + 8), vm::readUint32(bin, i + 8));
+                    vm::eatParams(op, &i);
+                    newLine = true;
+                    break;
+                }
+                case OP::ExtendsJumpCondition: {
+                    params += fmt::format(" [{}]", startI + 1 + vm::readUint32(bin, i + 2));
+                    vm::eatParams(op, &i);
+                    newLine = true;
+                    break;
+                }
+                case OP::LoadsExtendsJumpCondition: {
+                    params += fmt::format(" {} {} [{}]", vm::readUint16(bin, i + 1), vm::readUint16(bin, i + 3), startI + 6 + vm::readUint32(bin, i + 7));
+                    vm::eatParams(op, &i);
+                    newLine = true;
+                    break;
+                }
             }
 
             string text;
@@ -209,6 +227,8 @@ namespace tr::checker {
             }
             if (result.activeSubroutine) {
                 result.activeSubroutine->operations.push_back({.text = text, .address = startI});
+                result.opCounts[op]++;
+                result.ops++;
             } else {
                 result.operations.push_back(text);
             }
@@ -225,4 +245,17 @@ namespace tr::checker {
     inline void printBin(string_view bin) {
         parseBin(bin, true);
     }
+
+    /**
+     * Prints how often each OP is used in the subroutines, most used first.
+     */
+    inline void printOpStats(string_view bin) {
+        auto result = parseBin(bin);
+        vector<std::pair<OP, unsigned int>> counts(result.opCounts.begin(), result.opCounts.end());
+        std::sort(counts.begin(), counts.end(), [](auto &a, auto &b) { return a.second > b.second; });
+        std::cout << fmt::format("{} OPs in {} subroutines\n", result.ops, result.subroutines.size());
+        for (auto &&[op, count]: counts) {
+            std::cout << fmt::format("  {}: {}\n", op, count);
+        }
+    }
 }
\ No newline at end of file
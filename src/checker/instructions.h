@@ -145,14 +145,35 @@ namespace tr::instructions {
         CheckBody,
         InferBody,
         UnwrapInferBody,
+        CallLib, //call a global type of the lib snapshot by name (storage address), see vm2::lib
+
+        /**
+         * Superinstructions, created by the peephole pass in Subroutine::optimise().
+         *
+         * Only the first OP of a sequence is replaced by the superinstruction. All following OPs and parameters stay
+         * untouched, so addresses, the source map, and jumps into the middle of a sequence (e.g. the loop jump back to
+         * Distribute) keep working. The VM executes the whole sequence in one dispatch and continues after it.
+         */
+        LoadsDistribute, //Loads + Distribute
+        StringLiteralPropertySignature, //StringLiteral + PropertySignature
+        StringPropertySignature, //String + StringLiteral + PropertySignature
+        NumberPropertySignature, //Number + StringLiteral + PropertySignature
+        ExtendsJumpCondition, //Extends + JumpCondition, no boolean literal is created
+        LoadsExtendsJumpCondition, //Loads + Extends + JumpCondition
     };
 
     enum class ErrorCode {
         CannotFind, //e.g. Cannot find name 'abc'
+        TooDeep, //subtree nested deeper than Compiler::maxDepth, not checked
     };
 
     //Max 8 bits, used in the bytecode
     enum SubroutineFlag: unsigned int {
+        /**
+         * The subroutine is closed (no type arguments, only references other constant subroutines) and builds
+         * always the same type. The VM materializes it once per module and keeps it across runs.
+         */
+        Constant = 1<<0,
     };
 }
 
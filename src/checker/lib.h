@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include "../fs.h"
+#include "../parser2.h"
+#include "./bytecode.h"
+#include "./verifier.h"
+#include "./compiler.h"
+#include "./module2.h"
+#include "./vm2.h"
+
+namespace tr::checker {
+    using std::string;
+
+    /**
+     * Curated global declarations, resolved by the compiler via OP::CallLib.
+     * Only what the compiler supports so far. Mapped types like Partial<T> or Record<K, T> follow once they are implemented.
+     */
+    constexpr auto libSource = R"(
+type PropertyKey = string | number;
+type Array<T> = T[];
+type ReadonlyArray<T> = T[];
+type Exclude<T, U> = T extends U ? never : T;
+type Extract<T, U> = T extends U ? T : never;
+type NonNullable<T> = T extends null | undefined ? never : T;
+)";
+
+    constexpr auto libFileName = "lib.d.ts";
+
+    inline string compileLib() {
+        Parser parser;
+        auto result = parser.parseSourceFile(libFileName, libSource, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+        Compiler compiler;
+        return compiler.compileSourceFile(result).build();
+    }
+
+    /**
+     * Path of the lib snapshot: $TYPERUNNER_LIB, or the one typerunner_snapshot wrote at build time.
+     */
+    inline string libSnapshotPath() {
+        if (auto path = std::getenv("TYPERUNNER_LIB"); path && *path) return path;
+#ifdef TYPERUNNER_LIB_SNAPSHOT
+        return TYPERUNNER_LIB_SNAPSHOT;
+#else
+        return "";
+#endif
+    }
+
+    /**
+     * Maps the lib snapshot, so no lib source is parsed at startup. When there is no valid snapshot
+     * (not built yet, or built by another compiler version), libSource is compiled instead.
+     *
+     * Use vm2::setLib() with the result, and pass its symbols to Compiler::lib.
+     */
+    inline shared<vm2::Module> loadLib(const string &snapshot = libSnapshotPath()) {
+        if (!snapshot.empty() && fileExists(snapshot)) {
+            try {
+                auto mapped = fileMap(snapshot);
+                bytecode::verifyChecksum(mapped->view());
+                verify(mapped->view());
+                auto module = std::make_shared<vm2::Module>(mapped->view(), mapped, libFileName, "");
+                module->verified = true;
+                return module;
+            } catch (std::runtime_error &error) {
+            }
+        }
+        return std::make_shared<vm2::Module>(compileLib(), libFileName, libSource);
+    }
+}
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <string>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include "../core.h"
+#include "../fs.h"
 #include "./utils.h"
 #include "./types2.h"
 #include "./instructions.h"
+#include "./bytecode.h"
+#include "./verifier.h"
 #include "../utf.h"
 
 namespace tr::vm2 {
@@ -43,6 +49,85 @@ namespace tr::vm2 {
         map.pos = eatWhitespace(code, map.pos);
     }
 
+    /**
+     * Owns the types of constant subroutines (see instructions::SubroutineFlag::Constant).
+     * They live outside the VM pools, so they survive the pool reset in run() and are only freed with the module.
+     */
+    struct ConstantPool {
+        std::deque<Type> types;
+        std::deque<TypeRef> refs;
+        vector<std::unique_ptr<TypeRef[]>> tables;
+        //pool type -> its clone (and clone -> itself), so types shared between constants stay shared. Only valid while materializing.
+        std::unordered_map<Type *, Type *> cloned;
+
+        Type *clone(Type *type) {
+            auto found = cloned.find(type);
+            if (found != cloned.end()) {
+                found->second->refCount++;
+                return found->second;
+            }
+
+            auto copy = &types.emplace_back(type->kind, type->hash);
+            cloned[type] = cloned[copy] = copy;
+            copy->ip = type->ip;
+            copy->flag = type->flag | TypeFlag::Stored;
+            copy->refCount = 1;
+            copy->size = type->size;
+
+            switch (type->kind) {
+                case TypeKind::Literal: {
+                    if (type->type) {
+                        copy->setDynamicText(type->text, type->hash);
+                    } else {
+                        copy->text = type->text;
+                    }
+                    break;
+                }
+                case TypeKind::Array:
+                case TypeKind::Rest:
+                case TypeKind::TupleMember:
+                case TypeKind::Parameter: {
+                    copy->text = type->text;
+                    copy->type = clone((Type *) type->type);
+                    break;
+                }
+                case TypeKind::FunctionRef:
+                case TypeKind::ClassRef: {
+                    break;
+                }
+                default: {
+                    copy->text = type->text;
+                    TypeRef *last = nullptr;
+                    for (auto current = (TypeRef *) type->type; current; current = current->next) {
+                        auto ref = &refs.emplace_back(clone(current->type));
+                        if (last) {
+                            last->next = ref;
+                        } else {
+                            copy->type = ref;
+                        }
+                        last = ref;
+                    }
+                }
+            }
+
+            if (!type->children.empty()) {
+                //rebuild the hash table with the cloned children
+                auto size = type->children.size();
+                auto &table = tables.emplace_back(new TypeRef[size]);
+                copy->children = {table.get(), size};
+                for (auto current = (TypeRef *) copy->type; current; current = current->next) {
+                    auto &entry = copy->children[current->type->hash % size];
+                    if (entry.type) {
+                        entry.next = &refs.emplace_back(current->type, entry.next);
+                    } else {
+                        entry.type = current->type;
+                    }
+                }
+            }
+            return copy;
+        }
+    };
+
     struct Module;
 
     struct DiagnosticMessage {
@@ -60,18 +145,87 @@ namespace tr::vm2 {
     };
 
     struct Module {
-        const string bin;
+    private:
+        string ownedBin; //when bin was passed as string
+        std::shared_ptr<const void> owner; //keeps external bin memory (e.g. MappedFile) alive
+        string sourcePath; //to load code lazily
+        string code; //for diagnostic messages only, see getCode()
+        bool codeLoaded = false;
+
+        //decoded on first use, see getSourceMap()
+        vector<bytecode::SourceMapEntry> sourceMap;
+        bool sourceMapLoaded = false;
+        optional<string_view> attachedSourceMap;
+        std::shared_ptr<const void> sourceMapOwner;
+
+    public:
+        string_view bin;
         string fileName = "index.ts";
-        const string code = ""; //for diagnostic messages only
 
         vector<ModuleSubroutine> subroutines;
-        unsigned int sourceMapAddress;
-        unsigned int sourceMapAddressEnd;
 
         vector<DiagnosticMessage> errors;
+        bool verified = false; //checksum and structure of bin verified, see checker::verify()
+
+        //materialized types of constant subroutines, indexed like subroutines. They survive clear().
+        vector<Type *> constants;
+        bool constantsMaterialized = false;
+        ConstantPool constantPool;
+
+        //name hash -> subroutine index, only filled for the lib, see vm2::setLib()
+        std::unordered_map<uint64_t, unsigned int> symbols;
+
         Module() {}
 
-        Module(const string_view &bin, const string &fileName, const string &code): bin(bin), fileName(fileName), code(code) {
+        Module(const string_view &bin, const string &fileName, const string &code): ownedBin(bin), code(code), codeLoaded(true), bin(ownedBin), fileName(fileName) {
+        }
+
+        /**
+         * Zero-copy module: `bin` is not copied and has to stay valid as long as `owner` lives, e.g. a MappedFile.
+         * The source code is read from `sourcePath` only when diagnostics need it.
+         */
+        Module(const string_view &bin, std::shared_ptr<const void> owner, const string &fileName, const string &sourcePath):
+                owner(std::move(owner)), sourcePath(sourcePath), bin(bin), fileName(fileName) {
+        }
+
+        //bin can point into ownedBin
+        Module(const Module &) = delete;
+        Module &operator=(const Module &) = delete;
+
+        const string &getCode() {
+            if (!codeLoaded) {
+                codeLoaded = true;
+                if (!sourcePath.empty() && fileExists(sourcePath)) code = fileRead(sourcePath);
+            }
+            return code;
+        }
+
+        /**
+         * Uses a source map that was stored separately (see bytecode::withoutSourceMap()) instead of the one in bin.
+         * `map` has to stay valid as long as `owner` lives.
+         */
+        void attachSourceMap(string_view map, std::shared_ptr<const void> owner = nullptr) {
+            attachedSourceMap = map;
+            sourceMapOwner = std::move(owner);
+            sourceMapLoaded = false;
+        }
+
+        /**
+         * The source map is only verified and decoded when a diagnostic needs a position, so runs without errors never touch it.
+         * An invalid or missing map means diagnostics have no position.
+         */
+        const vector<bytecode::SourceMapEntry> &getSourceMap() {
+            if (!sourceMapLoaded) {
+                sourceMapLoaded = true;
+                auto map = attachedSourceMap ? *attachedSourceMap : bytecode::sourceMap(bin);
+                try {
+                    bytecode::verifySourceMap(bin, map);
+                    sourceMap = bytecode::readSourceMap(map, bytecode::readHeader(bin).codeOffset);
+                } catch (std::runtime_error &error) {
+                    sourceMap.clear();
+                }
+            }
+            return sourceMap;
         }
 
         void clear() {
@@ -90,30 +244,19 @@ namespace tr::vm2 {
         string findIdentifier(unsigned int ip) {
             auto map = findNormalizedMap(ip);
             if (!map.found()) return "";
-            return code.substr(map.pos, map.end - map.pos);
+            return getCode().substr(map.pos, map.end - map.pos);
         }
 
         FoundSourceMap findMap(unsigned int ip) {
-            unsigned int found = 0;
-            for (unsigned int i = sourceMapAddress; i < sourceMapAddressEnd; i += 3 * 4) {
-                auto mapIp = vm::readUint32(bin, i);
-                if (mapIp == ip) {
-                    found = i;
-                    break;
-                }
-//                if (mapIp > ip) break;
-//                found = i;
-            }
-
-            if (found) {
-                return {vm::readUint32(bin, found + 4), vm::readUint32(bin, found + 8)};
+            for (auto &&entry: getSourceMap()) {
+                if (entry.bytecodePos == ip) return {entry.sourcePos, entry.sourceEnd};
             }
             return {0, 0};
         }
 
         FoundSourceMap findNormalizedMap(unsigned int ip) {
             auto map = findMap(ip);
-            if (map.found()) omitWhitespace(code, map);
+            if (map.found()) omitWhitespace(getCode(), map);
             return map;
         }
 
@@ -121,6 +264,7 @@ namespace tr::vm2 {
          * Converts FindSourceMap{x,y} to
          */
         FoundSourceLineCharacter mapToLineCharacter(FoundSourceMap map) {
+            auto &code = getCode();
             unsigned int pos = 0;
             unsigned int line = 0;
             while (pos < map.pos) {
@@ -139,6 +283,7 @@ namespace tr::vm2 {
 
         void printErrors() {
             for (auto &&e: errors) {
+                auto &code = getCode();
                 if (e.ip) {
                     auto map = findNormalizedMap(e.ip);
 
@@ -163,38 +308,18 @@ namespace tr::vm2 {
 
     inline void parseHeader(shared<Module> &module) {
         auto &bin = module->bin;
-        auto end = bin.size();
-        bool main = true;
-        for (unsigned int i = 0; i < end; i++) {
-            const auto op = (OP) bin[i];
-            switch (op) {
-                case OP::Jump: {
-                    i = vm::readUint32(bin, i + 1) - 1; //minus 1 because for's i++
-                    break;
-                }
-                case OP::SourceMap: {
-                    unsigned int size = vm::readUint32(bin, i + 1);
-                    module->sourceMapAddress = i + 1 + 4;
-                    i += 4 + size;
-                    module->sourceMapAddressEnd = i;
-                    break;
-                }
-                case OP::Subroutine: {
-                    unsigned int nameAddress = vm::readUint32(bin, i + 1);
-                    auto name = nameAddress ? vm::readStorage(bin, nameAddress + 8) : "";
-                    unsigned int address = vm::readUint32(bin, i + 5);
-                    unsigned int flags = vm::readUint32(bin, i + 5 + 4);
-                    vm::eatParams(op, &i);
-                    module->subroutines.push_back(ModuleSubroutine(name, address, flags, main));
-                    main = false;
-                    break;
-                }
-                case OP::Main: {
-                    return;
-                }
-            }
+        if (!module->verified) {
+            bytecode::verifyChecksum(bin);
+            checker::verify(bin);
+            module->verified = true;
         }
 
-        throw std::runtime_error("No OP::Main found");
+        auto entries = bytecode::readSubroutines(bin);
+        module->subroutines.reserve(entries.size());
+        for (unsigned int i = 0; i<entries.size(); i++) {
+            auto &entry = entries[i];
+            auto name = entry.nameAddress ? vm::readStorage(bin, entry.nameAddress + 8) : "";
+            module->subroutines.push_back(ModuleSubroutine(name, entry.address, entry.flags, i == 0));
+        }
     }
 }
\ No newline at end of file
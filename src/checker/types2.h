@@ -4,6 +4,7 @@
 #include <functional>
 #include <array>
 #include <vector>
+#include <span>
 #include "../enum.h"
 #include "../hash.h"
 
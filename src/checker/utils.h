@@ -3,6 +3,7 @@
 #include <utility>
 #include <vector>
 #include <string>
+#include <stdexcept>
 #include "./instructions.h"
 
 namespace tr::vm {
@@ -57,6 +58,63 @@ namespace tr::vm {
         *(uint16_t *) (bin.data() + offset) = value;
     }
 
+    //writers for pre-sized buffers, they do not check bounds
+    inline void writeUint16(char *bin, unsigned int offset, uint16_t value) {
+        *(uint16_t *) (bin + offset) = value;
+    }
+
+    inline void writeUint32(char *bin, unsigned int offset, uint32_t value) {
+        *(uint32_t *) (bin + offset) = value;
+    }
+
+    inline void writeUint64(char *bin, unsigned int offset, uint64_t value) {
+        *(uint64_t *) (bin + offset) = value;
+    }
+
+    /**
+     * LEB128 varints: 7 bits per byte, the high bit marks that another byte follows.
+     * Only used for the tables around the code, the code itself is fixed-width since the VM executes it in place.
+     */
+    inline unsigned int varintSize(uint32_t value) {
+        unsigned int size = 1;
+        while (value>=0x80) {
+            value >>= 7;
+            size++;
+        }
+        return size;
+    }
+
+    //returns the offset after the written varint
+    inline unsigned int writeVarint(char *bin, unsigned int offset, uint32_t value) {
+        while (value>=0x80) {
+            bin[offset++] = (char) (value | 0x80);
+            value >>= 7;
+        }
+        bin[offset++] = (char) value;
+        return offset;
+    }
+
+    //advances offset, throws when the varint is truncated or too long
+    inline uint32_t readVarint(const string_view &bin, unsigned int &offset) {
+        uint32_t value = 0;
+        for (unsigned int shift = 0; shift<35; shift += 7) {
+            if (offset>=bin.size()) throw std::runtime_error("Invalid bytecode: truncated varint");
+            const auto byte = (unsigned char) bin[offset++];
+            value |= (uint32_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Invalid bytecode: varint too long");
+    }
+
+    //maps small negative deltas to small varints: 0, -1, 1, -2, ... => 0, 1, 2, 3, ...
+    inline uint32_t zigzag(int32_t value) {
+        return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+    }
+
+    inline int32_t unzigzag(uint32_t value) {
+        return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+    }
+
     inline string_view readStorage(const string_view &bin, const uint32_t offset) {
         const auto size = readUint16(bin, offset);
         return string_view(reinterpret_cast<const char *>(bin.data() + offset + 2), size);
@@ -66,6 +124,7 @@ namespace tr::vm {
     inline void eatParams(OP op, unsigned int *i) {
         switch (op) {
             case OP::TailCall:
+            case OP::CallLib:
             case OP::Call: {
                 *i += 6;
                 break;
@@ -135,6 +194,28 @@ namespace tr::vm {
                 *i += 4;
                 break;
             }
+            //superinstructions span all OPs of their sequence
+            case OP::LoadsDistribute: {
+                *i += 4 + 1 + 2 + 4;
+                break;
+            }
+            case OP::StringLiteralPropertySignature: {
+                *i += 4 + 1;
+                break;
+            }
+            case OP::StringPropertySignature:
+            case OP::NumberPropertySignature: {
+                *i += 1 + 4 + 1;
+                break;
+            }
+            case OP::ExtendsJumpCondition: {
+                *i += 1 + 4;
+                break;
+            }
+            case OP::LoadsExtendsJumpCondition: {
+                *i += 4 + 1 + 1 + 4;
+                break;
+            }
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "../enum.h"
+#include "./bytecode.h"
+#include "./instructions.h"
+#include "./utils.h"
+
+namespace tr::checker {
+    using std::string;
+    using std::string_view;
+    using std::vector;
+    using instructions::OP;
+
+    /**
+     * One-time verification of a binary, done when a module is loaded (see vm2::parseHeader()).
+     *
+     * It proves what vm2::process() relies on without checking it itself:
+     *
+     *  - storage entries are within their section, the subroutine table covers the code section,
+     *  - every subroutine decodes into OPs the VM implements, with all parameters inside the subroutine,
+     *  - storage addresses point to storage entries, subroutine addresses to existing subroutines,
+     *  - jumps land on an OP of the same subroutine, superinstructions are followed by their sequence,
+     *  - the stack height is the same on all paths to an OP, nothing pops below the frame, and every path ends with Return or Halt.
+     *
+     * Types on the stack are not known statically, so errors like instantiating something that is not a function
+     * are still detected at runtime.
+     */
+    class Verifier {
+        struct Effect {
+            unsigned int pop;
+            unsigned int push;
+        };
+
+        string_view bin;
+        const bytecode::Header &header;
+        vector<bool> storageEntries; //indexed by address - storageOffset
+        vector<unsigned int> starts;
+        vector<bool> inferBody; //executed via OP::InferBody, its frame starts with the union of all return statements
+
+        [[noreturn]] void fail(unsigned int ip, const string &message) {
+            throw std::runtime_error(fmt::format("Invalid bytecode: {} at {}", message, ip));
+        }
+
+        unsigned int end(unsigned int index) {
+            return index + 1<starts.size() ? starts[index + 1] : header.codeOffset + header.codeSize;
+        }
+
+        /**
+         * Parameters of the OP itself. Superinstructions only replaced the first OP of their sequence,
+         * so they have the parameters of that one and the following OPs are decoded on their own.
+         */
+        unsigned int parameters(OP op) {
+            switch (op) {
+                case OP::LoadsDistribute:
+                case OP::LoadsExtendsJumpCondition:
+                case OP::StringLiteralPropertySignature: return 4;
+                case OP::StringPropertySignature:
+                case OP::NumberPropertySignature:
+                case OP::ExtendsJumpCondition: return 0;
+            }
+            unsigned int i = 0;
+            vm::eatParams(op, &i);
+            return i;
+        }
+
+        /**
+         * Stack effect as implemented in vm2::process(). Returns false for OPs the VM does not implement.
+         */
+        bool effect(OP op, unsigned int ip, unsigned int routine, Effect &effect) {
+            switch (op) {
+                case OP::Noop:
+                case OP::Error:
+                case OP::Inline:
+                case OP::Initializer:
+                    effect = {0, 0};
+                    return true;
+                case OP::Never:
+                case OP::Any:
+                case OP::Unknown:
+                case OP::String:
+                case OP::Number:
+                case OP::Boolean:
+                case OP::Null:
+                case OP::Undefined:
+                case OP::True:
+                case OP::False:
+                case OP::StringLiteral:
+                case OP::NumberLiteral:
+                case OP::BigIntLiteral:
+                case OP::FunctionRef:
+                case OP::ClassRef:
+                case OP::Loads:
+                case OP::LoadsDistribute:
+                case OP::LoadsExtendsJumpCondition:
+                case OP::StringLiteralPropertySignature:
+                case OP::StringPropertySignature:
+                case OP::NumberPropertySignature:
+                case OP::InferBody:
+                case OP::SelfCheck:
+                case OP::TypeArgument:
+                case OP::TypeArgumentDefault:
+                    effect = {0, 1};
+                    return true;
+                case OP::Parameter:
+                case OP::Set:
+                case OP::Array:
+                case OP::Rest:
+                case OP::RestReuse:
+                case OP::TupleMember:
+                case OP::Length:
+                case OP::Static:
+                case OP::Optional:
+                case OP::Widen:
+                case OP::UnwrapInferBody:
+                case OP::CheckBody:
+                case OP::Readonly:
+                    effect = {1, 1};
+                    return true;
+                case OP::Pop:
+                case OP::TypeArgumentConstraint:
+                    effect = {1, 0};
+                    return true;
+                case OP::Assign:
+                    effect = {2, 0};
+                    return true;
+                case OP::Extends:
+                case OP::ExtendsJumpCondition:
+                case OP::IndexAccess:
+                case OP::PropertyAccess:
+                case OP::PropertySignature:
+                    effect = {2, 1};
+                    return true;
+                case OP::ReturnStatement:
+                    effect = {inferBody[routine] ? 1u : 0u, 0};
+                    return true;
+                case OP::New:
+                    effect = {1, 0};
+                    return true;
+                case OP::Slots:
+                    effect = {0, vm::readUint16(bin, ip + 1)};
+                    return true;
+                case OP::Call:
+                case OP::TailCall:
+                case OP::CallLib:
+                    effect = {vm::readUint16(bin, ip + 5), 1};
+                    return true;
+                case OP::Instantiate:
+                case OP::CallExpression:
+                case OP::Function:
+                case OP::Method:
+                    effect = {1u + vm::readUint16(bin, ip + 1), 1};
+                    return true;
+                case OP::Union:
+                case OP::Tuple:
+                case OP::Class:
+                case OP::ObjectLiteral:
+                case OP::TemplateLiteral:
+                    effect = {vm::readUint16(bin, ip + 1), 1};
+                    return true;
+                //control flow, see verifyStack()
+                case OP::Halt:
+                case OP::Return:
+                case OP::Jump:
+                case OP::JumpCondition:
+                case OP::Distribute:
+                    effect = {0, 0};
+                    return true;
+            }
+            return false;
+        }
+
+        bool isStorageEntry(unsigned int address) {
+            return address>=header.storageOffset && address - header.storageOffset<storageEntries.size() && storageEntries[address - header.storageOffset];
+        }
+
+        void verifySections() {
+            if ((uint64_t) header.storageOffset + header.storageSize>header.subroutinesOffset) fail(0, "storage out of bounds");
+
+            storageEntries.assign(header.storageSize, false);
+            for (unsigned int i = 0; i<header.storageSize;) {
+                if (i + 8 + 2>header.storageSize) fail(header.storageOffset + i, "incomplete storage entry");
+                storageEntries[i] = true;
+                i += 8 + 2 + vm::readUint16(bin, header.storageOffset + i + 8);
+                if (i>header.storageSize) fail(header.storageOffset + i, "storage entry out of bounds");
+            }
+
+            //checks that the table covers exactly the code section
+            auto subroutines = bytecode::readSubroutines(bin);
+            if (subroutines.empty()) fail(header.subroutinesOffset, "no main subroutine");
+            for (auto &&entry: subroutines) {
+                if (entry.nameAddress && !isStorageEntry(entry.nameAddress)) fail(header.subroutinesOffset, "subroutine name is not a storage entry");
+                starts.push_back(entry.address);
+            }
+            inferBody.assign(subroutines.size(), false);
+        }
+
+        /**
+         * Decodes the OPs of a subroutine and checks their parameters. Returns which bytes start an OP.
+         */
+        vector<bool> decode(unsigned int routine) {
+            const auto start = starts[routine];
+            const auto routineEnd = end(routine);
+            vector<bool> opStart(routineEnd - start, false);
+            Effect unused;
+
+            for (unsigned int ip = start; ip<routineEnd;) {
+                const auto op = (OP) (unsigned char) bin[ip];
+                if ((unsigned char) op>=magic_enum::enum_count<OP>() || !effect(op, ip, routine, unused)) {
+                    fail(ip, fmt::format("unsupported OP {}", (unsigned int) (unsigned char) op));
+                }
+                const auto next = ip + 1 + parameters(op);
+                if (next>routineEnd) fail(ip, "parameters out of subroutine");
+                opStart[ip - start] = true;
+
+                switch (op) {
+                    case OP::StringLiteral:
+                    case OP::NumberLiteral:
+                    case OP::BigIntLiteral:
+                    case OP::Parameter:
+                    case OP::CallLib:
+                    case OP::StringLiteralPropertySignature: {
+                        if (!isStorageEntry(vm::readUint32(bin, ip + 1))) fail(ip, "address is not a storage entry");
+                        break;
+                    }
+                    case OP::Call:
+                    case OP::TailCall:
+                    case OP::SelfCheck:
+                    case OP::InferBody:
+                    case OP::Inline:
+                    case OP::Set:
+                    case OP::CheckBody:
+                    case OP::TypeArgumentDefault:
+                    case OP::FunctionRef:
+                    case OP::ClassRef: {
+                        const auto address = vm::readUint32(bin, ip + 1);
+                        if (address>=header.subroutineCount) fail(ip, fmt::format("subroutine {} does not exist", address));
+                        if (op == OP::InferBody) inferBody[address] = true;
+                        break;
+                    }
+                    case OP::Function:
+                    case OP::Method:
+                    case OP::TemplateLiteral: {
+                        //the first entry (return type or first part) is always read
+                        if (vm::readUint16(bin, ip + 1) == 0) fail(ip, "empty");
+                        break;
+                    }
+                }
+                ip = next;
+            }
+            return opStart;
+        }
+
+        void expect(unsigned int ip, OP op) {
+            if (ip>=bin.size() || (OP) (unsigned char) bin[ip] != op) fail(ip, fmt::format("expected {} in superinstruction", magic_enum::enum_name(op)));
+        }
+
+        void verifySequence(OP op, unsigned int ip) {
+            switch (op) {
+                case OP::LoadsDistribute: return expect(ip + 5, OP::Distribute);
+                case OP::StringLiteralPropertySignature: return expect(ip + 5, OP::PropertySignature);
+                case OP::StringPropertySignature:
+                case OP::NumberPropertySignature: {
+                    expect(ip + 1, OP::StringLiteral);
+                    return expect(ip + 6, OP::PropertySignature);
+                }
+                case OP::ExtendsJumpCondition: return expect(ip + 1, OP::JumpCondition);
+                case OP::LoadsExtendsJumpCondition: {
+                    expect(ip + 5, OP::Extends);
+                    return expect(ip + 6, OP::JumpCondition);
+                }
+            }
+        }
+
+        /**
+         * Follows all paths through the subroutine and tracks the stack height relative to the frame.
+         * Type arguments count as pushed, whether provided by the caller or not, since OP::TypeArgument ensures the entry.
+         */
+        void verifyStack(unsigned int routine, const vector<bool> &opStart) {
+            const auto start = starts[routine];
+            const auto routineEnd = end(routine);
+            const bool main = routine == 0;
+            vector<int> heights(routineEnd - start, -1);
+            vector<unsigned int> work;
+
+            auto visit = [&](unsigned int from, unsigned int ip, int height) {
+                if (ip<start || ip>=routineEnd) fail(from, ip == routineEnd ? "missing Return" : "jump out of subroutine");
+                if (!opStart[ip - start]) fail(from, "jump into parameters");
+                auto &known = heights[ip - start];
+                if (known == -1) {
+                    known = height;
+                    work.push_back(ip);
+                } else if (known != height) {
+                    fail(ip, fmt::format("unbalanced stack, height {} and {}", known, height));
+                }
+            };
+            auto need = [&](unsigned int ip, int height, unsigned int size) {
+                if (height<(int) size) fail(ip, fmt::format("stack underflow, needs {} but has {}", size, height));
+            };
+
+            visit(start, start, inferBody[routine] ? 1 : 0);
+            while (!work.empty()) {
+                const auto ip = work.back();
+                work.pop_back();
+                auto height = heights[ip - start];
+                const auto op = (OP) (unsigned char) bin[ip];
+                const auto next = ip + 1 + parameters(op);
+                verifySequence(op, ip);
+
+                switch (op) {
+                    case OP::Halt: {
+                        continue;
+                    }
+                    case OP::Return: {
+                        if (!main) need(ip, height, 1);
+                        continue;
+                    }
+                    case OP::Jump: {
+                        visit(ip, ip + vm::readInt32(bin, ip + 1), height);
+                        continue;
+                    }
+                    case OP::JumpCondition: {
+                        need(ip, height, 1);
+                        visit(ip, next, height - 1);
+                        visit(ip, ip + vm::readUint32(bin, ip + 1), height - 1);
+                        continue;
+                    }
+                    case OP::Distribute: {
+                        //pops the union and runs the section once per member into the slot, each run leaves one result
+                        //that is merged at the end into one type, so both the loop and its end see the same height.
+                        need(ip, height, 1);
+                        if (vm::readUint16(bin, ip + 1)>=height - 1) fail(ip, "slot out of frame");
+                        visit(ip, next, height - 1);
+                        visit(ip, ip + vm::readUint32(bin, ip + 3), height);
+                        continue;
+                    }
+                    case OP::Loads:
+                    case OP::LoadsDistribute:
+                    case OP::LoadsExtendsJumpCondition: {
+                        //loads from parent frames depend on the caller and are not verified
+                        if (vm::readUint16(bin, ip + 1) == 0 && vm::readUint16(bin, ip + 3)>=height) fail(ip, "load out of frame");
+                        break;
+                    }
+                }
+
+                Effect e;
+                effect(op, ip, routine, e);
+                need(ip, height, e.pop);
+                visit(ip, next, height - (int) e.pop + (int) e.push);
+            }
+        }
+
+    public:
+        explicit Verifier(string_view bin): bin(bin), header(bytecode::readHeader(bin)) {}
+
+        void verify() {
+            verifySections();
+            vector<vector<bool>> opStarts;
+            opStarts.reserve(header.subroutineCount);
+            //decode all first, so InferBody targets are known
+            for (unsigned int i = 0; i<header.subroutineCount; i++) opStarts.push_back(decode(i));
+            for (unsigned int i = 0; i<header.subroutineCount; i++) verifyStack(i, opStarts[i]);
+        }
+    };
+
+    /**
+     * Throws std::runtime_error when `bin` could make vm2::process() misbehave. See Verifier.
+     */
+    inline void verify(string_view bin) {
+        Verifier(bin).verify();
+    }
+}
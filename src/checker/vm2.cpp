@@ -5,8 +5,86 @@
 #include "Tracy.hpp"
 
 namespace tr::vm2 {
+    /**
+     * Cached results of lib subroutines live in the pools, which are cleared with every run, so only the constants stay.
+     */
+    void resetLib() {
+        if (!lib) return;
+        for (unsigned int i = 0; i<lib->subroutines.size(); i++) {
+            lib->subroutines[i].result = lib->constants[i];
+            lib->subroutines[i].narrowed = nullptr;
+        }
+    }
+
+    /**
+     * Evaluates all constant subroutines once and moves their types into the module's constant pool.
+     * Each is executed as root frame, so OP::Return stops process() after it stored the result.
+     */
+    void materializeConstants(shared<Module> &module) {
+        module->constants.assign(module->subroutines.size(), nullptr);
+        //constants are evaluated in one go, even when stepping through the program
+        auto stepping = stepper;
+        stepper = false;
+
+        for (unsigned int i = 0; i<module->subroutines.size(); i++) {
+            auto routine = &module->subroutines[i];
+            if (!(routine->flags & instructions::SubroutineFlag::Constant)) continue;
+
+            if (!routine->result) {
+                //might be already evaluated as dependency of a previous constant
+                sp = 0;
+                subroutine = activeSubroutines.reset();
+                subroutine->module = module.get();
+                subroutine->subroutine = routine;
+                subroutine->ip = routine->address;
+                subroutine->initialSp = sp;
+                subroutine->depth = 0;
+                subroutine->typeArguments = 0;
+                subroutine->variables = 0;
+                subroutine->flags = 0;
+                subroutine->loop = nullptr;
+                process();
+            }
+
+            //dependencies referencing this constant from now on get the materialized type
+            routine->result = module->constants[i] = module->constantPool.clone(routine->result);
+        }
+
+        //everything the evaluation allocated is owned by the constant pool now
+        module->constantPool.cloned.clear();
+        pool.clear();
+        poolRef.clear();
+        poolRefs.clear();
+        loops.reset();
+        sp = 0;
+        stepper = stepping;
+        module->constantsMaterialized = true;
+        resetLib();
+    }
+
+    /**
+     * Loads the lib once per process. Its constants are materialized right away, so this resets the pools.
+     */
+    void setLib(shared<Module> module) {
+        lib = nullptr;
+        if (!module) return;
+        parseHeader(module);
+        materializeConstants(module);
+        module->symbols = bytecode::symbols(module->bin);
+        lib = module;
+    }
+
     void prepare(shared<Module> &module) {
+        resetLib();
         parseHeader(module);
+        if (!module->constantsMaterialized) {
+            materializeConstants(module);
+        } else {
+            for (unsigned int i = 0; i<module->constants.size(); i++) {
+                if (module->constants[i]) module->subroutines[i].result = module->constants[i];
+            }
+        }
+
         subroutine = activeSubroutines.reset();
         subroutine->module = module.get();
         //first is main
@@ -296,7 +374,8 @@ namespace tr::vm2 {
      */
     void clear(shared<tr::vm2::Module> &module) {
         for (auto &&subroutine: module->subroutines) {
-            if (subroutine.result) drop(subroutine.result);
+            //constants are owned by the module's constant pool
+            if (subroutine.result && !(subroutine.flags & instructions::SubroutineFlag::Constant)) drop(subroutine.result);
             if (subroutine.narrowed) drop(subroutine.narrowed);
         }
         module->clear();
@@ -411,7 +490,9 @@ namespace tr::vm2 {
     }
 
     inline ActiveSubroutine *pushSubroutine(ModuleSubroutine *routine, unsigned int arguments) {
+#ifdef TYPERUNNER_VM_CHECKS
         if (!routine) throw std::runtime_error("no routine given");
+#endif
         auto nextSubroutine = activeSubroutines.push(); //&activeSubroutines[++activeSubroutineIdx];
         //important to reset necessary stuff, since we reuse
         nextSubroutine->ip = routine->address;
@@ -427,6 +508,7 @@ namespace tr::vm2 {
         for (unsigned int i = 0; i<arguments; i++) {
             use(stack[subroutine->initialSp + i]);
         }
+        return subroutine;
     }
 
     inline bool call(unsigned int address, unsigned int arguments) {
@@ -445,6 +527,36 @@ namespace tr::vm2 {
         return true;
     }
 
+    //Like call(), but the subroutine is looked up by name in the lib and executed in the lib module.
+    inline bool callLib(unsigned int nameAddress, unsigned int arguments) {
+        auto &bin = subroutine->module->bin;
+        if (lib) {
+            auto found = lib->symbols.find(vm::readUint64(bin, nameAddress));
+            if (found != lib->symbols.end()) {
+                auto routine = lib->getSubroutine(found->second);
+                if (routine->narrowed) {
+                    push(routine->narrowed);
+                    return false;
+                }
+                if (routine->result && arguments == 0) {
+                    push(routine->result);
+                    return false;
+                }
+
+                subroutine->ip++;
+                pushSubroutine(routine, arguments);
+                subroutine->module = lib.get();
+                return true;
+            }
+        }
+
+        //compiled against a different lib
+        for (unsigned int i = 0; i<arguments; i++) gc(pop());
+        report(fmt::format("Cannot find name '{}'", vm::readStorage(bin, nameAddress + 8)), subroutine->ip - 4 - 2);
+        push(allocate(TypeKind::Never, hash::const_hash("never")));
+        return false;
+    }
+
     inline bool isConditionTruthy(Type *type) {
         return type->flag & TypeFlag::True;
     }
@@ -789,6 +901,47 @@ namespace tr::vm2 {
         debug("[{}] {} refCount={} {} ref={}", subroutine->ip, title, type->refCount, stringify(type), (void *) type);
     }
 
+    /**
+     * Reads the parameters of OP::Loads and returns the referenced stack entry.
+     */
+    inline Type *load() {
+        const auto frameOffset = subroutine->parseUint16();
+        const auto varIndex = subroutine->parseUint16();
+        if (frameOffset == 0) {
+            return stack[subroutine->initialSp + varIndex];
+        }
+        return stack[activeSubroutines.at(activeSubroutines.index() - frameOffset)->initialSp + varIndex];
+    }
+
+    inline Type *stringLiteral(const string_view &bin, unsigned int address) {
+        auto item = allocate(TypeKind::Literal);
+        item->readStorage(bin, address);
+        item->flag |= TypeFlag::StringLiteral;
+        return item;
+    }
+
+    inline Type *propertySignature(Type *name, Type *propertyType) {
+        //PropertySignature has a linked list of name->type
+        auto type = allocate(TypeKind::PropertySignature);
+        type->type = useAsRef(name);
+        ((TypeRef *) type->type)->next = useAsRef(propertyType);
+        type->hash = name->hash;
+        return type;
+    }
+
+    /**
+     * Jumps to the false branch if the condition is not met.
+     * Expects ip to point at OP::JumpCondition.
+     */
+    inline bool jumpCondition(bool valid) {
+        const auto rightProgram = subroutine->parseUint32();
+        if (!valid) {
+            subroutine->ip += rightProgram - 4;
+            return true;
+        }
+        return false;
+    }
+
     Type *handleFunction(TypeKind kind) {
         const auto size = subroutine->parseUint16();
 
@@ -849,6 +1002,10 @@ namespace tr::vm2 {
                             report(DiagnosticMessage(fmt::format("Cannot find name '{}'", subroutine->module->findIdentifier(ip)), ip));
                             break;
                         }
+                        case instructions::ErrorCode::TooDeep: {
+                            report(DiagnosticMessage("Expression is nested too deeply to be checked", ip));
+                            break;
+                        }
                         default: {
                             report(DiagnosticMessage(fmt::format("{}", code), ip));
                         }
@@ -945,6 +1102,14 @@ namespace tr::vm2 {
                     stack[sp - 1]->flag |= TypeFlag::Static;
                     break;
                 }
+                case OP::Readonly: {
+                    stack[sp - 1]->flag |= TypeFlag::Readonly;
+                    break;
+                }
+                case OP::Noop:
+                case OP::Initializer: {
+                    break;
+                }
                 case OP::Optional: {
                     stack[sp - 1]->flag |= TypeFlag::Optional;
                     break;
@@ -1068,6 +1233,11 @@ namespace tr::vm2 {
                         subroutine->subroutine->result = use(stack[sp - 1]);
                         subroutine->subroutine->result->flag |= TypeFlag::Stored;
                     }
+                    if (activeSubroutines.index() == 0) {
+                        //root frame of a constant subroutine, see materializeConstants()
+                        subroutine = nullptr;
+                        return;
+                    }
                     subroutine = activeSubroutines.pop(); //&activeSubroutines[--activeSubroutineIdx];
                     goto start;
                 }
@@ -1145,7 +1315,10 @@ namespace tr::vm2 {
                     const auto address = subroutine->parseUint32();
                     //todo: this needs more definition: A type alias like `type a<T> = T`; needs to type check as well without throwing `Generic type 'a' requires 1 type argument(s).`
                     auto routine = subroutine->module->getSubroutine(address);
-                    if (routine->result) break;
+                    if (routine->result) {
+                        push(routine->result);
+                        break;
+                    }
 
                     if (call(address, 0)) {
                         goto start;
@@ -1159,6 +1332,14 @@ namespace tr::vm2 {
                         goto start;
                     }
                     break;
+                }
+                case OP::CallLib: {
+                    const auto nameAddress = subroutine->parseUint32();
+                    const auto arguments = subroutine->parseUint16();
+                    if (callLib(nameAddress, arguments)) {
+                        goto start;
+                    }
+                    break;
                 }
                     //case OP::FrameReturnJump: {
                     //    if (subroutine->size()>subroutine->variables) {
@@ -1183,14 +1364,27 @@ namespace tr::vm2 {
                 }
                 case OP::JumpCondition: {
                     auto condition = pop();
-                    const auto rightProgram = subroutine->parseUint32();
                     auto valid = isConditionTruthy(condition);
                     //debug("JumpCondition {}", valid);
                     gc(condition);
-                    if (!valid) {
-                        subroutine->ip += rightProgram - 4;
-                        goto start;
+                    if (jumpCondition(valid)) goto start;
+                    break;
+                }
+                case OP::LoadsExtendsJumpCondition:
+                case OP::ExtendsJumpCondition: {
+                    Type *right;
+                    if (op == OP::LoadsExtendsJumpCondition) {
+                        right = load();
+                        subroutine->ip++; //Extends
+                    } else {
+                        right = pop();
                     }
+                    auto left = pop();
+                    const auto valid = extends(left, right);
+                    gc(right);
+                    gc(left);
+                    subroutine->ip++; //JumpCondition
+                    if (jumpCondition(valid)) goto start;
                     break;
                 }
                 case OP::Extends: {
@@ -1210,6 +1404,11 @@ namespace tr::vm2 {
                     handleTemplateLiteral();
                     break;
                 }
+                case OP::LoadsDistribute: {
+                    push(load());
+                    subroutine->ip++; //Distribute
+                    [[fallthrough]];
+                }
                 case OP::Distribute: {
                     auto slot = subroutine->parseUint16();
                     //if there is OP::Distribute, then there was always before this OP
@@ -1258,13 +1457,7 @@ namespace tr::vm2 {
                     break;
                 }
                 case OP::Loads: {
-                    const auto frameOffset = subroutine->parseUint16();
-                    const auto varIndex = subroutine->parseUint16();
-                    if (frameOffset == 0) {
-                        push(stack[subroutine->initialSp + varIndex]);
-                    } else {
-                        push(stack[activeSubroutines.at(activeSubroutines.index() - frameOffset)->initialSp + varIndex]);
-                    }
+                    push(load());
                     break;
                 }
                 case OP::Slots: {
@@ -1388,14 +1581,18 @@ namespace tr::vm2 {
                     stack[sp++] = item;
                     break;
                 }
-                case OP::StringLiteral: {
+                case OP::BigIntLiteral: {
                     auto item = allocate(TypeKind::Literal);
                     const auto address = subroutine->parseUint32();
                     item->readStorage(bin, address);
-                    item->flag |= TypeFlag::StringLiteral;
+                    item->flag |= TypeFlag::BigIntLiteral;
                     stack[sp++] = item;
                     break;
                 }
+                case OP::StringLiteral: {
+                    stack[sp++] = stringLiteral(bin, subroutine->parseUint32());
+                    break;
+                }
                 case OP::False: {
                     auto item = allocate(TypeKind::Literal);
                     item->flag |= TypeFlag::False;
@@ -1435,12 +1632,25 @@ namespace tr::vm2 {
                 case OP::PropertySignature: {
                     auto name = pop();
                     auto propertyType = pop();
-                    //PropertySignature has a linked list of name->type
-                    auto type = allocate(TypeKind::PropertySignature);
-                    type->type = useAsRef(name);
-                    ((TypeRef *) type->type)->next = useAsRef(propertyType);
-                    type->hash = name->hash;
-                    push(type);
+                    push(propertySignature(name, propertyType));
+                    break;
+                }
+                case OP::StringLiteralPropertySignature: {
+                    auto name = stringLiteral(bin, subroutine->parseUint32());
+                    subroutine->ip++; //PropertySignature
+                    auto propertyType = pop();
+                    push(propertySignature(name, propertyType));
+                    break;
+                }
+                case OP::StringPropertySignature:
+                case OP::NumberPropertySignature: {
+                    auto propertyType = op == OP::StringPropertySignature
+                                        ? allocate(TypeKind::String, hash::const_hash("string"))
+                                        : allocate(TypeKind::Number, hash::const_hash("number"));
+                    subroutine->ip++; //StringLiteral
+                    auto name = stringLiteral(bin, subroutine->parseUint32());
+                    subroutine->ip++; //PropertySignature
+                    push(propertySignature(name, propertyType));
                     break;
                 }
                 case OP::Class: {
@@ -1710,7 +1920,12 @@ namespace tr::vm2 {
                     break;
                 }
                 default: {
-                    debug("[{}] OP {} not handled!", subroutine->ip, (OP) bin[subroutine->ip]);
+                    //checker::verify() only lets OPs through that are handled above
+#ifdef TYPERUNNER_VM_CHECKS
+                    throw std::runtime_error(fmt::format("[{}] OP {} not handled!", subroutine->ip, (OP) bin[subroutine->ip]));
+#else
+                    __builtin_unreachable();
+#endif
                 }
             }
 
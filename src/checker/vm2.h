@@ -177,6 +177,12 @@ namespace tr::vm2 {
 
     void process();
 
+    /**
+     * Global types (Array<T>, Exclude<T, U>, ...) called by OP::CallLib of all modules, see checker::loadLib().
+     */
+    inline shared<Module> lib;
+
+    void setLib(shared<Module> module);
     void clear(shared<tr::vm2::Module> &module);
     void prepare(shared<tr::vm2::Module> &module);
     void drop(Type *type);
@@ -11,15 +11,15 @@ namespace tr::Debug {
 }
 
 namespace tr {
-    string substr(const string &str, int start, optional<int> len) {
+    string substr(string_view str, int start, optional<int> len) {
         if (start <= 0 && len && len < 0) return "";
         if (!len || *len < 0 || len > str.size()) *len = str.size();
         if (start < 0) start += str.length();
-        return str.substr(start, *len);
+        return string(str.substr(start, *len));
     }
 
     //compatible with JavaScript's String.substring
-    string substring(const string &str, int start, optional<int> end) {
+    string substring(string_view str, int start, optional<int> end) {
         if (start < 0) start = 0;
         int len = str.size();
         if (end) {
@@ -32,7 +32,7 @@ namespace tr {
         }
         if (len < 0) len = 0;
         if (start > str.size()) start = str.size();
-        return str.substr(start, len);
+        return string(str.substr(start, len));
     }
 
     string replaceLeading(const string &text, const string &from, const string &to) {
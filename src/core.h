@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <set>
 #include <unordered_map>
@@ -22,6 +23,7 @@ namespace tr::Debug {
 
 namespace tr {
     using std::string;
+    using std::string_view;
     using std::vector;
     using std::function;
     using std::optional;
@@ -32,10 +34,10 @@ namespace tr {
     using std::cout;
 
     //compatible with JavaScript's String.substr
-    string substr(const string &str, int start, optional<int> len = {});
+    string substr(string_view str, int start, optional<int> len = {});
 
     //compatible with JavaScript's String.substring
-    string substring(const string &str, int start, optional<int> end = {});
+    string substring(string_view str, int start, optional<int> end = {});
 
     /**
      * shared_ptr has optional semantic already built-in, so we use it instead of std::optional<shared_ptr<>>,
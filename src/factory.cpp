@@ -6,31 +6,13 @@ namespace tr {
         return transformFlags | (node->transformFlags & (int) TransformFlags::PropertyNamePropagatingFlags);
     }
 
-    int Factory::propagateChildFlags(sharedOpt<Node> child) {
-        if (!child) return (int) TransformFlags::None;
+    int Factory::childTransformFlags(const shared<Node> &child) {
         auto childFlags = child->transformFlags & ~(int) getTransformFlagsSubtreeExclusions(child->kind);
 
         auto name = getName(child);
         return name ? propagatePropertyNameFlagsOfChild(name, childFlags) : childFlags;
     }
 
-    int Factory::propagateIdentifierNameFlags(shared<Node> node) {
-        // An IdentifierName is allowed to be `await`
-        return propagateChildFlags(std::move(node)) & ~(int) TransformFlags::ContainsPossibleTopLevelAwait;
-    }
-
-    int Factory::propagateChildrenFlags(const sharedOpt<NodeArray> &children) {
-        return children ? children->transformFlags : (int) TransformFlags::None;
-    }
-
-    void Factory::aggregateChildrenFlags(const shared<NodeArray> &children) {
-        int subtreeFlags = (int) TransformFlags::None;
-        for (auto &&child: children->list) {
-            subtreeFlags |= propagateChildFlags(child);
-        }
-        children->transformFlags = subtreeFlags;
-    }
-
     shared<NodeArray> Factory::createNodeArray(const sharedOpt<NodeArray> &elements, bool hasTrailingComma) {
         ZoneScoped;
         if (elements && elements->hasTrailingComma == hasTrailingComma) {
@@ -61,33 +43,33 @@ namespace tr {
     }
 
     // @api
-    shared<NumericLiteral> Factory::createNumericLiteral(string value, int numericLiteralFlags) {
-        auto node = createBaseLiteral<NumericLiteral>(SyntaxKind::NumericLiteral, std::move(value));
+    shared<NumericLiteral> Factory::createNumericLiteral(string_view value, int numericLiteralFlags) {
+        auto node = createBaseLiteral<NumericLiteral>(SyntaxKind::NumericLiteral, value);
         node->numericLiteralFlags = numericLiteralFlags;
         if (numericLiteralFlags & TokenFlags::BinaryOrOctalSpecifier) node->transformFlags |= (int) TransformFlags::ContainsES2015;
         return node;
     }
 
     shared<NumericLiteral> Factory::createNumericLiteral(double value, types::TokenFlags numericLiteralFlags) {
-        return createNumericLiteral(std::to_string(value), numericLiteralFlags);
+        return createNumericLiteral(store(std::to_string(value)), numericLiteralFlags);
     }
 
     // @api
     shared<BigIntLiteral> Factory::createBigIntLiteral(variant<string, PseudoBigInt> value) {
         string v = holds_alternative<string>(value) ? get<string>(value) : pseudoBigIntToString(get<PseudoBigInt>(value)) + "n";
-        auto node = createBaseLiteral<BigIntLiteral>(SyntaxKind::BigIntLiteral, v);
+        auto node = createBaseLiteral<BigIntLiteral>(SyntaxKind::BigIntLiteral, store(v));
         node->transformFlags |= (int) TransformFlags::ContainsESNext;
         return node;
     }
 
-    shared<StringLiteral> Factory::createBaseStringLiteral(string text, optional<bool> isSingleQuote) {
-        auto node = createBaseLiteral<StringLiteral>(SyntaxKind::StringLiteral, std::move(text));
+    shared<StringLiteral> Factory::createBaseStringLiteral(string_view text, optional<bool> isSingleQuote) {
+        auto node = createBaseLiteral<StringLiteral>(SyntaxKind::StringLiteral, text);
         node->singleQuote = isSingleQuote;
         return node;
     }
     // @api
-    shared<StringLiteral> Factory::createStringLiteral(string text, optional<bool> isSingleQuote, optional<bool> hasExtendedUnicodeEscape) {
-        auto node = createBaseStringLiteral(std::move(text), isSingleQuote);
+    shared<StringLiteral> Factory::createStringLiteral(string_view text, optional<bool> isSingleQuote, optional<bool> hasExtendedUnicodeEscape) {
+        auto node = createBaseStringLiteral(text, isSingleQuote);
         node->hasExtendedUnicodeEscape = hasExtendedUnicodeEscape;
         if (hasExtendedUnicodeEscape) node->transformFlags |= (int) TransformFlags::ContainsES2015;
         return node;
@@ -130,7 +112,7 @@ namespace tr {
     using NameType = variant<string, shared<Node>>;
 
     shared<Node> Factory::asName(NameType name) {
-        if (holds_alternative<string>(name)) return createIdentifier(get<string>(name));
+        if (holds_alternative<string>(name)) return createIdentifier(store(get<string>(name)));
         return get<shared<Node>>(name);
     }
 
@@ -143,7 +125,7 @@ namespace tr {
 
     sharedOpt<Expression> Factory::asExpression(ExpressionType value) {
         if (holds_alternative<sharedOpt<Expression>>(value)) return get<sharedOpt<Expression>>(value);
-        if (holds_alternative<string>(value)) return createStringLiteral(get<string>(value));
+        if (holds_alternative<string>(value)) return createStringLiteral(store(get<string>(value)));
         if (holds_alternative<int>(value)) return createNumericLiteral(get<int>(value));
         if (holds_alternative<bool>(value)) return createBooleanLiteral(get<bool>(value));
 
@@ -174,13 +156,13 @@ namespace tr {
 //        }
 //
     // @api
-    shared<RegularExpressionLiteral> Factory::createRegularExpressionLiteral(string text) {
+    shared<RegularExpressionLiteral> Factory::createRegularExpressionLiteral(string_view text) {
         auto node = createBaseLiteral<RegularExpressionLiteral>(SyntaxKind::RegularExpressionLiteral, text);
         return node;
     }
 
     // @api
-    shared<JsxText> Factory::createJsxText(string text, optional<bool> containsOnlyTriviaWhiteSpaces) {
+    shared<JsxText> Factory::createJsxText(string_view text, optional<bool> containsOnlyTriviaWhiteSpaces) {
         auto node = createBaseNode<JsxText>(SyntaxKind::JsxText);
         node->text = text;
         node->containsOnlyTriviaWhiteSpaces = containsOnlyTriviaWhiteSpaces ? *containsOnlyTriviaWhiteSpaces : false;
@@ -189,9 +171,9 @@ namespace tr {
     }
 
     // @api
-    shared<TemplateLiteralLike> Factory::createTemplateLiteralLikeNode(SyntaxKind kind, string text, optional<string> rawText, optional<int> templateFlags) {
+    shared<TemplateLiteralLike> Factory::createTemplateLiteralLikeNode(SyntaxKind kind, string_view text, optional<string> rawText, optional<int> templateFlags) {
         auto node = createBaseToken<TemplateLiteralLike>(kind);
-        node->text = std::move(text);
+        node->text = text;
         node->rawText = std::move(rawText);
         node->templateFlags = (templateFlags ? *templateFlags : 0) & (int) TokenFlags::TemplateLiteralLikeFlags;
         node->transformFlags |= (int) TransformFlags::ContainsES2015;
@@ -202,10 +184,10 @@ namespace tr {
     }
 
     // @api
-    shared<LiteralLike> Factory::createLiteralLikeNode(SyntaxKind kind, string text) {
+    shared<LiteralLike> Factory::createLiteralLikeNode(SyntaxKind kind, string_view text) {
         switch (kind) {
             case SyntaxKind::NumericLiteral:return createNumericLiteral(text, /*numericLiteralFlags*/ 0);
-            case SyntaxKind::BigIntLiteral:return createBigIntLiteral(text);
+            case SyntaxKind::BigIntLiteral:return createBigIntLiteral(string(text));
             case SyntaxKind::StringLiteral:return createStringLiteral(text, /*isSingleQuote*/ {});
             case SyntaxKind::JsxText:return createJsxText(text, /*containsOnlyTriviaWhiteSpaces*/ false);
             case SyntaxKind::JsxTextAllWhiteSpaces:return createJsxText(text, /*containsOnlyTriviaWhiteSpaces*/ true);
@@ -218,21 +200,22 @@ namespace tr {
 //        // Identifiers
 //        //
 
-    shared<Identifier> Factory::createBaseIdentifier(string text, optional<SyntaxKind> originalKeywordKind) {
+    shared<Identifier> Factory::createBaseIdentifier(string_view text, optional<SyntaxKind> originalKeywordKind) {
         if (!originalKeywordKind && !text.empty()) {
-            originalKeywordKind = stringToToken(text);
+            originalKeywordKind = stringToToken(string(text));
         }
         if (originalKeywordKind == SyntaxKind::Identifier) {
             originalKeywordKind.reset();
         }
         auto node = createBaseNode<Identifier>();
         node->originalKeywordKind = originalKeywordKind;
-        node->escapedText = escapeLeadingUnderscores(text);
+        //only __ prefixed names change, see escapeLeadingUnderscores()
+        node->escapedText = text.starts_with("__") ? store(escapeLeadingUnderscores(string(text))) : text;
         return node;
     }
 
     shared<Identifier> Factory::createBaseGeneratedIdentifier(string text, GeneratedIdentifierFlags autoGenerateFlags) {
-        auto node = createBaseIdentifier(text, /*originalKeywordKind*/ {});
+        auto node = createBaseIdentifier(store(text), /*originalKeywordKind*/ {});
         node->autoGenerateFlags = (int) autoGenerateFlags;
         node->autoGenerateId = nextAutoGenerateId;
         nextAutoGenerateId++;
@@ -240,9 +223,9 @@ namespace tr {
     }
 
     // @api
-    shared<Identifier> Factory::createIdentifier(string text, sharedOpt<NodeArray> typeArguments, optional<SyntaxKind> originalKeywordKind) {
+    shared<Identifier> Factory::createIdentifier(string_view text, sharedOpt<NodeArray> typeArguments, optional<SyntaxKind> originalKeywordKind) {
         ZoneScoped;
-        auto node = createBaseIdentifier(std::move(text), originalKeywordKind);
+        auto node = createBaseIdentifier(text, originalKeywordKind);
         if (typeArguments) {
             // NOTE: we do not use `setChildren` here because typeArguments in an identifier do not contribute to transformations
             node->typeArguments = createNodeArray(typeArguments);
@@ -297,10 +280,11 @@ namespace tr {
 //        }
 //
     // @api
-    shared<PrivateIdentifier> Factory::createPrivateIdentifier(string text) {
-        if (!startsWith(text, "#")) throw runtime_error("First character of private identifier must be #: " + text);
+    shared<PrivateIdentifier> Factory::createPrivateIdentifier(string_view text) {
+        if (!text.starts_with("#")) throw runtime_error("First character of private identifier must be #: " + string(text));
         auto node = createBaseNode<PrivateIdentifier>(SyntaxKind::PrivateIdentifier);
-        node->escapedText = escapeLeadingUnderscores(text);
+        //starts with #, so escapeLeadingUnderscores() would not change it
+        node->escapedText = text;
         node->transformFlags |= (int) TransformFlags::ContainsClassFields;
         return node;
     }
@@ -1588,7 +1572,7 @@ namespace tr {
                 name,
                 initializer ? parenthesizer.parenthesizeExpressionForDisallowedComma(initializer) : nullptr
         );
-        node->propertyName = asName(*propertyName);
+        node->propertyName = asName(propertyName);
         node->dotDotDotToken = dotDotDotToken;
         node->transformFlags |= propagateChildFlags(node->dotDotDotToken) | (int) TransformFlags::ContainsES2015;
         if (node->propertyName) {
@@ -2544,7 +2528,7 @@ namespace tr {
         auto node = createBaseNode<VariableDeclarationList>(SyntaxKind::VariableDeclarationList);
         node->flags |= flags & (int) NodeFlags::BlockScoped;
         node->declarations = declarations;
-        for (auto &&d: declarations->list) d->setParent(node);
+        for (auto &&d: declarations->list) d->setParent(node.get());
         node->transformFlags |=
                 propagateChildrenFlags(node->declarations) |
                 (int) TransformFlags::ContainsHoistedDeclarationOrCompletion;
@@ -4730,7 +4714,7 @@ namespace tr {
     shared<PartiallyEmittedExpression> Factory::createPartiallyEmittedExpression(shared<Expression> expression, sharedOpt<Node> original) {
         auto node = createBaseNode<PartiallyEmittedExpression>(SyntaxKind::PartiallyEmittedExpression);
         node->expression = expression;
-        node->original = original;
+        node->setOriginal(original);
         node->transformFlags |=
                 propagateChildFlags(node->expression) |
                 (int) TransformFlags::ContainsTypeScript;
@@ -4741,7 +4725,7 @@ namespace tr {
     // @api
     auto Factory::updatePartiallyEmittedExpression(shared<PartiallyEmittedExpression> node, shared<Expression> expression) {
         return node->expression != expression
-               ? update(createPartiallyEmittedExpression(expression, node->original), node)
+               ? update(createPartiallyEmittedExpression(expression, node->getOriginal()), node)
                : node;
     }
 
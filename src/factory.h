@@ -3,6 +3,7 @@
 #include <utility>
 
 #include "Tracy.hpp"
+#include "arena.h"
 #include "types.h"
 #include "utilities.h"
 #include "scanner.h"
@@ -29,21 +30,64 @@ namespace tr {
             NoOriginalNode = 1 << 3,
         };
 
+#ifdef TYPERUNNER_EMIT
         Parenthesizer parenthesizer;
+#else
+        NullParenthesizer parenthesizer;
+#endif
+
+        //nodes are allocated here when set, see Parser::initializeState()
+        std::shared_ptr<Arena> arena;
+
+        //texts of nodes created outside of a parse, see store()
+        Arena texts;
 
         Factory () {
             parenthesizer.factory = this;
         }
 
+        //TransformFlags are only needed to emit JavaScript. Unless TYPERUNNER_EMIT is defined, only
+        //ContainsPossibleTopLevelAwait is propagated to the parents, which the parser needs to find top-level `await`
+        //(see Parser::reparseTopLevelAwait()). Other flags stay on the node of their own kind.
+#ifdef TYPERUNNER_EMIT
+        static constexpr bool propagateTransformFlags = true;
+#else
+        static constexpr bool propagateTransformFlags = false;
+#endif
+
         int propagatePropertyNameFlagsOfChild(shared<NodeUnion(PropertyName)> &node, int transformFlags);
 
-        int propagateChildFlags(sharedOpt<Node> child);
+        int childTransformFlags(const shared<Node> &child);
+
+        template<typename T>
+        int propagateChildFlags(const sharedOpt<T> &child) {
+            if (!child) return (int) TransformFlags::None;
+            if constexpr (propagateTransformFlags) {
+                return childTransformFlags(child);
+            } else {
+                //most children have no `await`, so they cost one test
+                if (!(child->transformFlags & (int) TransformFlags::ContainsPossibleTopLevelAwait)) return (int) TransformFlags::None;
+                return childTransformFlags(child) & (int) TransformFlags::ContainsPossibleTopLevelAwait;
+            }
+        }
 
-        int propagateIdentifierNameFlags(shared<Node> node);
+        template<typename T>
+        int propagateIdentifierNameFlags(const sharedOpt<T> &node) {
+            // An IdentifierName is allowed to be `await`
+            return propagateChildFlags(node) & ~(int) TransformFlags::ContainsPossibleTopLevelAwait;
+        }
 
-        int propagateChildrenFlags(const sharedOpt<NodeArray> &children);
+        int propagateChildrenFlags(const sharedOpt<NodeArray> &children) {
+            return children ? children->transformFlags : (int) TransformFlags::None;
+        }
 
-        void aggregateChildrenFlags(const shared<NodeArray> &children);
+        void aggregateChildrenFlags(const shared<NodeArray> &children) {
+            int subtreeFlags = (int) TransformFlags::None;
+            for (auto &&child: children->list) {
+                subtreeFlags |= propagateChildFlags(child);
+            }
+            children->transformFlags = subtreeFlags;
+        }
 
         shared<NodeArray> createNodeArray(const sharedOpt<NodeArray> &elements, bool hasTrailingComma = false);
 
@@ -72,16 +116,35 @@ namespace tr {
             return createNodeArray(asNodeArray(elements), hasTrailingComma);
         }
 
+        /**
+         * Node texts (Identifier::escapedText, LiteralLike::text) are views that are not copied by the factory.
+         * Text that is not a slice of the source (escaped, computed) has to be stored here first.
+         * It lives in the arena of the current parse, or as long as the factory when there is none.
+         */
+        string_view store(string_view text) {
+            return arena ? arena->store(text) : texts.store(text);
+        }
+
+        /**
+         * Allocates in the arena of the current parse, or on the heap when there is none.
+         * Arena nodes must not outlive the SourceFile of the parse, since that owns the arena (see createSourceFile()).
+         */
+        template<class T, class ...Args>
+        shared<T> make(Args &&...args) {
+            if (!arena) return make_shared<T>(std::forward<Args>(args)...);
+            return std::allocate_shared<T>(ArenaAllocator<T>(arena.get()), std::forward<Args>(args)...);
+        }
+
         template<class T>
         shared<T> createBaseNode() {
-            auto node = make_shared<T>();
+            auto node = make<T>();
             node->kind = (types::SyntaxKind) T::KIND;
             return node;
         }
 
         template<class T>
         shared<T> createBaseNode(SyntaxKind kind) {
-            auto node = make_shared<T>();
+            auto node = make<T>();
             node->kind = kind;
             return node;
         }
@@ -95,24 +158,24 @@ namespace tr {
         // Literals
         //
         template<typename T>
-        shared<T> createBaseLiteral(SyntaxKind kind, string text) {
+        shared<T> createBaseLiteral(SyntaxKind kind, string_view text) {
             auto node = createBaseToken<T>(kind);
             node->text = text;
             return node;
         }
 
         // @api
-        shared<NumericLiteral> createNumericLiteral(string value, int numericLiteralFlags = (int) types::TokenFlags::None);
+        shared<NumericLiteral> createNumericLiteral(string_view value, int numericLiteralFlags = (int) types::TokenFlags::None);
 
         shared<NumericLiteral> createNumericLiteral(double value, types::TokenFlags numericLiteralFlags = types::TokenFlags::None);
 
         // @api
         shared<BigIntLiteral> createBigIntLiteral(variant<string, PseudoBigInt> value);
 
-        shared<StringLiteral> createBaseStringLiteral(string text, optional<bool> isSingleQuote = {});
+        shared<StringLiteral> createBaseStringLiteral(string_view text, optional<bool> isSingleQuote = {});
 
         // @api
-        shared<StringLiteral> createStringLiteral(string text, optional<bool> isSingleQuote = {}, optional<bool> hasExtendedUnicodeEscape = {});
+        shared<StringLiteral> createStringLiteral(string_view text, optional<bool> isSingleQuote = {}, optional<bool> hasExtendedUnicodeEscape = {});
 
 //        // @api
 //        function createToken(token: SyntaxKind::SuperKeyword): SuperExpression;
@@ -223,10 +286,10 @@ namespace tr {
                 sharedOpt<NodeArray> modifiers
         ) {
             auto node = createBaseNode<T>(kind);
-            node->decorators = asNodeArray(decorators);
+            node->setDecorators(asNodeArray(decorators));
             node->modifiers = asNodeArray(modifiers);
             node->transformFlags |=
-                    propagateChildrenFlags(node->decorators) |
+                    propagateChildrenFlags(node->getDecorators()) |
                     propagateChildrenFlags(node->modifiers);
             // NOTE: The following properties are commonly set by the binder and are added here to
             // ensure declarations have a stable shape.
@@ -472,27 +535,27 @@ namespace tr {
 //        }
 //
         // @api
-        shared<RegularExpressionLiteral> createRegularExpressionLiteral(string text);
+        shared<RegularExpressionLiteral> createRegularExpressionLiteral(string_view text);
 
         // @api
-        shared<JsxText> createJsxText(string text, optional<bool> containsOnlyTriviaWhiteSpaces = {});
+        shared<JsxText> createJsxText(string_view text, optional<bool> containsOnlyTriviaWhiteSpaces = {});
 
         // @api
-        shared<TemplateLiteralLike> createTemplateLiteralLikeNode(SyntaxKind kind, string text, optional<string> rawText = {}, optional<int> templateFlags = {});
+        shared<TemplateLiteralLike> createTemplateLiteralLikeNode(SyntaxKind kind, string_view text, optional<string> rawText = {}, optional<int> templateFlags = {});
 
         // @api
-        shared<LiteralLike> createLiteralLikeNode(SyntaxKind kind, string text);
+        shared<LiteralLike> createLiteralLikeNode(SyntaxKind kind, string_view text);
 
 //        //
 //        // Identifiers
 //        //
 
-        shared<Identifier> createBaseIdentifier(string text, optional<SyntaxKind> originalKeywordKind);
+        shared<Identifier> createBaseIdentifier(string_view text, optional<SyntaxKind> originalKeywordKind);
 
         shared<Identifier> createBaseGeneratedIdentifier(string text, GeneratedIdentifierFlags autoGenerateFlags);
 
         // @api
-        shared<Identifier> createIdentifier(string text, sharedOpt<NodeArray> typeArguments = {}, optional<SyntaxKind> originalKeywordKind = {});
+        shared<Identifier> createIdentifier(string_view text, sharedOpt<NodeArray> typeArguments = {}, optional<SyntaxKind> originalKeywordKind = {});
 //
 //        // @api
 //        function updateIdentifier(node: Identifier, typeArguments?: NodeArray<TypeNode | TypeParameterDeclaration> | undefined): Identifier {
@@ -538,7 +601,7 @@ namespace tr {
 //        }
 //
         // @api
-        shared<PrivateIdentifier> createPrivateIdentifier(string text);
+        shared<PrivateIdentifier> createPrivateIdentifier(string_view text);
 
 //        //
 //        // Punctuation
@@ -1884,10 +1947,10 @@ namespace tr {
 
         template<class T>
         T setOriginalNode(T node, sharedOpt<Node> original) {
-            node->original = original;
+            node->setOriginal(original);
             if (original) {
-                auto emitNode = original->emitNode;
-                if (emitNode) node->emitNode = mergeEmitNode(emitNode, node->emitNode);
+                auto emitNode = original->getEmitNode();
+                if (emitNode) node->setEmitNode(mergeEmitNode(emitNode, node->getEmitNode()));
             }
             return node;
         }
@@ -3579,7 +3642,8 @@ namespace tr {
             shared<EndOfFileToken> endOfFileToken,
             int flags
         ) {
-            auto node = make_shared<SourceFile>();
+            //the SourceFile itself is on the heap and frees the arena after it and with it the whole tree was destroyed
+            auto node = arena ? std::allocate_shared<SourceFile>(ArenaOwner<SourceFile>(arena)) : make_shared<SourceFile>();
             node->statements = createNodeArray(statements);
             node->endOfFileToken = endOfFileToken;
             node->flags |= (int)flags;
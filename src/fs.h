@@ -3,6 +3,12 @@
 #include <string>
 #include <fstream>
 #include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using std::string;
 using std::string_view;
@@ -24,7 +30,50 @@ inline void fileWrite(const string &file, const string_view &content) {
     t << content;
 }
 
+//one access() call instead of opening (and closing) the file
 inline bool fileExists(const string &file) {
-    std::ifstream infile(file);
-    return infile.good();
-}
\ No newline at end of file
+    return access(file.c_str(), R_OK) == 0;
+}
+
+/**
+ * Read-only memory mapping of a whole file. The mapping lives as long as this object.
+ */
+class MappedFile {
+    const char *address = nullptr;
+    size_t length = 0;
+public:
+    explicit MappedFile(const string &file) {
+        auto fd = open(file.c_str(), O_RDONLY);
+        if (fd<0) throw std::runtime_error("Could not open " + file);
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("Could not stat " + file);
+        }
+        length = info.st_size;
+        if (length) {
+            auto mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Could not map " + file);
+            }
+            address = (const char *) mapped;
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (address) munmap((void *) address, length);
+    }
+
+    string_view view() const {
+        return {address, length};
+    }
+};
+
+inline std::shared_ptr<MappedFile> fileMap(const string &file) {
+    return std::make_shared<MappedFile>(file);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "core.h"
+#include "parser2.h"
+
+namespace tr {
+    struct LoadedFile {
+        string path;
+        sharedOpt<SourceFile> sourceFile; //empty when the file could not be loaded, see error
+        string error;
+    };
+
+    /**
+     * Loads and parses many files at once, e.g. all files of a project, on a pool of worker threads.
+     *
+     * Workers claim the files in batches of `batchSize` and parse them from a memory mapping (Parser::parseFile()),
+     * so the open/fstat/mmap calls and page faults of one file overlap with the parsing of others. Each parsed file is
+     * handed to `onFile` on the calling thread as soon as it is done (in completion order, not in the order of
+     * `paths`), so compiling and checking it runs while the other files are still loading. Compiler and VM are not
+     * thread-safe, they stay on the calling thread. At most `threads * batchSize` parsed files wait for `onFile`,
+     * workers pause when checking is slower than parsing, so not all ASTs of a big project are in memory at once.
+     *
+     *     FileLoader loader;
+     *     loader.load(paths, [&](LoadedFile &file) { ... compiler.compileSourceFile(file.sourceFile) ... });
+     */
+    class FileLoader {
+        unsigned int threads;
+        unsigned int batchSize;
+
+    public:
+        //threads = 0 uses one per core
+        explicit FileLoader(unsigned int threads = 0, unsigned int batchSize = 16): threads(threads), batchSize(std::max(batchSize, 1u)) {
+            if (!this->threads) this->threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        void load(const vector<string> &paths, const function<void(LoadedFile &file)> &onFile) const {
+            if (paths.empty()) return;
+
+            std::atomic<size_t> next = 0;
+            std::mutex mutex;
+            std::condition_variable ready; //done is not empty
+            std::condition_variable room; //done is not full, or stopped
+            std::deque<LoadedFile> done;
+            auto capacity = (size_t) threads * batchSize;
+            bool stopped = false;
+
+            auto work = [&] {
+                Parser parser;
+                while (true) {
+                    auto start = next.fetch_add(batchSize);
+                    if (start >= paths.size()) break;
+                    auto end = std::min<size_t>(start + batchSize, paths.size());
+                    for (auto i = start; i<end; i++) {
+                        LoadedFile file{paths[i]};
+                        try {
+                            file.sourceFile = parser.parseFile(paths[i]);
+                        } catch (std::exception &e) {
+                            file.error = e.what();
+                        }
+                        {
+                            std::unique_lock lock(mutex);
+                            room.wait(lock, [&] { return done.size()<capacity || stopped; });
+                            if (stopped) return;
+                            done.push_back(std::move(file));
+                        }
+                        ready.notify_one();
+                    }
+                }
+            };
+
+            vector<std::thread> workers;
+            auto count = std::min<size_t>(threads, (paths.size() + batchSize - 1) / batchSize);
+            for (size_t i = 0; i<count; i++) workers.emplace_back(work);
+
+            try {
+                for (size_t handled = 0; handled<paths.size(); handled++) {
+                    std::unique_lock lock(mutex);
+                    ready.wait(lock, [&] { return !done.empty(); });
+                    auto file = std::move(done.front());
+                    done.pop_front();
+                    lock.unlock();
+                    room.notify_one();
+                    onFile(file);
+                }
+            } catch (...) {
+                //workers reference this frame, so they have to end before the exception leaves it
+                next = paths.size();
+                {
+                    std::lock_guard lock(mutex);
+                    stopped = true;
+                }
+                room.notify_all();
+                for (auto &&worker: workers) worker.join();
+                throw;
+            }
+            for (auto &&worker: workers) worker.join();
+        }
+    };
+}
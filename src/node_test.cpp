@@ -6,7 +6,8 @@ namespace tr {
      * Gets flags that control emit behavior of a node.
      */
     int getEmitFlags(const shared<Node> &node) {
-        return node->emitNode ? node->emitNode->flags : 0;
+        auto emitNode = node->getEmitNode();
+        return emitNode ? emitNode->flags : 0;
     }
 
     bool isCommaSequence(shared<Node> node) {
@@ -120,8 +121,15 @@ namespace tr {
         return hasSyntacticModifier(node, (int) ModifierFlags::Static);
     }
 
-    shared<NodeUnion(PropertyName)> resolveNameToNode(const shared<Node> &node) {
+    sharedOpt<NodeUnion(PropertyName)> resolveNameToNode(const sharedOpt<Node> &node) {
+        //optional names, e.g. of class expressions
+        if (!node) return nullptr;
+
         switch (node->kind) {
+            //binding names of parameters, not a PropertyName
+            case SyntaxKind::ObjectBindingPattern:
+            case SyntaxKind::ArrayBindingPattern:
+                return nullptr;
             case SyntaxKind::Identifier:
             case SyntaxKind::StringLiteral:
             case SyntaxKind::NumericLiteral:
@@ -186,7 +194,7 @@ namespace tr {
         }
     }
 
-    string &getEscapedName(const shared<Node> &node) {
+    string_view getEscapedName(const shared<Node> &node) {
         switch (node->kind) {
             case SyntaxKind::Identifier:
                 return reinterpret_pointer_cast<Identifier>(node)->escapedText;
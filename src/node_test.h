@@ -46,7 +46,7 @@ namespace tr {
 
     bool hasStaticModifier(shared<Node> node);
 
-    shared<NodeUnion(PropertyName)> resolveNameToNode(const shared<Node> &node);
+    sharedOpt<NodeUnion(PropertyName)> resolveNameToNode(const sharedOpt<Node> &node);
 
     bool isFunctionOrConstructorTypeNode(shared<Node> node);
 
@@ -54,7 +54,7 @@ namespace tr {
 
     shared<NodeUnion(JsxTagNameExpression)> getTagName(shared<NodeUnion(JsxOpeningElement, JsxOpeningFragment)> node);
 
-    string &getEscapedName(const shared<Node> &node);
+    string_view getEscapedName(const shared<Node> &node);
 
     sharedOpt<NodeUnion(PropertyName)> getName(const shared<Node> &node);
 
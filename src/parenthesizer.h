@@ -412,4 +412,37 @@ namespace tr {
 
         sharedOpt<NodeArray> parenthesizeTypeArguments(sharedOpt<NodeArray> typeArguments);
     };
+
+    /**
+     * nullParenthesizerRules of TypeScript, which its parser uses: every node is taken as is. The parser already produces
+     * correctly nested trees, parentheses are only needed for trees built by transformers for the emitter.
+     * The Factory uses it unless TYPERUNNER_EMIT is defined.
+     */
+    struct NullParenthesizer {
+        Factory *factory;
+
+        shared<Expression> parenthesizeLeftSideOfBinary(SyntaxKind, const shared<Expression> &leftSide) { return leftSide; }
+        shared<Expression> parenthesizeRightSideOfBinary(SyntaxKind, const sharedOpt<Expression> &, const shared<Expression> &rightSide) { return rightSide; }
+        shared<Expression> parenthesizeExpressionOfComputedPropertyName(const shared<Expression> &expression) { return expression; }
+        shared<Expression> parenthesizeConditionOfConditionalExpression(const shared<Expression> &condition) { return condition; }
+        shared<Expression> parenthesizeBranchOfConditionalExpression(const shared<Expression> &branch) { return branch; }
+        shared<LeftHandSideExpression> parenthesizeLeftSideOfAccess(const shared<Expression> &expression) { return reinterpret_pointer_cast<LeftHandSideExpression>(expression); }
+        shared<LeftHandSideExpression> parenthesizeExpressionOfNew(const shared<Expression> &expression) { return reinterpret_pointer_cast<LeftHandSideExpression>(expression); }
+        shared<LeftHandSideExpression> parenthesizeOperandOfPostfixUnary(const shared<Expression> &operand) { return reinterpret_pointer_cast<LeftHandSideExpression>(operand); }
+        shared<UnaryExpression> parenthesizeOperandOfPrefixUnary(const shared<Expression> &operand) { return reinterpret_pointer_cast<UnaryExpression>(operand); }
+        shared<Expression> parenthesizeExpressionForDisallowedComma(const shared<Expression> &expression, int = 0) { return expression; }
+        shared<NodeArray> parenthesizeExpressionsOfCommaDelimitedList(const shared<NodeArray> &elements) { return elements; }
+        shared<Expression> parenthesizeExpressionOfExpressionStatement(const shared<Expression> &expression) { return expression; }
+        shared<Node> parenthesizeConciseBodyOfArrowFunction(const shared<Node> &body) { return body; }
+        shared<TypeNode> parenthesizeCheckTypeOfConditionalType(const shared<TypeNode> &checkType) { return checkType; }
+        shared<TypeNode> parenthesizeExtendsTypeOfConditionalType(const shared<TypeNode> &extendsType) { return extendsType; }
+        shared<NodeArray> parenthesizeConstituentTypesOfUnionType(const shared<NodeArray> &members) { return members; }
+        shared<NodeArray> parenthesizeConstituentTypesOfIntersectionType(const shared<NodeArray> &members) { return members; }
+        shared<TypeNode> parenthesizeOperandOfTypeOperator(const shared<TypeNode> &type) { return type; }
+        shared<TypeNode> parenthesizeOperandOfReadonlyTypeOperator(const shared<TypeNode> &type) { return type; }
+        shared<TypeNode> parenthesizeNonArrayTypeOfPostfixType(const shared<TypeNode> &type) { return type; }
+        shared<NodeArray> parenthesizeElementTypesOfTupleType(const shared<NodeArray> &types) { return types; }
+        shared<TypeNode> parenthesizeTypeOfOptionalType(const shared<TypeNode> &type) { return type; }
+        sharedOpt<NodeArray> parenthesizeTypeArguments(const sharedOpt<NodeArray> &typeArguments) { return typeArguments; }
+    };
 }
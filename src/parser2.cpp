@@ -1,7 +1,37 @@
 
 #include "parser2.h"
+#include "visitor.h"
 
 namespace tr {
+    /**
+     * Nodes own their children, so destroying a deep tree (e.g. `a + b + ...` with many thousand terms, which
+     * the parser builds in a loop) would recurse once per level and overflow the stack. Shallow trees, which
+     * are almost all, are released as usual. In deeper ones every releaseDepth levels a node is held back, so
+     * a release destroys at most releaseDepth levels, and the held nodes are released afterwards in pre-order,
+     * parents first.
+     */
+    void SourceFile::releaseStatements() {
+        if (!statements) return;
+        constexpr unsigned int releaseDepth = 256;
+        if (nestingDepth<releaseDepth) {
+            statements.reset();
+            return;
+        }
+        vector<shared<Node>> held;
+        for (auto &&statement: statements->list) {
+            walk(statement, [&held](const shared<Node> &node, unsigned int depth) {
+                if (depth && depth % releaseDepth == 0) held.push_back(node);
+                return VisitResult::Continue;
+            });
+        }
+        statements.reset();
+        for (auto &&node: held) node.reset();
+    }
+
+    SourceFile::~SourceFile() {
+        releaseStatements();
+    }
+
     SyntaxKind Parser::token() {
         return currentToken;
     }
@@ -13,19 +43,19 @@ namespace tr {
     optional<DiagnosticWithDetachedLocation> Parser::parseErrorAtPosition(int start, int length, const shared<DiagnosticMessage> &message, DiagnosticArg arg) {
         ZoneScoped;
 
+        optional<DiagnosticWithDetachedLocation> result;
         auto lastError = lastOrUndefined(parseDiagnostics);
         // Don't report another error if it would just be at the same position as the last error.
         if (!lastError || start != lastError->start) {
-            auto d = createDetachedDiagnostic(fileName, start, length, message, {arg});
-            parseDiagnostics.push_back(d);
-            return d;
+            result = createDetachedDiagnostic(fileName, start, length, message, {arg});
+            parseDiagnostics.push_back(*result);
         }
 
         // Mark that we've encountered an error.  We'll set an appropriate bit on the next
         // node we finish so that it can't be reused incrementally.
         parseErrorBeforeNextFinishedNode = true;
 
-        return nullopt;
+        return result;
     }
 
     shared<Node> Parser::countNode(const shared<Node> &node) {
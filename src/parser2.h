@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
 #include <variant>
 #include <optional>
@@ -15,7 +16,9 @@
 #include "factory.h"
 #include "hash.h"
 #include "utilities.h"
+#include "syntax_cursor.h"
 #include "diagnostic_messages.h"
+#include "fs.h"
 #include <fmt/core.h>
 
 using namespace tr::types;
@@ -100,7 +103,8 @@ namespace tr {
 ////    /* @internal */
 ////    export const parseNodeFactory = createNodeFactory(NodeFactoryFlags.NoParenthesizerRules, parseBaseNodeFactory);
 
-    inline sharedOpt<Node> visitNode(const function<sharedOpt<Node>(shared<Node>)> &cbNode, const sharedOpt<Node> &node) {
+    template<typename CbNode>
+    inline sharedOpt<Node> visitNode(const CbNode &cbNode, const sharedOpt<Node> &node) {
         if (node) cbNode(node);
         return nullptr;
     }
@@ -113,15 +117,18 @@ namespace tr {
         return nullptr;
     };
 
-    inline sharedOpt<Node> forEachChild(const shared<Node> &node, const function<sharedOpt<Node>(shared<Node>)> &cbNode, const function<sharedOpt<Node>(shared<NodeArray>)> &cbNodes = noop);
+    /**
+     * The callbacks are template parameters instead of std::function so that the visitors (and the parser's
+     * element parsers, see Parser::parseList()) can be inlined.
+     */
+    template<typename CbNode, typename CbNodes = decltype(&noop)>
+    inline sharedOpt<Node> forEachChild(const shared<Node> &node, const CbNode &cbNode, const CbNodes &cbNodes = noop);
 
-    inline sharedOpt<Node> visitNodes(
-            const function<sharedOpt<Node>(shared<Node>)> &cbNode,
-            const function<sharedOpt<Node>(shared<NodeArray>)> &cbNodes = noop,
-            const sharedOpt<NodeArray> &nodes = nullptr
-    ) {
+    //cbNodes = nullptr visits each node of the array with cbNode
+    template<typename CbNode, typename CbNodes>
+    inline sharedOpt<Node> visitNodes(const CbNode &cbNode, const CbNodes &cbNodes, const sharedOpt<NodeArray> &nodes) {
         if (nodes) {
-            if (cbNodes) {
+            if constexpr (!std::is_same_v<CbNodes, std::nullptr_t>) {
                 return cbNodes(nodes);
             }
             for (auto &&node: nodes->list) {
@@ -242,7 +249,8 @@ namespace tr {
      * @remarks `forEachChild` must visit the children of a node in the order
      * that they appear in the source code. The language service depends on this property to locate nodes by position.
      */
-    inline sharedOpt<Node> forEachChild(const shared<Node> &node, const function<sharedOpt<Node>(shared<Node>)> &cbNode, const function<sharedOpt<Node>(shared<NodeArray>)> &cbNodes) {
+    template<typename CbNode, typename CbNodes>
+    inline sharedOpt<Node> forEachChild(const shared<Node> &node, const CbNode &cbNode, const CbNodes &cbNodes) {
         if (node->kind <= SyntaxKind::LastToken) {
             return nullptr;
         }
@@ -258,7 +266,7 @@ namespace tr {
                        visitNode(cbNode, to<TypeParameterDeclaration>(node)->defaultType) ||
                        visitNode(cbNode, to<TypeParameterDeclaration>(node)->expression);
             case SyntaxKind::ShorthandPropertyAssignment:
-                return visitNodes(cbNode, cbNodes, to<ShorthandPropertyAssignment>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ShorthandPropertyAssignment>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ShorthandPropertyAssignment>(node)->modifiers) ||
                        visitNode(cbNode, to<ShorthandPropertyAssignment>(node)->name) ||
                        visitNode(cbNode, to<ShorthandPropertyAssignment>(node)->questionToken) ||
@@ -268,7 +276,7 @@ namespace tr {
             case SyntaxKind::SpreadAssignment:
                 return visitNode(cbNode, to<SpreadAssignment>(node)->expression);
             case SyntaxKind::Parameter:
-                return visitNodes(cbNode, cbNodes, to<ParameterDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ParameterDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ParameterDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ParameterDeclaration>(node)->dotDotDotToken) ||
                        visitNode(cbNode, to<ParameterDeclaration>(node)->name) ||
@@ -276,7 +284,7 @@ namespace tr {
                        visitNode(cbNode, to<ParameterDeclaration>(node)->type) ||
                        visitNode(cbNode, to<ParameterDeclaration>(node)->initializer);
             case SyntaxKind::PropertyDeclaration:
-                return visitNodes(cbNode, cbNodes, to<PropertyDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<PropertyDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<PropertyDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<PropertyDeclaration>(node)->name) ||
                        visitNode(cbNode, to<PropertyDeclaration>(node)->questionToken) ||
@@ -284,27 +292,27 @@ namespace tr {
                        visitNode(cbNode, to<PropertyDeclaration>(node)->type) ||
                        visitNode(cbNode, to<PropertyDeclaration>(node)->initializer);
             case SyntaxKind::PropertySignature:
-                return visitNodes(cbNode, cbNodes, to<PropertySignature>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<PropertySignature>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<PropertySignature>(node)->modifiers) ||
                        visitNode(cbNode, to<PropertySignature>(node)->name) ||
                        visitNode(cbNode, to<PropertySignature>(node)->questionToken) ||
                        visitNode(cbNode, to<PropertySignature>(node)->type) ||
                        visitNode(cbNode, to<PropertySignature>(node)->initializer);
             case SyntaxKind::PropertyAssignment:
-                return visitNodes(cbNode, cbNodes, to<PropertyAssignment>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<PropertyAssignment>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<PropertyAssignment>(node)->modifiers) ||
                        visitNode(cbNode, to<PropertyAssignment>(node)->name) ||
                        visitNode(cbNode, to<PropertyAssignment>(node)->questionToken) ||
                        visitNode(cbNode, to<PropertyAssignment>(node)->initializer);
             case SyntaxKind::VariableDeclaration:
-                return visitNodes(cbNode, cbNodes, to<VariableDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<VariableDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<VariableDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<VariableDeclaration>(node)->name) ||
                        visitNode(cbNode, to<VariableDeclaration>(node)->exclamationToken) ||
                        visitNode(cbNode, to<VariableDeclaration>(node)->type) ||
                        visitNode(cbNode, to<VariableDeclaration>(node)->initializer);
             case SyntaxKind::BindingElement: {
-                return visitNodes(cbNode, cbNodes, to<BindingElement>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<BindingElement>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<BindingElement>(node)->modifiers) ||
                        visitNode(cbNode, to<BindingElement>(node)->dotDotDotToken) ||
                        visitNode(cbNode, to<BindingElement>(node)->propertyName) ||
@@ -316,35 +324,53 @@ namespace tr {
             case SyntaxKind::CallSignature:
             case SyntaxKind::ConstructSignature:
             case SyntaxKind::IndexSignature:
-                return visitNodes(cbNode, cbNodes, node->decorators) ||
+                return visitNodes(cbNode, cbNodes, node->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, node->modifiers) ||
-                       visitNodes(cbNode, cbNodes, to<IndexSignatureDeclaration>(node)->typeParameters) ||
-                       visitNodes(cbNode, cbNodes, to<IndexSignatureDeclaration>(node)->parameters) ||
-                       visitNode(cbNode, to<IndexSignatureDeclaration>(node)->type);
-            case SyntaxKind::MethodDeclaration:
+                       visitNodes(cbNode, cbNodes, node->cast<SignatureDeclarationBase>().typeParameters) ||
+                       visitNodes(cbNode, cbNodes, node->cast<SignatureDeclarationBase>().parameters) ||
+                       visitNode(cbNode, node->cast<SignatureDeclarationBase>().type);
             case SyntaxKind::MethodSignature:
+                return visitNodes(cbNode, cbNodes, node->getDecorators()) ||
+                       visitNodes(cbNode, cbNodes, node->modifiers) ||
+                       visitNode(cbNode, to<MethodSignature>(node)->name) ||
+                       visitNode(cbNode, to<MethodSignature>(node)->questionToken) ||
+                       visitNodes(cbNode, cbNodes, to<MethodSignature>(node)->typeParameters) ||
+                       visitNodes(cbNode, cbNodes, to<MethodSignature>(node)->parameters) ||
+                       visitNode(cbNode, to<MethodSignature>(node)->type);
+            case SyntaxKind::MethodDeclaration:
             case SyntaxKind::Constructor:
             case SyntaxKind::GetAccessor:
             case SyntaxKind::SetAccessor:
             case SyntaxKind::FunctionExpression:
             case SyntaxKind::FunctionDeclaration:
             case SyntaxKind::ArrowFunction: {
-                if (auto b = visitNodes(cbNode, cbNodes, node->decorators)) return b;
+                //the concrete declarations redeclare name and body, so the members of FunctionLikeDeclarationBase are not set
+                sharedOpt<Node> name, body;
+                switch (node->kind) {
+                    case SyntaxKind::MethodDeclaration: name = to<MethodDeclaration>(node)->name, body = to<MethodDeclaration>(node)->body; break;
+                    case SyntaxKind::Constructor: name = to<ConstructorDeclaration>(node)->name, body = to<ConstructorDeclaration>(node)->body; break;
+                    case SyntaxKind::GetAccessor: name = to<GetAccessorDeclaration>(node)->name, body = to<GetAccessorDeclaration>(node)->body; break;
+                    case SyntaxKind::SetAccessor: name = to<SetAccessorDeclaration>(node)->name, body = to<SetAccessorDeclaration>(node)->body; break;
+                    case SyntaxKind::FunctionExpression: name = to<FunctionExpression>(node)->name, body = to<FunctionExpression>(node)->body; break;
+                    case SyntaxKind::FunctionDeclaration: name = to<FunctionDeclaration>(node)->name, body = to<FunctionDeclaration>(node)->body; break;
+                    case SyntaxKind::ArrowFunction: body = to<ArrowFunction>(node)->body; break;
+                    default: name = node->cast<FunctionLikeDeclarationBase>().name, body = node->cast<FunctionLikeDeclarationBase>().body;
+                }
 
-                return visitNodes(cbNode, cbNodes, node->decorators) ||
+                return visitNodes(cbNode, cbNodes, node->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, node->modifiers) ||
                        visitNode(cbNode, node->cast<FunctionLikeDeclarationBase>().asteriskToken) ||
-                       visitNode(cbNode, node->cast<FunctionLikeDeclarationBase>().name) ||
+                       visitNode(cbNode, name) ||
                        visitNode(cbNode, node->cast<FunctionLikeDeclarationBase>().questionToken) ||
                        visitNode(cbNode, node->cast<FunctionLikeDeclarationBase>().exclamationToken) ||
                        visitNodes(cbNode, cbNodes, node->cast<FunctionLikeDeclarationBase>().typeParameters) ||
                        visitNodes(cbNode, cbNodes, node->cast<FunctionLikeDeclarationBase>().parameters) ||
                        visitNode(cbNode, node->cast<FunctionLikeDeclarationBase>().type) ||
                        (node->kind == SyntaxKind::ArrowFunction ? visitNode(cbNode, to<ArrowFunction>(node)->equalsGreaterThanToken) : shared<Node>(nullptr)) ||
-                       visitNode(cbNode, node->cast<FunctionLikeDeclarationBase>().body);
+                       visitNode(cbNode, body);
             }
             case SyntaxKind::ClassStaticBlockDeclaration:
-                return visitNodes(cbNode, cbNodes, to<ClassStaticBlockDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ClassStaticBlockDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ClassStaticBlockDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ClassStaticBlockDeclaration>(node)->body);
             case SyntaxKind::TypeReference:
@@ -419,11 +445,14 @@ namespace tr {
                        visitNode(cbNode, to<ElementAccessExpression>(node)->questionDotToken) ||
                        visitNode(cbNode, to<ElementAccessExpression>(node)->argumentExpression);
             case SyntaxKind::CallExpression:
-            case SyntaxKind::NewExpression:
                 return visitNode(cbNode, to<CallExpression>(node)->expression) ||
                        visitNode(cbNode, to<CallExpression>(node)->questionDotToken) ||
                        visitNodes(cbNode, cbNodes, to<CallExpression>(node)->typeArguments) ||
                        visitNodes(cbNode, cbNodes, to<CallExpression>(node)->arguments);
+            case SyntaxKind::NewExpression:
+                return visitNode(cbNode, to<NewExpression>(node)->expression) ||
+                       visitNodes(cbNode, cbNodes, to<NewExpression>(node)->typeArguments) ||
+                       visitNodes(cbNode, cbNodes, to<NewExpression>(node)->arguments);
             case SyntaxKind::TaggedTemplateExpression:
                 return visitNode(cbNode, to<TaggedTemplateExpression>(node)->tag) ||
                        visitNode(cbNode, to<TaggedTemplateExpression>(node)->questionDotToken) ||
@@ -469,13 +498,14 @@ namespace tr {
             case SyntaxKind::SpreadElement:
                 return visitNode(cbNode, to<SpreadElement>(node)->expression);
             case SyntaxKind::Block:
-            case SyntaxKind::ModuleBlock:
                 return visitNodes(cbNode, cbNodes, to<Block>(node)->statements);
+            case SyntaxKind::ModuleBlock:
+                return visitNodes(cbNode, cbNodes, to<ModuleBlock>(node)->statements);
             case SyntaxKind::SourceFile:
                 return visitNodes(cbNode, cbNodes, to<SourceFile>(node)->statements) ||
                        visitNode(cbNode, to<SourceFile>(node)->endOfFileToken);
             case SyntaxKind::VariableStatement:
-                return visitNodes(cbNode, cbNodes, to<VariableStatement>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<VariableStatement>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<VariableStatement>(node)->modifiers) ||
                        visitNode(cbNode, to<VariableStatement>(node)->declarationList);
             case SyntaxKind::VariableDeclarationList:
@@ -540,34 +570,34 @@ namespace tr {
             case SyntaxKind::Decorator:
                 return visitNode(cbNode, to<Decorator>(node)->expression);
             case SyntaxKind::ClassDeclaration:
-                return visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ClassDeclaration>(node)->name) ||
                        visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->typeParameters) ||
                        visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->heritageClauses) ||
                        visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->members);
             case SyntaxKind::ClassExpression:
-                return visitNodes(cbNode, cbNodes, to<ClassExpression>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ClassExpression>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ClassExpression>(node)->modifiers) ||
                        visitNode(cbNode, to<ClassExpression>(node)->name) ||
                        visitNodes(cbNode, cbNodes, to<ClassExpression>(node)->typeParameters) ||
                        visitNodes(cbNode, cbNodes, to<ClassExpression>(node)->heritageClauses) ||
                        visitNodes(cbNode, cbNodes, to<ClassExpression>(node)->members);
             case SyntaxKind::InterfaceDeclaration:
-                return visitNodes(cbNode, cbNodes, to<InterfaceDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<InterfaceDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<InterfaceDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<InterfaceDeclaration>(node)->name) ||
                        visitNodes(cbNode, cbNodes, to<InterfaceDeclaration>(node)->typeParameters) ||
-                       visitNodes(cbNode, cbNodes, to<ClassDeclaration>(node)->heritageClauses) ||
+                       visitNodes(cbNode, cbNodes, to<InterfaceDeclaration>(node)->heritageClauses) ||
                        visitNodes(cbNode, cbNodes, to<InterfaceDeclaration>(node)->members);
             case SyntaxKind::TypeAliasDeclaration:
-                return visitNodes(cbNode, cbNodes, to<TypeAliasDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<TypeAliasDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<TypeAliasDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<TypeAliasDeclaration>(node)->name) ||
                        visitNodes(cbNode, cbNodes, to<TypeAliasDeclaration>(node)->typeParameters) ||
                        visitNode(cbNode, to<TypeAliasDeclaration>(node)->type);
             case SyntaxKind::EnumDeclaration:
-                return visitNodes(cbNode, cbNodes, to<EnumDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<EnumDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<EnumDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<EnumDeclaration>(node)->name) ||
                        visitNodes(cbNode, cbNodes, to<EnumDeclaration>(node)->members);
@@ -575,17 +605,17 @@ namespace tr {
                 return visitNode(cbNode, to<EnumMember>(node)->name) ||
                        visitNode(cbNode, to<EnumMember>(node)->initializer);
             case SyntaxKind::ModuleDeclaration:
-                return visitNodes(cbNode, cbNodes, to<ModuleDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ModuleDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ModuleDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ModuleDeclaration>(node)->name) ||
                        visitNode(cbNode, to<ModuleDeclaration>(node)->body);
             case SyntaxKind::ImportEqualsDeclaration:
-                return visitNodes(cbNode, cbNodes, to<ImportEqualsDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ImportEqualsDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ImportEqualsDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ImportEqualsDeclaration>(node)->name) ||
                        visitNode(cbNode, to<ImportEqualsDeclaration>(node)->moduleReference);
             case SyntaxKind::ImportDeclaration:
-                return visitNodes(cbNode, cbNodes, to<ImportDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ImportDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ImportDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ImportDeclaration>(node)->importClause) ||
                        visitNode(cbNode, to<ImportDeclaration>(node)->moduleSpecifier) ||
@@ -609,7 +639,7 @@ namespace tr {
             case SyntaxKind::NamedExports:
                 return visitNodes(cbNode, cbNodes, to<NamedExports>(node)->elements);
             case SyntaxKind::ExportDeclaration:
-                return visitNodes(cbNode, cbNodes, to<ExportDeclaration>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ExportDeclaration>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ExportDeclaration>(node)->modifiers) ||
                        visitNode(cbNode, to<ExportDeclaration>(node)->exportClause) ||
                        visitNode(cbNode, to<ExportDeclaration>(node)->moduleSpecifier) ||
@@ -621,7 +651,7 @@ namespace tr {
                 return visitNode(cbNode, to<ExportSpecifier>(node)->propertyName) ||
                        visitNode(cbNode, to<ExportSpecifier>(node)->name);
             case SyntaxKind::ExportAssignment:
-                return visitNodes(cbNode, cbNodes, to<ExportAssignment>(node)->decorators) ||
+                return visitNodes(cbNode, cbNodes, to<ExportAssignment>(node)->getDecorators()) ||
                        visitNodes(cbNode, cbNodes, to<ExportAssignment>(node)->modifiers) ||
                        visitNode(cbNode, to<ExportAssignment>(node)->expression);
             case SyntaxKind::TemplateExpression:
@@ -642,7 +672,7 @@ namespace tr {
             case SyntaxKind::ExternalModuleReference:
                 return visitNode(cbNode, to<ExternalModuleReference>(node)->expression);
             case SyntaxKind::MissingDeclaration:
-                return visitNodes(cbNode, cbNodes, to<MissingDeclaration>(node)->decorators);
+                return visitNodes(cbNode, cbNodes, to<MissingDeclaration>(node)->getDecorators());
             case SyntaxKind::CommaListExpression:
                 return visitNodes(cbNode, cbNodes, to<CommaListExpression>(node)->elements);
 
@@ -682,6 +712,7 @@ namespace tr {
             case SyntaxKind::PartiallyEmittedExpression:
                 return visitNode(cbNode, to<PartiallyEmittedExpression>(node)->expression);
         }
+        return nullptr;
     }
 
     //@note: not in use inside Parser
@@ -846,6 +877,19 @@ namespace tr {
 
         int disallowInAndDecoratorContext = (int) NodeFlags::DisallowInContext | (int) NodeFlags::DecoratorContext;
 
+        /**
+         * Skip function bodies: only the span of each body is recorded (a Block with Block::lazy set and no statements),
+         * found by matching braces on the token stream. parseLazyBody() parses a body when it is actually needed,
+         * e.g. by the compiler to infer a return type. Declarations, signatures and types are parsed as usual.
+         *
+         * Not used for JSX, whose text can not be tokenized without parsing. Bodies with a `/` after `)` or `}`
+         * are parsed as well, since it is a division or a regular expression depending on the syntax.
+         */
+        bool lazyBodies = false;
+
+        //edits updateSourceFile() applies to a file before it parses it fully again, which frees the arenas of all versions
+        unsigned int maxGenerations = 16;
+
 //        // capture constructors in 'initializeState' to avoid null checks
 //        // tslint:disable variable-name
 //        auto NodeConstructor: new (kind: SyntaxKind, int pos, end: number) => Node;
@@ -871,18 +915,24 @@ namespace tr {
 //
         string fileName = "";
         /*NodeFlags*/ int sourceFlags = 0;
-        string sourceText = "";
+        //text of the file, in its arena or in a mapping kept alive by it (see initializeState()).
+        //identifiers and literals are views into it, see tokenValue()
+        string_view source;
         ScriptTarget languageVersion;
         ScriptKind scriptKind;
         LanguageVariant languageVariant;
         vector<DiagnosticWithDetachedLocation> parseDiagnostics;
         vector<DiagnosticWithDetachedLocation> jsDocDiagnostics;
-//        auto syntaxCursor: IncrementalParser.SyntaxCursor | undefined;
+        //subtrees finished but not yet part of a finished parent, with their pos and height, see finishNode()
+        vector<std::pair<int, unsigned int>> openSubtrees;
+        unsigned int nestingDepth = 0; //height of the highest subtree finished, see SourceFile::nestingDepth
+        SyntaxCursor *syntaxCursor = nullptr; //set while parsing incrementally, see updateSourceFile()
+        std::weak_ptr<SourceFile> lazyFile; //the state is set up for its lazy bodies, see parseLazyBody()
+        bool declarationFile = false; //parsing a .d.ts, see parseAssignmentExpressionOrHigher()
 
         SyntaxKind currentToken;
         int nodeCount = 0;
-        unordered_map<string, string> identifiers;
-        unordered_map<string, string> privateIdentifiers;
+        AtomTable identifiers; //moved into SourceFile::atoms, see createIdentifier()
 //        auto privateIdentifiers: ESMap<string, string>;
         int identifierCount = 0;
 
@@ -1005,14 +1055,17 @@ namespace tr {
             return nextTokenWithoutCheck();
         }
 
-        template<typename T>
-        T nextTokenAnd(function<T()> func) {
+        template<typename T, typename F>
+        T nextTokenAnd(const F &func) {
             ZoneScoped;
             nextToken();
             return func();
         }
 
-        void initializeState(string _fileName, string _sourceText, ScriptTarget _languageVersion, ScriptKind _scriptKind) {
+        //`file` is set when parsing its lazy bodies, see parseLazyBody().
+        //With `textOwner` (e.g. a MappedFile), `_sourceText` is used as is and the arena keeps the owner alive,
+        //otherwise it is copied into the arena.
+        void initializeState(string _fileName, string_view _sourceText, ScriptTarget _languageVersion, ScriptKind _scriptKind, const sharedOpt<SourceFile> &file = nullptr, std::shared_ptr<void> textOwner = nullptr) {
             ZoneScoped;
 //            NodeConstructor = objectAllocator.getNodeConstructor();
 //            TokenConstructor = objectAllocator.getTokenConstructor();
@@ -1021,7 +1074,6 @@ namespace tr {
 //            SourceFileConstructor = objectAllocator.getSourceFileConstructor();
 
             fileName = normalizePath(_fileName);
-            sourceText = _sourceText;
             languageVersion = _languageVersion;
             scriptKind = _scriptKind;
             languageVariant = getLanguageVariant(_scriptKind);
@@ -1049,9 +1101,23 @@ namespace tr {
                     break;
             }
             parseErrorBeforeNextFinishedNode = false;
+            syntaxCursor = nullptr;
+            lazyFile.reset();
+            declarationFile = false;
+
+            //all nodes of this file go into one arena, owned by the SourceFile (see Factory::createSourceFile())
+            factory.arena = file ? file->arena : std::make_shared<Arena>();
+            if (file) {
+                source = file->text;
+            } else if (textOwner) {
+                source = _sourceText;
+                factory.arena->retain(std::move(textOwner));
+            } else {
+                source = factory.store(_sourceText);
+            }
 
             // Initialize and prime the scanner before parsing the source elements.
-            scanner.setText(sourceText);
+            scanner.setText(source);
 //            scanner.setOnError([this](auto ...a) { scanError(a...); });
             scanner.setScriptTarget(languageVersion);
             scanner.setLanguageVariant(languageVariant);
@@ -1061,22 +1127,26 @@ namespace tr {
             ZoneScoped;
             // Clear out the text the scanner is pointing at, so it doesn't keep anything alive unnecessarily.
             scanner.clearCommentDirectives();
-            scanner.setText("");
+            scanner.setText();
             scanner.setOnError(nullopt);
 
             // Clear any data.  We don't want to accidentally hold onto it for too long.
-            sourceText = "";
+            source = {};
             languageVersion = ScriptTarget::Latest;
-//            syntaxCursor = undefined;
+            syntaxCursor = nullptr;
+            lazyFile.reset();
             scriptKind = ScriptKind::Unknown;
             languageVariant = LanguageVariant::Standard;
             sourceFlags = 0;
             parseDiagnostics.clear();
             parsingContext = 0;
-//            identifiers = undefined!;
+            identifiers.clear();
 //            notParenthesizedArrow = undefined;
             notParenthesizedArrow.clear();
             topLevel = true;
+            openSubtrees.clear();
+            nestingDepth = 0;
+            factory.arena.reset();
         }
 
         int getNodePos() {
@@ -1106,115 +1176,99 @@ namespace tr {
 //            return node;
         }
 
-//        function reparseTopLevelAwait(sourceFile: SourceFile) {
-//            auto savedSyntaxCursor = syntaxCursor;
-//            auto baseSyntaxCursor = IncrementalParser.createSyntaxCursor(sourceFile);
-//            syntaxCursor = { currentNode };
-//
-//            auto statements: Statement[] = [];
-//            auto savedParseDiagnostics = parseDiagnostics;
-//
-//            parseDiagnostics = [];
-//
-//            auto pos = 0;
-//            auto start = findNextStatementWithAwait(sourceFile.statements, 0);
-//            while (start != -1) {
-//                // append all statements between pos and start
-//                auto prevStatement = sourceFile.statements[pos];
-//                auto nextStatement = sourceFile.statements[start];
-//                addRange(statements, sourceFile.statements, pos, start);
-//                pos = findNextStatementWithoutAwait(sourceFile.statements, start);
-//
-//                // append all diagnostics associated with the copied range
-//                auto diagnosticStart = findIndex(savedParseDiagnostics, diagnostic => diagnostic.start >= prevStatement.pos);
-//                auto diagnosticEnd = diagnosticStart >= 0 ? findIndex(savedParseDiagnostics, diagnostic => diagnostic.start >= nextStatement.pos, diagnosticStart) : -1;
-//                if (diagnosticStart >= 0) {
-//                    addRange(parseDiagnostics, savedParseDiagnostics, diagnosticStart, diagnosticEnd >= 0 ? diagnosticEnd : undefined);
-//                }
-//
-//                // reparse all statements between start and pos. We skip existing diagnostics for the same range and allow the parser to generate new ones.
-//                speculationHelper(() => {
-//                    auto savedContextFlags = contextFlags;
-//                    contextFlags |= NodeFlags::AwaitContext;
-//                    scanner.setTextPos(nextStatement.pos);
-//                    nextToken();
-//
-//                    while (token() != SyntaxKind::EndOfFileToken) {
-//                        auto startPos = scanner.getStartPos();
-//                        auto statement = parseListElement(ParsingContext::SourceElements, parseStatement);
-//                        statements.push(statement);
-//                        if (startPos == scanner.getStartPos()) {
-//                            nextToken();
-//                        }
-//
-//                        if (pos >= 0) {
-//                            auto nonAwaitStatement = sourceFile.statements[pos];
-//                            if (statement.end == nonAwaitStatement.pos) {
-//                                // done reparsing this section
-//                                break;
-//                            }
-//                            if (statement.end > nonAwaitStatement.pos) {
-//                                // we ate into the next statement, so we must reparse it.
-//                                pos = findNextStatementWithoutAwait(sourceFile.statements, pos + 1);
-//                            }
-//                        }
-//                    }
-//
-//                    contextFlags = savedContextFlags;
-//                }, SpeculationKind::Reparse);
-//
-//                // find the next statement containing an `await`
-//                start = pos >= 0 ? findNextStatementWithAwait(sourceFile.statements, pos) : -1;
-//            }
-//
-//            // append all statements between pos and the end of the list
-//            if (pos >= 0) {
-//                auto prevStatement = sourceFile.statements[pos];
-//                addRange(statements, sourceFile.statements, pos);
-//
-//                // append all diagnostics associated with the copied range
-//                auto diagnosticStart = findIndex(savedParseDiagnostics, diagnostic => diagnostic.start >= prevStatement.pos);
-//                if (diagnosticStart >= 0) {
-//                    addRange(parseDiagnostics, savedParseDiagnostics, diagnosticStart);
-//                }
-//            }
-//
-//            syntaxCursor = savedSyntaxCursor;
-//            return factory.updateSourceFile(sourceFile, setTextRange(factory.createNodeArray(statements), sourceFile.statements));
-//
-//            function containsPossibleTopLevelAwait(node: Node) {
-//                return !(node.flags & NodeFlags::AwaitContext)
-//                    && !!(node.transformFlags & TransformFlags.ContainsPossibleTopLevelAwait);
-//            }
-//
-//            function findNextStatementWithAwait(statements: NodeArray<Statement>, start: number) {
-//                for (let i = start; i < statements.length; i++) {
-//                    if (containsPossibleTopLevelAwait(statements[i])) {
-//                        return i;
-//                    }
-//                }
-//                return -1;
-//            }
-//
-//            function findNextStatementWithoutAwait(statements: NodeArray<Statement>, start: number) {
-//                for (let i = start; i < statements.length; i++) {
-//                    if (!containsPossibleTopLevelAwait(statements[i])) {
-//                        return i;
-//                    }
-//                }
-//                return -1;
-//            }
-//
-//            function currentNode(position: number) {
-//                auto node = baseSyntaxCursor.currentNode(position);
-//                if (topLevel && node && containsPossibleTopLevelAwait(node)) {
-//                    node.intersectsChange = true;
-//                }
-//                return node;
-//            }
-//
-//        }
-//
+        static bool containsPossibleTopLevelAwait(const shared<Node> &node) {
+            return !(node->flags & (int) NodeFlags::AwaitContext)
+                   && (node->transformFlags & (int) TransformFlags::ContainsPossibleTopLevelAwait);
+        }
+
+        static int findNextStatementWithAwait(const vector<shared<Node>> &statements, int start) {
+            for (int i = start; i < (int) statements.size(); i++) {
+                if (containsPossibleTopLevelAwait(statements[i])) return i;
+            }
+            return -1;
+        }
+
+        static int findNextStatementWithoutAwait(const vector<shared<Node>> &statements, int start) {
+            for (int i = start; i < (int) statements.size(); i++) {
+                if (!containsPossibleTopLevelAwait(statements[i])) return i;
+            }
+            return -1;
+        }
+
+        /**
+         * Parses the statements of a module that may use `await` at the top level again in an await context.
+         * Statements without it and their diagnostics are kept. Unlike TypeScript, the statements in between are
+         * not reused through a syntax cursor but parsed again as well.
+         */
+        void reparseTopLevelAwait(const shared<SourceFile> &sourceFile) {
+            auto &list = sourceFile->statements->list;
+            auto statements = factory.make<NodeArray>();
+            auto savedParseDiagnostics = std::move(parseDiagnostics);
+            parseDiagnostics.clear();
+
+            //diagnostics of the copied statements in [from, to)
+            auto copyDiagnostics = [&](int from, int to) {
+                for (auto &&diagnostic: savedParseDiagnostics) {
+                    if (diagnostic.start >= from && (to < 0 || diagnostic.start < to)) parseDiagnostics.push_back(diagnostic);
+                }
+            };
+
+            auto pos = 0;
+            auto start = findNextStatementWithAwait(list, 0);
+            while (start != -1) {
+                // append all statements between pos and start
+                auto prevStatement = list[pos];
+                auto nextStatement = list[start];
+                statements->list.insert(statements->list.end(), list.begin() + pos, list.begin() + start);
+                pos = findNextStatementWithoutAwait(list, start);
+                copyDiagnostics(prevStatement->pos, nextStatement->pos);
+
+                // reparse all statements between start and pos. We skip existing diagnostics for the same range and allow the parser to generate new ones.
+                speculationHelper<bool>([&]() {
+                    auto savedContextFlags = contextFlags;
+                    contextFlags |= (int) NodeFlags::AwaitContext;
+                    scanner.setTextPos(nextStatement->pos);
+                    nextToken();
+
+                    while (token() != SyntaxKind::EndOfFileToken) {
+                        auto startPos = scanner.getStartPos();
+                        auto statement = parseListElement(ParsingContext::SourceElements, CALLBACK(parseStatement));
+                        statements->list.push_back(statement);
+                        if (startPos == scanner.getStartPos()) {
+                            nextToken();
+                        }
+
+                        if (pos >= 0) {
+                            auto nonAwaitStatement = list[pos];
+                            if (statement->end == nonAwaitStatement->pos) {
+                                // done reparsing this section
+                                break;
+                            }
+                            if (statement->end > nonAwaitStatement->pos) {
+                                // we ate into the next statement, so we must reparse it.
+                                pos = findNextStatementWithoutAwait(list, pos + 1);
+                            }
+                        }
+                    }
+
+                    contextFlags = savedContextFlags;
+                    return true;
+                }, SpeculationKind::Reparse);
+
+                // find the next statement containing an `await`
+                start = pos >= 0 ? findNextStatementWithAwait(list, pos) : -1;
+            }
+
+            // append all statements between pos and the end of the list
+            if (pos >= 0) {
+                copyDiagnostics(list[pos]->pos, -1);
+                statements->list.insert(statements->list.end(), list.begin() + pos, list.end());
+            }
+
+            setTextRangePosEnd(statements, sourceFile->statements->pos, sourceFile->statements->end);
+            sourceFile->statements = factory.createNodeArray(statements);
+        }
+
 //        export function fixupParentReferences(rootNode: Node) {
 //            // normally parent references are set during binding. However, for clients that only need
 //            // a syntax tree, and no semantic features, then the binding process is an unnecessary
@@ -1236,8 +1290,8 @@ namespace tr {
             // code from createNode is inlined here so createNode won't have to deal with special case of creating source files
             // this is quite rare comparing to other nodes and createNode should be as fast as possible
             auto sourceFile = factory.createSourceFile(statements, endOfFileToken, flags);
-            setTextRangePosEnd(sourceFile, 0, sourceText.size());
-            sourceFile->text = sourceText;
+            setTextRangePosEnd(sourceFile, 0, source.size());
+            sourceFile->text = source;
 
 //                sourceFile.bindDiagnostics = [];
 //                sourceFile.bindSuggestionDiagnostics = undefined;
@@ -1251,21 +1305,17 @@ namespace tr {
 
             // If we parsed this as an external module, it may contain top-level await
             if (!isDeclarationFile && isExternalModule(sourceFile) && sourceFile->transformFlags & (int) TransformFlags::ContainsPossibleTopLevelAwait) {
-                throw runtime_error("not implemented");
-//                sourceFile = reparseTopLevelAwait(sourceFile);
-
-                sourceFile->text = sourceText;
-//                sourceFile.bindDiagnostics = [];
-//                sourceFile.bindSuggestionDiagnostics = undefined;
-                sourceFile->languageVersion = languageVersion;
-                sourceFile->fileName = fileName;
-                sourceFile->languageVariant = getLanguageVariant(scriptKind);
-                sourceFile->isDeclarationFile = isDeclarationFile;
-                sourceFile->scriptKind = scriptKind;
+                //replaces the statements in place, the other fields stay set
+                reparseTopLevelAwait(sourceFile);
                 setExternalModuleIndicator(sourceFile);
-                sourceFile->setExternalModuleIndicator = setExternalModuleIndicator;
             }
 
+            //after the reparse, which interns its identifiers and allocates its nodes like the first parse
+            sourceFile->atoms = std::move(identifiers);
+            sourceFile->arena = factory.arena;
+            sourceFile->nestingDepth = nestingDepth;
+            identifiers.clear();
+
             return sourceFile;
         }
 
@@ -1359,8 +1409,8 @@ namespace tr {
         SyntaxKind scanJsxText() {
             return currentToken = scanner.scanJsxToken();
         }
-        template<typename T>
-        T speculationHelper(const function<T()> &callback, SpeculationKind speculationKind) {
+        template<typename T, typename F>
+        T speculationHelper(const F &callback, SpeculationKind speculationKind) {
             ZoneScoped;
             // Keep track of the state we'll need to rollback to if lookahead fails (or if the
             // caller asked us to always reset our state).
@@ -1400,8 +1450,8 @@ namespace tr {
          * was in immediately prior to invoking the callback.  The result of invoking the callback
          * is returned from this function.
          */
-        template<typename T>
-        T lookAhead(const function<T()> &callback) {
+        template<typename T, typename F>
+        T lookAhead(const F &callback) {
             ZoneScoped;
             return speculationHelper<T>(callback, SpeculationKind::Lookahead);
         }
@@ -1468,7 +1518,7 @@ namespace tr {
             //   ^^^^^^^^^^^ This block is parsed as a template literal like module`M1`.
             if (isTaggedTemplateExpression(node)) {
                 auto n = to<TaggedTemplateExpression>(node);
-                parseErrorAt(skipTrivia(sourceText, n->templateLiteral->pos), n->templateLiteral->end, Diagnostics::Module_declaration_names_may_only_use_or_quoted_strings());
+                parseErrorAt(skipTrivia(source, n->templateLiteral->pos), n->templateLiteral->end, Diagnostics::Module_declaration_names_may_only_use_or_quoted_strings());
                 return;
             }
 
@@ -1479,7 +1529,7 @@ namespace tr {
                 return;
             }
 
-            auto pos = skipTrivia(sourceText, node->pos);
+            auto pos = skipTrivia(source, node->pos);
 
             // Some known keywords are likely signs of syntax being used improperly.
             switch (runtime_hash(expressionText)) {
@@ -1618,6 +1668,16 @@ namespace tr {
                 node->flags |= contextFlags;
             }
 
+            //children are finished before their parent and lie within it, so the open subtrees from its pos on
+            //are its children (or nodes of a lookahead, which only makes the height larger than it is)
+            unsigned int height = 1;
+            while (!openSubtrees.empty() && openSubtrees.back().first >= node->pos) {
+                height = std::max(height, openSubtrees.back().second + 1);
+                openSubtrees.pop_back();
+            }
+            openSubtrees.emplace_back(node->pos, height);
+            if (height > nestingDepth) nestingDepth = height;
+
             // Keep track on the node if we encountered an error while parsing it.  If we did, then
             // we cannot reuse the node incrementally.  Once we've marked this node, clear out the
             // flag so that we don't mark any subsequent nodes.
@@ -1713,9 +1773,23 @@ namespace tr {
         }
 
 
-        string internIdentifier(const string &text) {
+        /**
+         * The value of the current token without copy, as view into the source when it is a slice of it (no escapes),
+         * otherwise as copy in the arena. `offset` is where the value starts in the token, e.g. 1 for string literals.
+         * Both live as long as the SourceFile.
+         */
+        string_view tokenValue(int offset = 0) {
+            auto &value = scanner.getTokenValue();
+            auto start = scanner.getTokenPos() + offset;
+            if (start + value.size() <= source.size() && source.compare(start, value.size(), value) == 0) {
+                return source.substr(start, value.size());
+            }
+            return factory.store(value);
+        }
+
+        string_view internIdentifier(string_view text) {
             //this was used in the JS version as optimization to not reuse text instances.
-            //we do not need that.
+            //we do not need that, texts are views into the source already (see tokenValue()).
             return text;
 //            auto identifier = get(identifiers, text);
 //            if (!identifier) {
@@ -1753,8 +1827,8 @@ namespace tr {
          * callback returns something truthy, then the parser state is not rolled back.  The result
          * of invoking the callback is returned from this function.
          */
-        template<typename T>
-        T tryParse(const function<T()> &callback) {
+        template<typename T, typename F>
+        T tryParse(const F &callback) {
             return speculationHelper<T>(callback, SpeculationKind::TryParse);
         }
 
@@ -2024,51 +2098,44 @@ namespace tr {
             // Note: This may be too conservative.  Perhaps we could reuse the node and set the bit
             // on it (or its leftmost child) as having the error.  For now though, being conservative
             // is nice and likely won't ever affect perf.
-//            if (!syntaxCursor || !isReusableParsingContext(parsingContext) || parseErrorBeforeNextFinishedNode) {
-//                return undefined;
-//            }
+            if (!syntaxCursor || !isReusableParsingContext(parsingContext) || parseErrorBeforeNextFinishedNode) {
+                return nullptr;
+            }
 
-            //I hope we do not need to reimplement syntaxCursor too
-            return nullptr;
+            auto node = syntaxCursor->currentNode(scanner.getStartPos());
 
-//            auto node = syntaxCursor.currentNode(scanner.getStartPos());
-//
-//            // Can't reuse a missing node.
-//            // Can't reuse a node that intersected the change range.
-//            // Can't reuse a node that contains a parse error.  This is necessary so that we
-//            // produce the same set of errors again.
-//            if (nodeIsMissing(node) || node.intersectsChange || containsParseError(node)) {
-//                return undefined;
-//            }
-//
-//            // We can only reuse a node if it was parsed under the same strict mode that we're
-//            // currently in.  i.e. if we originally parsed a node in non-strict mode, but then
-//            // the user added 'using strict' at the top of the file, then we can't use that node
-//            // again as the presence of strict mode may cause us to parse the tokens in the file
-//            // differently.
-//            //
-//            // Note: we *can* reuse tokens when the strict mode changes.  That's because tokens
-//            // are unaffected by strict mode.  It's just the parser will decide what to do with it
-//            // differently depending on what mode it is in.
-//            //
-//            // This also applies to all our other context flags as well.
-//            auto nodeContextFlags = node.flags & NodeFlags::ContextFlags;
-//            if (nodeContextFlags != contextFlags) {
-//                return undefined;
-//            }
-//
-//            // Ok, we have a node that looks like it could be reused.  Now verify that it is valid
-//            // in the current list parsing context that we're currently at.
-//            if (!canReuseNode(node, parsingContext)) {
-//                return undefined;
-//            }
-//
-//            if (reinterpret_cast<JSDocContainer&>(node).jsDocCache) {
-//                // jsDocCache may include tags from parent nodes, which might have been modified.
-//                reinterpret_cast<JSDocContainer&>(node).jsDocCache = undefined;
-//            }
-//
-//            return node;
+            // Can't reuse a missing node.
+            // Can't reuse a node that intersected the change range.
+            // Can't reuse a node that contains a parse error.  This is necessary so that we
+            // produce the same set of errors again.
+            if (nodeIsMissing(node) || syntaxCursor->intersectsChange(node.get()) || containsParseError(node)) {
+                return nullptr;
+            }
+
+            // We can only reuse a node if it was parsed under the same strict mode that we're
+            // currently in.  i.e. if we originally parsed a node in non-strict mode, but then
+            // the user added 'using strict' at the top of the file, then we can't use that node
+            // again as the presence of strict mode may cause us to parse the tokens in the file
+            // differently.
+            //
+            // Note: we *can* reuse tokens when the strict mode changes.  That's because tokens
+            // are unaffected by strict mode.  It's just the parser will decide what to do with it
+            // differently depending on what mode it is in.
+            //
+            // This also applies to all our other context flags as well.
+            auto nodeContextFlags = node->flags & (int) NodeFlags::ContextFlags;
+            if (nodeContextFlags != contextFlags) {
+                return nullptr;
+            }
+
+            // Ok, we have a node that looks like it could be reused.  Now verify that it is valid
+            // in the current list parsing context that we're currently at.
+            if (!canReuseNode(node, parsingContext)) {
+                return nullptr;
+            }
+
+            //no JSDoc support, so no jsDocCache to reset
+            return node;
         }
 
         bool isHeritageClause() {
@@ -2597,230 +2664,214 @@ namespace tr {
             return node;
         }
 
-//        function isReusableParsingContext(parsingContext: ParsingContext): boolean {
-//            switch (parsingContext) {
-//                case ParsingContext::ClassMembers:
-//                case ParsingContext::SwitchClauses:
-//                case ParsingContext::SourceElements:
-//                case ParsingContext::BlockStatements:
-//                case ParsingContext::SwitchClauseStatements:
-//                case ParsingContext::EnumMembers:
-//                case ParsingContext::TypeMembers:
-//                case ParsingContext::VariableDeclarations:
-//                case ParsingContext::JSDocParameters:
-//                case ParsingContext::Parameters:
-//                    return true;
-//            }
-//            return false;
-//        }
-//
-//        function canReuseNode(node: Node, parsingContext: ParsingContext): boolean {
-//            switch (parsingContext) {
-//                case ParsingContext::ClassMembers:
-//                    return isReusableClassMember(node);
-//
-//                case ParsingContext::SwitchClauses:
-//                    return isReusableSwitchClause(node);
-//
-//                case ParsingContext::SourceElements:
-//                case ParsingContext::BlockStatements:
-//                case ParsingContext::SwitchClauseStatements:
-//                    return isReusableStatement(node);
-//
-//                case ParsingContext::EnumMembers:
-//                    return isReusableEnumMember(node);
-//
-//                case ParsingContext::TypeMembers:
-//                    return isReusableTypeMember(node);
-//
-//                case ParsingContext::VariableDeclarations:
-//                    return isReusableVariableDeclaration(node);
-//
-//                case ParsingContext::JSDocParameters:
-//                case ParsingContext::Parameters:
-//                    return isReusableParameter(node);
-//
-//                // Any other lists we do not care about reusing nodes in.  But feel free to add if
-//                // you can do so safely.  Danger areas involve nodes that may involve speculative
-//                // parsing.  If speculative parsing is involved with the node, then the range the
-//                // parser reached while looking ahead might be in the edited range (see the example
-//                // in canReuseVariableDeclaratorNode for a good case of this).
-//
-//                // case ParsingContext::HeritageClauses:
-//                // This would probably be safe to reuse.  There is no speculative parsing with
-//                // heritage clauses.
-//
-//                // case ParsingContext::TypeParameters:
-//                // This would probably be safe to reuse.  There is no speculative parsing with
-//                // type parameters.  Note that that's because type *parameters* only occur in
-//                // unambiguous *type* contexts.  While type *arguments* occur in very ambiguous
-//                // *expression* contexts.
-//
-//                // case ParsingContext::TupleElementTypes:
-//                // This would probably be safe to reuse.  There is no speculative parsing with
-//                // tuple types.
-//
-//                // Technically, type argument list types are probably safe to reuse.  While
-//                // speculative parsing is involved with them (since type argument lists are only
-//                // produced from speculative parsing a < as a type argument list), we only have
-//                // the types because speculative parsing succeeded.  Thus, the lookahead never
-//                // went past the end of the list and rewound.
-//                // case ParsingContext::TypeArguments:
-//
-//                // Note: these are almost certainly not safe to ever reuse.  Expressions commonly
-//                // need a large amount of lookahead, and we should not reuse them as they may
-//                // have actually intersected the edit.
-//                // case ParsingContext::ArgumentExpressions:
-//
-//                // This is not safe to reuse for the same reason as the 'AssignmentExpression'
-//                // cases.  i.e. a property assignment may end with an expression, and thus might
-//                // have lookahead far beyond it's old node.
-//                // case ParsingContext::ObjectLiteralMembers:
-//
-//                // This is probably not safe to reuse.  There can be speculative parsing with
-//                // type names in a heritage clause.  There can be generic names in the type
-//                // name list, and there can be left hand side expressions (which can have type
-//                // arguments.)
-//                // case ParsingContext::HeritageClauseElement:
-//
-//                // Perhaps safe to reuse, but it's unlikely we'd see more than a dozen attributes
-//                // on any given element. Same for children.
-//                // case ParsingContext::JsxAttributes:
-//                // case ParsingContext::JsxChildren:
-//
-//            }
-//
-//            return false;
-//        }
-//
-//        function isReusableClassMember(node: Node) {
-//            if (node) {
-//                switch (node.kind) {
-//                    case SyntaxKind::Constructor:
-//                    case SyntaxKind::IndexSignature:
-//                    case SyntaxKind::GetAccessor:
-//                    case SyntaxKind::SetAccessor:
-//                    case SyntaxKind::PropertyDeclaration:
-//                    case SyntaxKind::SemicolonClassElement:
-//                        return true;
-//                    case SyntaxKind::MethodDeclaration:
-//                        // Method declarations are not necessarily reusable.  An object-literal
-//                        // may have a method calls "constructor(...)" and we must reparse that
-//                        // into an actual .ConstructorDeclaration.
-//                        auto methodDeclaration = node as MethodDeclaration;
-//                        auto nameIsConstructor = methodDeclaration.name.kind == SyntaxKind::Identifier &&
-//                            methodDeclaration.name.originalKeywordKind == SyntaxKind::ConstructorKeyword;
-//
-//                        return !nameIsConstructor;
-//                }
-//            }
-//
-//            return false;
-//        }
-//
-//        function isReusableSwitchClause(node: Node) {
-//            if (node) {
-//                switch (node.kind) {
-//                    case SyntaxKind::CaseClause:
-//                    case SyntaxKind::DefaultClause:
-//                        return true;
-//                }
-//            }
-//
-//            return false;
-//        }
-//
-//        function isReusableStatement(node: Node) {
-//            if (node) {
-//                switch (node.kind) {
-//                    case SyntaxKind::FunctionDeclaration:
-//                    case SyntaxKind::VariableStatement:
-//                    case SyntaxKind::Block:
-//                    case SyntaxKind::IfStatement:
-//                    case SyntaxKind::ExpressionStatement:
-//                    case SyntaxKind::ThrowStatement:
-//                    case SyntaxKind::ReturnStatement:
-//                    case SyntaxKind::SwitchStatement:
-//                    case SyntaxKind::BreakStatement:
-//                    case SyntaxKind::ContinueStatement:
-//                    case SyntaxKind::ForInStatement:
-//                    case SyntaxKind::ForOfStatement:
-//                    case SyntaxKind::ForStatement:
-//                    case SyntaxKind::WhileStatement:
-//                    case SyntaxKind::WithStatement:
-//                    case SyntaxKind::EmptyStatement:
-//                    case SyntaxKind::TryStatement:
-//                    case SyntaxKind::LabeledStatement:
-//                    case SyntaxKind::DoStatement:
-//                    case SyntaxKind::DebuggerStatement:
-//                    case SyntaxKind::ImportDeclaration:
-//                    case SyntaxKind::ImportEqualsDeclaration:
-//                    case SyntaxKind::ExportDeclaration:
-//                    case SyntaxKind::ExportAssignment:
-//                    case SyntaxKind::ModuleDeclaration:
-//                    case SyntaxKind::ClassDeclaration:
-//                    case SyntaxKind::InterfaceDeclaration:
-//                    case SyntaxKind::EnumDeclaration:
-//                    case SyntaxKind::TypeAliasDeclaration:
-//                        return true;
-//                }
-//            }
-//
-//            return false;
-//        }
-//
-//        function isReusableEnumMember(node: Node) {
-//            return node.kind == SyntaxKind::EnumMember;
-//        }
-//
-//        function isReusableTypeMember(node: Node) {
-//            if (node) {
-//                switch (node.kind) {
-//                    case SyntaxKind::ConstructSignature:
-//                    case SyntaxKind::MethodSignature:
-//                    case SyntaxKind::IndexSignature:
-//                    case SyntaxKind::PropertySignature:
-//                    case SyntaxKind::CallSignature:
-//                        return true;
-//                }
-//            }
-//
-//            return false;
-//        }
-//
-//        function isReusableVariableDeclaration(node: Node) {
-//            if (node.kind != SyntaxKind::VariableDeclaration) {
-//                return false;
-//            }
-//
-//            // Very subtle incremental parsing bug.  Consider the following code:
-//            //
-//            //      auto v = new List < A, B
-//            //
-//            // This is actually legal code.  It's a list of variable declarators "v = new List<A"
-//            // on one side and "B" on the other. If you then change that to:
-//            //
-//            //      auto v = new List < A, B >()
-//            //
-//            // then we have a problem.  "v = new List<A" doesn't intersect the change range, so we
-//            // start reparsing at "B" and we completely fail to handle this properly.
-//            //
-//            // In order to prevent this, we do not allow a variable declarator to be reused if it
-//            // has an initializer.
-//            auto variableDeclarator = node as VariableDeclaration;
-//            return variableDeclarator.initializer == undefined;
-//        }
-//
-//        function isReusableParameter(node: Node) {
-//            if (node.kind != SyntaxKind::Parameter) {
-//                return false;
-//            }
-//
-//            // See the comment in isReusableVariableDeclaration for why we do this.
-//            auto parameter = node as ParameterDeclaration;
-//            return parameter.initializer == undefined;
-//        }
-//
+        bool isReusableParsingContext(ParsingContext parsingContext) {
+            switch (parsingContext) {
+                case ParsingContext::ClassMembers:
+                case ParsingContext::SwitchClauses:
+                case ParsingContext::SourceElements:
+                case ParsingContext::BlockStatements:
+                case ParsingContext::SwitchClauseStatements:
+                case ParsingContext::EnumMembers:
+                case ParsingContext::TypeMembers:
+                case ParsingContext::VariableDeclarations:
+                case ParsingContext::JSDocParameters:
+                case ParsingContext::Parameters:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool canReuseNode(const shared<Node> &node, ParsingContext parsingContext) {
+            switch (parsingContext) {
+                case ParsingContext::ClassMembers:
+                    return isReusableClassMember(node);
+
+                case ParsingContext::SwitchClauses:
+                    return isReusableSwitchClause(node);
+
+                case ParsingContext::SourceElements:
+                case ParsingContext::BlockStatements:
+                case ParsingContext::SwitchClauseStatements:
+                    return isReusableStatement(node);
+
+                case ParsingContext::EnumMembers:
+                    return isReusableEnumMember(node);
+
+                case ParsingContext::TypeMembers:
+                    return isReusableTypeMember(node);
+
+                case ParsingContext::VariableDeclarations:
+                    return isReusableVariableDeclaration(node);
+
+                case ParsingContext::JSDocParameters:
+                case ParsingContext::Parameters:
+                    return isReusableParameter(node);
+
+                // Any other lists we do not care about reusing nodes in.  But feel free to add if
+                // you can do so safely.  Danger areas involve nodes that may involve speculative
+                // parsing.  If speculative parsing is involved with the node, then the range the
+                // parser reached while looking ahead might be in the edited range (see the example
+                // in canReuseVariableDeclaratorNode for a good case of this).
+
+                // case ParsingContext::HeritageClauses:
+                // This would probably be safe to reuse.  There is no speculative parsing with
+                // heritage clauses.
+
+                // case ParsingContext::TypeParameters:
+                // This would probably be safe to reuse.  There is no speculative parsing with
+                // type parameters.  Note that that's because type *parameters* only occur in
+                // unambiguous *type* contexts.  While type *arguments* occur in very ambiguous
+                // *expression* contexts.
+
+                // case ParsingContext::TupleElementTypes:
+                // This would probably be safe to reuse.  There is no speculative parsing with
+                // tuple types.
+
+                // Technically, type argument list types are probably safe to reuse.  While
+                // speculative parsing is involved with them (since type argument lists are only
+                // produced from speculative parsing a < as a type argument list), we only have
+                // the types because speculative parsing succeeded.  Thus, the lookahead never
+                // went past the end of the list and rewound.
+                // case ParsingContext::TypeArguments:
+
+                // Note: these are almost certainly not safe to ever reuse.  Expressions commonly
+                // need a large amount of lookahead, and we should not reuse them as they may
+                // have actually intersected the edit.
+                // case ParsingContext::ArgumentExpressions:
+
+                // This is not safe to reuse for the same reason as the 'AssignmentExpression'
+                // cases.  i.e. a property assignment may end with an expression, and thus might
+                // have lookahead far beyond it's old node.
+                // case ParsingContext::ObjectLiteralMembers:
+
+                // This is probably not safe to reuse.  There can be speculative parsing with
+                // type names in a heritage clause.  There can be generic names in the type
+                // name list, and there can be left hand side expressions (which can have type
+                // arguments.)
+                // case ParsingContext::HeritageClauseElement:
+
+                // Perhaps safe to reuse, but it's unlikely we'd see more than a dozen attributes
+                // on any given element. Same for children.
+                // case ParsingContext::JsxAttributes:
+                // case ParsingContext::JsxChildren:
+
+                default:
+                    return false;
+            }
+        }
+
+        bool isReusableClassMember(const shared<Node> &node) {
+            switch (node->kind) {
+                case SyntaxKind::Constructor:
+                case SyntaxKind::IndexSignature:
+                case SyntaxKind::GetAccessor:
+                case SyntaxKind::SetAccessor:
+                case SyntaxKind::PropertyDeclaration:
+                case SyntaxKind::SemicolonClassElement:
+                    return true;
+                case SyntaxKind::MethodDeclaration: {
+                    // Method declarations are not necessarily reusable.  An object-literal
+                    // may have a method calls "constructor(...)" and we must reparse that
+                    // into an actual .ConstructorDeclaration.
+                    auto name = to<Identifier>(to<MethodDeclaration>(node)->name);
+                    auto nameIsConstructor = name && name->originalKeywordKind == SyntaxKind::ConstructorKeyword;
+                    return !nameIsConstructor;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        bool isReusableSwitchClause(const shared<Node> &node) {
+            return node->kind == SyntaxKind::CaseClause || node->kind == SyntaxKind::DefaultClause;
+        }
+
+        bool isReusableStatement(const shared<Node> &node) {
+            switch (node->kind) {
+                case SyntaxKind::FunctionDeclaration:
+                case SyntaxKind::VariableStatement:
+                case SyntaxKind::Block:
+                case SyntaxKind::IfStatement:
+                case SyntaxKind::ExpressionStatement:
+                case SyntaxKind::ThrowStatement:
+                case SyntaxKind::ReturnStatement:
+                case SyntaxKind::SwitchStatement:
+                case SyntaxKind::BreakStatement:
+                case SyntaxKind::ContinueStatement:
+                case SyntaxKind::ForInStatement:
+                case SyntaxKind::ForOfStatement:
+                case SyntaxKind::ForStatement:
+                case SyntaxKind::WhileStatement:
+                case SyntaxKind::WithStatement:
+                case SyntaxKind::EmptyStatement:
+                case SyntaxKind::TryStatement:
+                case SyntaxKind::LabeledStatement:
+                case SyntaxKind::DoStatement:
+                case SyntaxKind::DebuggerStatement:
+                case SyntaxKind::ImportDeclaration:
+                case SyntaxKind::ImportEqualsDeclaration:
+                case SyntaxKind::ExportDeclaration:
+                case SyntaxKind::ExportAssignment:
+                case SyntaxKind::ModuleDeclaration:
+                case SyntaxKind::ClassDeclaration:
+                case SyntaxKind::InterfaceDeclaration:
+                case SyntaxKind::EnumDeclaration:
+                case SyntaxKind::TypeAliasDeclaration:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool isReusableEnumMember(const shared<Node> &node) {
+            return node->kind == SyntaxKind::EnumMember;
+        }
+
+        bool isReusableTypeMember(const shared<Node> &node) {
+            switch (node->kind) {
+                case SyntaxKind::ConstructSignature:
+                case SyntaxKind::MethodSignature:
+                case SyntaxKind::IndexSignature:
+                case SyntaxKind::PropertySignature:
+                case SyntaxKind::CallSignature:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool isReusableVariableDeclaration(const shared<Node> &node) {
+            if (node->kind != SyntaxKind::VariableDeclaration) {
+                return false;
+            }
+
+            // Very subtle incremental parsing bug.  Consider the following code:
+            //
+            //      let v = new List < A, B
+            //
+            // This is actually legal code.  It's a list of variable declarators "v = new List<A"
+            // on one side and "B" on the other. If you then change that to:
+            //
+            //      let v = new List < A, B >()
+            //
+            // then we have a problem.  "v = new List<A" doesn't intersect the change range, so we
+            // start reparsing at "B" and we completely fail to handle this properly.
+            //
+            // In order to prevent this, we do not allow a variable declarator to be reused if it
+            // has an initializer.
+            return !to<VariableDeclaration>(node)->initializer;
+        }
+
+        bool isReusableParameter(const shared<Node> &node) {
+            if (node->kind != SyntaxKind::Parameter) {
+                return false;
+            }
+
+            // See the comment in isReusableVariableDeclaration for why we do this.
+            return !to<ParameterDeclaration>(node)->initializer;
+        }
+
         sharedOpt<DiagnosticMessage> getExpectedCommaDiagnostic(ParsingContext kind) {
             if (kind == ParsingContext::EnumMembers) return Diagnostics::An_enum_member_name_must_be_followed_by_a_or();
             return nullptr;
@@ -2927,8 +2978,8 @@ namespace tr {
             return false;
         }
 
-        template<class T>
-        sharedOpt<T> parseListElement(ParsingContext parsingContext, function<shared<T>()> parseElement) {
+        template<typename F>
+        sharedOpt<Node> parseListElement(ParsingContext parsingContext, const F &parseElement) {
             ZoneScoped;
             auto node = currentNode(parsingContext);
             if (node) {
@@ -2939,11 +2990,12 @@ namespace tr {
         }
 
         // Parses a list of elements
-        shared<NodeArray> parseList(ParsingContext kind, const function<shared<Node>()> &parseElement) {
+        template<typename F>
+        shared<NodeArray> parseList(ParsingContext kind, const F &parseElement) {
             ZoneScoped;
             int saveParsingContext = parsingContext;
             parsingContext |= 1 << (int) kind;
-            auto list = make_shared<NodeArray>();
+            auto list = factory.make<NodeArray>();
             auto listPos = getNodePos();
 
             while (!isListTerminator(kind)) {
@@ -2967,11 +3019,12 @@ namespace tr {
 //        // Parses a comma-delimited list of elements
 //        function parseDelimitedList<T extends Node>(kind: ParsingContext, parseElement: () => T, considerSemicolonAsDelimiter?: boolean): NodeArray<T>;
 //        function parseDelimitedList<T extends Node | undefined>(kind: ParsingContext, parseElement: () => T, considerSemicolonAsDelimiter?: boolean): NodeArray<NonNullable<T>> | undefined;
-        sharedOpt<NodeArray> parseDelimitedList(ParsingContext kind, function<sharedOpt<Node>()> parseElement, optional<bool> considerSemicolonAsDelimiter = {}) {
+        template<typename F>
+        sharedOpt<NodeArray> parseDelimitedList(ParsingContext kind, const F &parseElement, optional<bool> considerSemicolonAsDelimiter = {}) {
             ZoneScoped;
             auto saveParsingContext = parsingContext;
             parsingContext |= 1 << (int) kind;
-            auto list = make_shared<NodeArray>();
+            auto list = factory.make<NodeArray>();
             auto listPos = getNodePos();
 
             int commaStart = -1; // Meaning the previous token was not a comma
@@ -3042,7 +3095,7 @@ namespace tr {
 //        }
 
         shared<NodeArray> createMissingList() {
-            auto list = createNodeArray(make_shared<NodeArray>(), getNodePos());
+            auto list = createNodeArray(factory.make<NodeArray>(), getNodePos());
             list->isMissingList = true;
             return list;
         }
@@ -3061,9 +3114,11 @@ namespace tr {
                 auto pos = getNodePos();
                 // Store original token kind if it is not just an Identifier so we can report appropriate error later in type checker
                 auto originalKeywordKind = token();
-                auto text = internIdentifier(scanner.getTokenValue());
+                auto text = internIdentifier(tokenValue());
                 nextTokenWithoutCheck();
-                return finishNode(factory.createIdentifier(text, /*typeArguments*/ {}, originalKeywordKind), pos);
+                auto identifier = factory.createIdentifier(text, /*typeArguments*/ {}, originalKeywordKind);
+                identifier->atom = identifiers.intern(identifier->escapedText);
+                return finishNode(identifier, pos);
             }
 
             if (token() == SyntaxKind::PrivateIdentifier) {
@@ -3094,8 +3149,8 @@ namespace tr {
             return createIdentifier(isIdentifier(), diagnosticMessage, privateIdentifierDiagnosticMessage);
         }
 
-        template<typename T>
-        T doOutsideOfContext(int context, function<T()> func) {
+        template<typename T, typename F>
+        T doOutsideOfContext(int context, const F &func) {
             // contextFlagsToClear will contain only the context flags that are
             // currently set that we need to temporarily clear
             // We don't just blindly reset to the previous flags to ensure
@@ -3116,13 +3171,13 @@ namespace tr {
             return func();
         }
 
-        template<typename T>
-        T doOutsideOfContext(NodeFlags context, const function<T()> &func) {
+        template<typename T, typename F>
+        T doOutsideOfContext(NodeFlags context, const F &func) {
             return doOutsideOfContext<T>((int) context, func);
         }
 
-        template<typename T>
-        T doInsideOfContext(/*NodeFlags*/int context, function<T()> func) {
+        template<typename T, typename F>
+        T doInsideOfContext(/*NodeFlags*/int context, const F &func) {
             ZoneScoped;
             // contextFlagsToSet will contain only the context flags that
             // are not currently set that we need to temporarily enable.
@@ -3144,46 +3199,46 @@ namespace tr {
             return func();
         }
 
-        template<typename T>
-        T allowInAnd(const function<T()> &func) {
+        template<typename T, typename F>
+        T allowInAnd(const F &func) {
             return doOutsideOfContext<T>((int) NodeFlags::DisallowInContext, func);
         }
 
-        template<typename T>
-        T disallowInAnd(const function<T()> &func) {
+        template<typename T, typename F>
+        T disallowInAnd(const F &func) {
             return doInsideOfContext<T>((int) NodeFlags::DisallowInContext, func);
         }
 
-        template<typename T>
-        T allowConditionalTypesAnd(const function<T()> &func) {
+        template<typename T, typename F>
+        T allowConditionalTypesAnd(const F &func) {
             return doOutsideOfContext<T>((int) NodeFlags::DisallowConditionalTypesContext, func);
         }
-        template<typename T>
-        T disallowConditionalTypesAnd(const function<T()> &func) {
+        template<typename T, typename F>
+        T disallowConditionalTypesAnd(const F &func) {
             return doInsideOfContext<T>((int) NodeFlags::DisallowConditionalTypesContext, func);
         }
-        template<typename T>
-        T doInYieldContext(const function<T()> &func) {
+        template<typename T, typename F>
+        T doInYieldContext(const F &func) {
             return doInsideOfContext<T>((int) NodeFlags::YieldContext, func);
         }
-        template<typename T>
-        T doInDecoratorContext(const function<T()> &func) {
+        template<typename T, typename F>
+        T doInDecoratorContext(const F &func) {
             return doInsideOfContext<T>((int) NodeFlags::DecoratorContext, func);
         }
-        template<typename T>
-        T doInAwaitContext(const function<T()> &func) {
+        template<typename T, typename F>
+        T doInAwaitContext(const F &func) {
             return doInsideOfContext<T>((int) NodeFlags::AwaitContext, func);
         }
-        template<typename T>
-        T doOutsideOfAwaitContext(const function<T()> &func) {
+        template<typename T, typename F>
+        T doOutsideOfAwaitContext(const F &func) {
             return doOutsideOfContext<T>((int) NodeFlags::AwaitContext, func);
         }
-        template<typename T>
-        T doInYieldAndAwaitContext(const function<T()> &func) {
+        template<typename T, typename F>
+        T doInYieldAndAwaitContext(const F &func) {
             return doInsideOfContext<T>((int) NodeFlags::YieldContext | (int) NodeFlags::AwaitContext, func);
         }
-        template<typename T>
-        T doOutsideOfYieldAndAwaitContext(const function<T()> &func) {
+        template<typename T, typename F>
+        T doOutsideOfYieldAndAwaitContext(const F &func) {
             return doOutsideOfContext<T>((int) NodeFlags::YieldContext | (int) NodeFlags::AwaitContext, func);
         }
 
@@ -3224,18 +3279,14 @@ namespace tr {
 
         shared<TemplateSpan> parseTemplateSpan(bool isTaggedTemplate) {
             auto pos = getNodePos();
-            return finishNode(
-                    factory.createTemplateSpan(
-                            allowInAnd<shared<Expression>>(CALLBACK(parseExpression)),
-                            parseLiteralOfTemplateSpan(isTaggedTemplate)
-                    ),
-                    pos
-            );
+            auto expression = allowInAnd<shared<Expression>>(CALLBACK(parseExpression));
+            auto literal = parseLiteralOfTemplateSpan(isTaggedTemplate);
+            return finishNode(factory.createTemplateSpan(expression, literal), pos);
         }
 
         shared<NodeArray> parseTemplateSpans(bool isTaggedTemplate) {
             auto pos = getNodePos();
-            auto list = make_shared<NodeArray>();
+            auto list = factory.make<NodeArray>();
             sharedOpt<TemplateSpan> node;
             do {
                 node = parseTemplateSpan(isTaggedTemplate);
@@ -3255,13 +3306,10 @@ namespace tr {
 
         shared<TemplateExpression> parseTemplateExpression(bool isTaggedTemplate) {
             auto pos = getNodePos();
-            return finishNode(
-                    factory.createTemplateExpression(
-                            parseTemplateHead(isTaggedTemplate),
-                            parseTemplateSpans(isTaggedTemplate)
-                    ),
-                    pos
-            );
+            //arguments are evaluated in unspecified order, so everything that consumes tokens goes into locals first
+            auto head = parseTemplateHead(isTaggedTemplate);
+            auto spans = parseTemplateSpans(isTaggedTemplate);
+            return finishNode(factory.createTemplateExpression(head, spans), pos);
         }
 
         shared<Node> parseEntityName(bool allowReservedWords, const sharedOpt<DiagnosticMessage> &diagnosticMessage = nullptr) {
@@ -3303,13 +3351,9 @@ namespace tr {
 
         shared<TypeReferenceNode> parseTypeReference() {
             auto pos = getNodePos();
-            return finishNode(
-                    factory.createTypeReferenceNode(
-                            parseEntityNameOfTypeReference(),
-                            parseTypeArgumentsOfTypeReference()
-                    ),
-                    pos
-            );
+            auto typeName = parseEntityNameOfTypeReference();
+            auto typeArguments = parseTypeArgumentsOfTypeReference();
+            return finishNode(factory.createTypeReferenceNode(typeName, typeArguments), pos);
         }
 
         // If true, we should abort parsing an error function.
@@ -3649,7 +3693,7 @@ namespace tr {
             sharedOpt<Node> decorator;
             sharedOpt<NodeArray> list;
             while (decorator = tryParseDecorator()) {
-                if (!list) list = make_shared<NodeArray>();
+                if (!list) list = factory.make<NodeArray>();
                 list->push(decorator);
             }
             if (!list) return nullptr;
@@ -3699,7 +3743,7 @@ namespace tr {
             sharedOpt<Node> modifier;
             while ((modifier = tryParseModifier(permitInvalidConstAsModifier, stopOnStartOfClassStaticBlock, hasSeenStatic))) {
                 if (modifier->kind == SyntaxKind::StaticKeyword) hasSeenStatic = true;
-                if (!list) list = make_shared<NodeArray>();
+                if (!list) list = factory.make<NodeArray>();
                 list->push(modifier);
             }
             if (list) return createNodeArray(list, pos);
@@ -3750,11 +3794,12 @@ namespace tr {
             auto decorators = inOuterAwaitContext ? doInAwaitContext<sharedOpt<NodeArray>>(CALLBACK(parseDecorators)) : parseDecorators();
 
             if (token() == SyntaxKind::ThisKeyword) {
+                auto name = createIdentifier(/*isIdentifier*/ true);
                 auto node = factory.createParameterDeclaration(
                         decorators,
                         /*modifiers*/ {},
                         /*dotDotDotToken*/ nullptr,
-                        createIdentifier(/*isIdentifier*/ true),
+                        name,
                         /*questionToken*/ nullptr,
                         parseTypeAnnotation(),
                         /*initializer*/ nullptr
@@ -3777,21 +3822,11 @@ namespace tr {
                 return nullptr;
             }
 
-            auto node = withJSDoc(
-                    finishNode(
-                            factory.createParameterDeclaration(
-                                    decorators,
-                                    modifiers,
-                                    dotDotDotToken,
-                                    parseNameOfParameter(modifiers),
-                                    parseOptionalToken<QuestionToken>(SyntaxKind::QuestionToken),
-                                    parseTypeAnnotation(),
-                                    parseInitializer()
-                            ),
-                            pos
-                    ),
-                    hasJSDoc
-            );
+            auto name = parseNameOfParameter(modifiers);
+            auto questionToken = parseOptionalToken<QuestionToken>(SyntaxKind::QuestionToken);
+            auto type = parseTypeAnnotation();
+            auto initializer = parseInitializer();
+            auto node = withJSDoc(finishNode(factory.createParameterDeclaration(decorators, modifiers, dotDotDotToken, name, questionToken, type, initializer), pos), hasJSDoc);
             topLevel = savedTopLevel;
             return node;
         }
@@ -3868,16 +3903,16 @@ namespace tr {
         shared<LiteralLike> parseLiteralLikeNode(SyntaxKind kind) {
             auto pos = getNodePos();
             shared<LiteralLike> node =
-                    isTemplateLiteralKind(kind) ? factory.createTemplateLiteralLikeNode(kind, scanner.getTokenValue(), getTemplateLiteralRawText(kind), scanner.getTokenFlags() & (int) TokenFlags::TemplateLiteralLikeFlags) :
+                    isTemplateLiteralKind(kind) ? factory.createTemplateLiteralLikeNode(kind, tokenValue(1), getTemplateLiteralRawText(kind), scanner.getTokenFlags() & (int) TokenFlags::TemplateLiteralLikeFlags) :
                     // Octal literals are not allowed in strict mode or ES5
                     // Note that theoretically the following condition would hold true literals like 009,
                     // which is not octal. But because of how the scanner separates the tokens, we would
                     // never get a token like this. Instead, we would get 00 and 9 as two separate tokens.
                     // We also do not need to check for negatives because any prefix operator would be part of a
                     // parent unary expression.
-                    kind == SyntaxKind::NumericLiteral ? factory.createNumericLiteral(scanner.getTokenValue(), scanner.getNumericLiteralFlags()) :
-                    kind == SyntaxKind::StringLiteral ? factory.createStringLiteral(scanner.getTokenValue(), /*isSingleQuote*/ {}, scanner.hasExtendedUnicodeEscape()) :
-                    isLiteralKind(kind) ? factory.createLiteralLikeNode(kind, scanner.getTokenValue()) :
+                    kind == SyntaxKind::NumericLiteral ? factory.createNumericLiteral(tokenValue(), scanner.getNumericLiteralFlags()) :
+                    kind == SyntaxKind::StringLiteral ? factory.createStringLiteral(tokenValue(1), /*isSingleQuote*/ {}, scanner.hasExtendedUnicodeEscape()) :
+                    isLiteralKind(kind) ? factory.createLiteralLikeNode(kind, tokenValue()) :
                     throw runtime_error("Nope");
 
             if (scanner.hasExtendedUnicodeEscape()) {
@@ -3910,18 +3945,14 @@ namespace tr {
             return finishNode(factory.createComputedPropertyName(expression), pos);
         }
 
-        string internPrivateIdentifier(const string &text) {
-            auto privateIdentifier = get(privateIdentifiers, text);
-            if (!privateIdentifier) {
-                privateIdentifier = text;
-                set(privateIdentifiers, text, *privateIdentifier);
-            }
-            return *privateIdentifier;
+        string_view internPrivateIdentifier(string_view text) {
+            //see internIdentifier()
+            return text;
         }
 
         shared<PrivateIdentifier> parsePrivateIdentifier() {
             auto pos = getNodePos();
-            auto node = factory.createPrivateIdentifier(internPrivateIdentifier(scanner.getTokenText()));
+            auto node = factory.createPrivateIdentifier(internPrivateIdentifier(source.substr(scanner.getTokenPos(), scanner.getTextPos() - scanner.getTokenPos())));
             nextToken();
             return finishNode(node, pos);
         }
@@ -4051,7 +4082,7 @@ namespace tr {
                 auto pos = getNodePos();
                 nextToken();
                 auto modifier = finishNode(factory.createToken<AbstractKeyword>(SyntaxKind::AbstractKeyword), pos);
-                auto list = make_shared<NodeArray>();
+                auto list = factory.make<NodeArray>();
                 list->push(modifier);
                 modifiers = createNodeArray(list, pos);
             }
@@ -4147,7 +4178,8 @@ namespace tr {
             return expression;
         }
 
-        shared<NodeArray> parseBracketedList(ParsingContext kind, function<shared<Node>()> parseElement, SyntaxKind open, SyntaxKind close) {
+        template<typename F>
+        shared<NodeArray> parseBracketedList(ParsingContext kind, const F &parseElement, SyntaxKind open, SyntaxKind close) {
             if (parseExpected(open)) {
                 auto result = parseDelimitedList(kind, parseElement);
                 parseExpected(close);
@@ -4194,7 +4226,7 @@ namespace tr {
 
         shared<JsxText> parseJsxText() {
             auto pos = getNodePos();
-            auto node = factory.createJsxText(scanner.getTokenValue(), currentToken == SyntaxKind::JsxTextAllWhiteSpaces);
+            auto node = factory.createJsxText(tokenValue(), currentToken == SyntaxKind::JsxTextAllWhiteSpaces);
             currentToken = scanner.scanJsxToken();
             return finishNode(node, pos);
         }
@@ -4210,8 +4242,8 @@ namespace tr {
                         // We want the error span to cover only 'Foo.Bar' in < Foo.Bar >
                         // or to cover only 'Foo' in < Foo >
                         auto tag = getTagName(openingTag);
-                        auto start = skipTrivia(sourceText, tag->pos);
-                        parseErrorAt(start, tag->end, Diagnostics::JSX_element_0_has_no_corresponding_closing_tag(), getTextOfNodeFromSourceText(sourceText, tag));
+                        auto start = skipTrivia(source, tag->pos);
+                        parseErrorAt(start, tag->end, Diagnostics::JSX_element_0_has_no_corresponding_closing_tag(), getTextOfNodeFromSourceText(source, tag));
                     }
                     return nullptr;
                 case SyntaxKind::LessThanSlashToken:
@@ -4257,7 +4289,7 @@ namespace tr {
         }
 
         shared<NodeArray> parseJsxChildren(shared<NodeUnion(JsxOpeningElement, JsxOpeningFragment)> openingTag) {
-            auto list = make_shared<NodeArray>();
+            auto list = factory.make<NodeArray>();
             auto listPos = getNodePos();
             auto saveParsingContext = parsingContext;
             parsingContext |= 1 << (int) ParsingContext::JsxChildren;
@@ -4339,24 +4371,25 @@ namespace tr {
 
                     auto c = children->slice(0, children->length() - 1);
                     c.push_back(newLast);
-                    children = createNodeArray(make_shared<NodeArray>(c), children->pos, end);
+                    children = createNodeArray(factory.make<NodeArray>(c), children->pos, end);
                     closingElement = jsxElement->closingElement;
                 } else {
                     closingElement = parseJsxClosingElement(opening, inExpressionContext);
                     if (!tagNamesAreEquivalent(getTagName(opening), getTagName(closingElement))) {
                         if (openingTag && isJsxOpeningElement(openingTag) && tagNamesAreEquivalent(getTagName(closingElement), getTagName(openingTag))) {
                             // opening incorrectly matched with its parent's closing -- put error on opening
-                            parseErrorAtRange(getTagName(opening), Diagnostics::JSX_element_0_has_no_corresponding_closing_tag(), getTextOfNodeFromSourceText(sourceText, getTagName(opening)));
+                            parseErrorAtRange(getTagName(opening), Diagnostics::JSX_element_0_has_no_corresponding_closing_tag(), getTextOfNodeFromSourceText(source, getTagName(opening)));
                         } else {
                             // other opening/closing mismatches -- put error on closing
-                            parseErrorAtRange(getTagName(closingElement), Diagnostics::Expected_corresponding_JSX_closing_tag_for_0(), getTextOfNodeFromSourceText(sourceText, getTagName(opening)));
+                            parseErrorAtRange(getTagName(closingElement), Diagnostics::Expected_corresponding_JSX_closing_tag_for_0(), getTextOfNodeFromSourceText(source, getTagName(opening)));
                         }
                     }
                 }
                 result = finishNode(factory.createJsxElement(opening, children, closingElement), pos);
             } else if (_opening->kind == SyntaxKind::JsxOpeningFragment) {
                 auto opening = reinterpret_pointer_cast<JsxOpeningFragment>(_opening);
-                result = finishNode(factory.createJsxFragment(opening, parseJsxChildren(opening), parseJsxClosingFragment(inExpressionContext)), pos);
+                auto children = parseJsxChildren(opening);
+                result = finishNode(factory.createJsxFragment(opening, children, parseJsxClosingFragment(inExpressionContext)), pos);
             } else {
                 assert(_opening->kind == SyntaxKind::JsxSelfClosingElement);
                 // Nothing else to do for self-closing elements
@@ -4416,7 +4449,8 @@ namespace tr {
 
             scanJsxIdentifier();
             auto pos = getNodePos();
-            return finishNode(factory.createJsxAttribute(parseIdentifierName(), parseJsxAttributeValue()), pos);
+            auto name = parseIdentifierName();
+            return finishNode(factory.createJsxAttribute(name, parseJsxAttributeValue()), pos);
         }
 
         shared<JsxAttributes> parseJsxAttributes() {
@@ -4501,7 +4535,7 @@ namespace tr {
             setAwaitContext(!!(flags & (int) SignatureFlags::Await));
 
             sharedOpt<NodeArray> parameters = flags & (int) SignatureFlags::JSDoc ?
-                                              make_shared<NodeArray>() : //we ignore JSDoc, parseDelimitedList(ParsingContext::JSDocParameters, parseJSDocParameter) :
+                                              factory.make<NodeArray>() : //we ignore JSDoc, parseDelimitedList(ParsingContext::JSDocParameters, parseJSDocParameter) :
                                               parseDelimitedList(ParsingContext::Parameters, [this, &allowAmbiguity, savedAwaitContext]()->sharedOpt<Node> { return allowAmbiguity ? parseParameter(savedAwaitContext) : parseParameterForSpeculation(savedAwaitContext); });
 
             setYieldContext(savedYieldContext);
@@ -4594,6 +4628,99 @@ namespace tr {
             }
         }
 
+        //whether a `/` after `previous` is a division, otherwise it starts a regular expression
+        bool canEndExpression(SyntaxKind previous) {
+            switch (previous) {
+                case SyntaxKind::Identifier:
+                case SyntaxKind::PrivateIdentifier:
+                case SyntaxKind::NumericLiteral:
+                case SyntaxKind::BigIntLiteral:
+                case SyntaxKind::StringLiteral:
+                case SyntaxKind::RegularExpressionLiteral:
+                case SyntaxKind::NoSubstitutionTemplateLiteral:
+                case SyntaxKind::TemplateTail:
+                case SyntaxKind::ThisKeyword:
+                case SyntaxKind::SuperKeyword:
+                case SyntaxKind::TrueKeyword:
+                case SyntaxKind::FalseKeyword:
+                case SyntaxKind::NullKeyword:
+                case SyntaxKind::CloseParenToken:
+                case SyntaxKind::CloseBracketToken:
+                case SyntaxKind::CloseBraceToken:
+                case SyntaxKind::PlusPlusToken:
+                case SyntaxKind::MinusMinusToken:
+                    return true;
+                default:
+                    //contextual keywords like `type` or `of` are identifiers in expressions
+                    return previous >= SyntaxKind::FirstContextualKeyword && previous <= SyntaxKind::LastContextualKeyword
+                           && previous != SyntaxKind::AwaitKeyword;
+            }
+        }
+
+        //the end of the `}` matching the already consumed `{`, or -1 if there is none or it can not be found without parsing
+        int scanToMatchingBrace() {
+            vector<int> templates; //brace depths of open template substitutions, their `}` continues the template
+            auto depth = 1;
+            auto previous = SyntaxKind::OpenBraceToken;
+            while (true) {
+                switch (token()) {
+                    case SyntaxKind::EndOfFileToken:
+                        return -1;
+                    case SyntaxKind::OpenBraceToken:
+                        depth++;
+                        break;
+                    case SyntaxKind::CloseBraceToken:
+                        if (!templates.empty() && templates.back() == depth) {
+                            if (reScanTemplateToken(/*isTaggedTemplate*/ false) == SyntaxKind::TemplateTail) templates.pop_back();
+                            break;
+                        }
+                        if (--depth == 0) return scanner.getTextPos();
+                        break;
+                    case SyntaxKind::TemplateHead:
+                        templates.push_back(depth);
+                        break;
+                    case SyntaxKind::SlashToken:
+                    case SyntaxKind::SlashEqualsToken:
+                        //after `)` or `}` it is a division or a regular expression depending on what they close,
+                        //e.g. `(a) / 2` and `if (a) /}/.test(s)`, which only the parser knows
+                        if (previous == SyntaxKind::CloseParenToken || previous == SyntaxKind::CloseBraceToken) return -1;
+                        if (!canEndExpression(previous)) reScanSlashToken();
+                        break;
+                }
+                previous = token();
+                nextToken();
+            }
+        }
+
+        /**
+         * Skips the function body at the current `{` without creating its nodes, see lazyBodies.
+         * Returns nullptr if the body is not terminated or its end is ambiguous (see scanToMatchingBrace()),
+         * it is then parsed as usual.
+         */
+        sharedOpt<Block> skipFunctionBlock() {
+            auto pos = getNodePos();
+            auto hasJSDoc = hasPrecedingJSDocComment();
+            auto multiLine = false;
+            auto end = lookAhead<int>([this, &multiLine] {
+                nextToken();
+                multiLine = scanner.hasPrecedingLineBreak();
+                return scanToMatchingBrace();
+            });
+            if (end < 0) return nullptr;
+
+            scanner.setTextPos(end);
+            nextToken();
+            auto block = factory.createBlock(createNodeArray(factory.make<NodeArray>(), end - 1, end - 1), multiLine);
+            block->lazy = contextFlags;
+            auto result = withJSDoc(finishNode(block, pos), hasJSDoc);
+            //same as parseBlock()
+            if (token() == SyntaxKind::EqualsToken) {
+                parseErrorAtCurrentToken(Diagnostics::Declaration_or_statement_expected_This_follows_a_block_of_statements_so_if_you_intended_to_write_a_destructuring_assignment_you_might_need_to_wrap_the_the_whole_assignment_in_parentheses());
+                nextToken();
+            }
+            return result;
+        }
+
         shared<Block> parseFunctionBlock(int flags, const sharedOpt<DiagnosticMessage> &diagnosticMessage = nullptr) {
             auto savedYieldContext = inYieldContext();
             setYieldContext(!!(flags & (int) SignatureFlags::Yield));
@@ -4611,7 +4738,9 @@ namespace tr {
                 setDecoratorContext(/*val*/ false);
             }
 
-            auto block = parseBlock(!!(flags & (int) SignatureFlags::IgnoreMissingOpenBrace), diagnosticMessage);
+            sharedOpt<Block> block;
+            if (lazyBodies && token() == SyntaxKind::OpenBraceToken && languageVariant != LanguageVariant::JSX) block = skipFunctionBlock();
+            if (!block) block = parseBlock(!!(flags & (int) SignatureFlags::IgnoreMissingOpenBrace), diagnosticMessage);
 
             if (saveDecoratorContext) {
                 setDecoratorContext(/*val*/ true);
@@ -4952,7 +5081,7 @@ namespace tr {
                 node = n;
             }
             // Decorators, Modifiers, questionToken, and exclamationToken are not supported by property assignments and are reported in the grammar checker
-            node->decorators = decorators;
+            node->setDecorators(decorators);
             node->modifiers = modifiers;
             return withJSDoc(finishNode(node, pos), hasJSDoc);
         }
@@ -5510,7 +5639,8 @@ namespace tr {
                     }
                 } else {
 
-                    leftOperand = makeBinaryExpression(leftOperand, parseTokenNode<Node>(), parseBinaryExpressionOrHigher(newPrecedence), pos);
+                    auto operatorToken = parseTokenNode<Node>();
+                    leftOperand = makeBinaryExpression(leftOperand, operatorToken, parseBinaryExpressionOrHigher(newPrecedence), pos);
                 }
             }
 
@@ -5679,7 +5809,7 @@ namespace tr {
             auto unaryOperator = token();
             auto simpleUnaryExpression = parseSimpleUnaryExpression();
             if (token() == SyntaxKind::AsteriskAsteriskToken) {
-                auto pos = skipTrivia(sourceText, simpleUnaryExpression->pos);
+                auto pos = skipTrivia(source, simpleUnaryExpression->pos);
                 auto end = simpleUnaryExpression->end;
                 if (simpleUnaryExpression->kind == SyntaxKind::TypeAssertionExpression) {
                     parseErrorAt(pos, end, Diagnostics::A_type_assertion_expression_is_not_allowed_in_the_left_hand_side_of_an_exponentiation_expression_Consider_enclosing_the_expression_in_parentheses());
@@ -5989,18 +6119,14 @@ namespace tr {
 
         shared<TemplateLiteralTypeSpan> parseTemplateTypeSpan() {
             auto pos = getNodePos();
-            return finishNode(
-                    factory.createTemplateLiteralTypeSpan(
-                            parseType(),
-                            parseLiteralOfTemplateSpan(/*isTaggedTemplate*/ false)
-                    ),
-                    pos
-            );
+            auto type = parseType();
+            auto literal = parseLiteralOfTemplateSpan(/*isTaggedTemplate*/ false);
+            return finishNode(factory.createTemplateLiteralTypeSpan(type, literal), pos);
         }
 
         shared<NodeArray> parseTemplateTypeSpans() {
             auto pos = getNodePos();
-            auto list = make_shared<NodeArray>();
+            auto list = factory.make<NodeArray>();
             shared<TemplateLiteralTypeSpan> node;
             do {
                 node = parseTemplateTypeSpan();
@@ -6011,13 +6137,9 @@ namespace tr {
 
         shared<TemplateLiteralTypeNode> parseTemplateType() {
             auto pos = getNodePos();
-            return finishNode(
-                    factory.createTemplateLiteralType(
-                            parseTemplateHead(/*isTaggedTemplate*/ false),
-                            parseTemplateTypeSpans()
-                    ),
-                    pos
-            );
+            auto head = parseTemplateHead(/*isTaggedTemplate*/ false);
+            auto spans = parseTemplateTypeSpans();
+            return finishNode(factory.createTemplateLiteralType(head, spans), pos);
         }
 
         shared<TypeNode> parseNonArrayType() {
@@ -6170,17 +6292,19 @@ namespace tr {
             return nullptr;
         }
 
+        template<typename ParseConstituentType, typename CreateTypeNode>
         shared<TypeNode> parseUnionOrIntersectionType(
                 SyntaxKind operatorKind,
-                function<shared<TypeNode>()> parseConstituentType,
-                function<shared<TypeNode>(shared<NodeArray>)> createTypeNode //: (types: NodeArray<TypeNode>) => UnionOrIntersectionTypeNode
+                const ParseConstituentType &parseConstituentType,
+                const CreateTypeNode &createTypeNode //: (types: NodeArray<TypeNode>) => UnionOrIntersectionTypeNode
         ) {
             auto pos = getNodePos();
             auto isUnionType = operatorKind == SyntaxKind::BarToken;
             auto hasLeadingOperator = parseOptional(operatorKind);
-            sharedOpt<TypeNode> type = hasLeadingOperator ? parseFunctionOrConstructorTypeToError(isUnionType) : parseConstituentType();
+            sharedOpt<TypeNode> type = hasLeadingOperator ? parseFunctionOrConstructorTypeToError(isUnionType) : nullptr;
+            if (!type) type = parseConstituentType();
             if (token() == operatorKind || hasLeadingOperator) {
-                auto types = make_shared<NodeArray>(type);
+                auto types = factory.make<NodeArray>(type);
                 while (parseOptional(operatorKind)) {
                     if (auto a = parseFunctionOrConstructorTypeToError(isUnionType)) {
                         types->push(a);
@@ -6376,13 +6500,9 @@ namespace tr {
 
             if (!scanner.hasPrecedingLineBreak() &&
                 (token() == SyntaxKind::AsteriskToken || isStartOfExpression())) {
-                return finishNode(
-                        factory.createYieldExpression(
-                                parseOptionalToken<AsteriskToken>(SyntaxKind::AsteriskToken),
-                                parseAssignmentExpressionOrHigher()
-                        ),
-                        pos
-                );
+                auto asteriskToken = parseOptionalToken<AsteriskToken>(SyntaxKind::AsteriskToken);
+                auto expression = parseAssignmentExpressionOrHigher();
+                return finishNode(factory.createYieldExpression(asteriskToken, expression), pos);
             } else {
                 // if the next token is not on the same line as yield.  or we don't have an '*' or
                 // the start of an expression, then this is just a simple "yield" expression.
@@ -6540,7 +6660,7 @@ namespace tr {
                 auto pos = getNodePos();
                 nextToken();
                 auto modifier = finishNode(factory.createToken<AsyncKeyword>(SyntaxKind::AsyncKeyword), pos);
-                auto list = make_shared<NodeArray>();
+                auto list = factory.make<NodeArray>();
                 list->push(modifier);
                 return factory.createNodeArray(list, pos);
             }
@@ -6723,7 +6843,7 @@ namespace tr {
             );
             finishNode(parameter, identifier->pos);
 
-            auto parameters = createNodeArray(make_shared<NodeArray>(parameter), parameter->pos, parameter->end);
+            auto parameters = createNodeArray(factory.make<NodeArray>(parameter), parameter->pos, parameter->end);
 
             auto equalsGreaterThanToken = parseExpectedToken<EqualsGreaterThanToken>(SyntaxKind::EqualsGreaterThanToken);
             auto body = parseArrowFunctionExpressionBody(/*isAsync*/ !!asyncModifier);
@@ -6755,19 +6875,12 @@ namespace tr {
 
             // Note: we explicitly 'allowIn' in the whenTrue part of the condition expression, and
             // we do not that for the 'whenFalse' part.
-            sharedOpt<ColonToken> colonToken;
-            return finishNode(
-                    factory.createConditionalExpression(
-                            leftOperand,
-                            questionToken,
-                            doOutsideOfContext<shared<Expression>>(disallowInAndDecoratorContext, CALLBACK(parseAssignmentExpressionOrHigher)),
-                            colonToken = parseExpectedToken<ColonToken>(SyntaxKind::ColonToken),
-                            nodeIsPresent(colonToken)
-                            ? parseAssignmentExpressionOrHigher()
-                            : createMissingNode<Identifier>(SyntaxKind::Identifier, /*reportAtCurrentPosition*/ false, Diagnostics::_0_expected(), tokenToString(SyntaxKind::ColonToken))
-                    ),
-                    pos
-            );
+            auto whenTrue = doOutsideOfContext<shared<Expression>>(disallowInAndDecoratorContext, CALLBACK(parseAssignmentExpressionOrHigher));
+            auto colonToken = parseExpectedToken<ColonToken>(SyntaxKind::ColonToken);
+            auto whenFalse = nodeIsPresent(colonToken)
+                             ? parseAssignmentExpressionOrHigher()
+                             : createMissingNode<Identifier>(SyntaxKind::Identifier, /*reportAtCurrentPosition*/ false, Diagnostics::_0_expected(), tokenToString(SyntaxKind::ColonToken));
+            return finishNode(factory.createConditionalExpression(leftOperand, questionToken, whenTrue, colonToken, whenFalse), pos);
         }
 
         shared<Expression> parseAssignmentExpressionOrHigher() {
@@ -6799,8 +6912,13 @@ namespace tr {
             // If we do successfully parse arrow-function, we must *not* recurse for productions 1, 2 or 3. An ArrowFunction is
             // not a LeftHandSideExpression, nor does it start a ConditionalExpression.  So we are done
             // with AssignmentExpression if we see one.
-            if (auto a = tryParseParenthesizedArrowFunctionExpression()) return a;
-            if (auto a = tryParseAsyncSimpleArrowFunctionExpression()) return a;
+            //
+            // Declaration files have no function expressions, their expressions are literals, entity names and
+            // constant enum expressions. So no arrow function is speculatively parsed there.
+            if (!declarationFile) {
+                if (auto a = tryParseParenthesizedArrowFunctionExpression()) return a;
+                if (auto a = tryParseAsyncSimpleArrowFunctionExpression()) return a;
+            }
 
             // Now try to see if we're in production '1', '2' or '3'.  A conditional expression can
             // start with a LogicalOrExpression, while the assignment productions can only start with
@@ -6828,7 +6946,8 @@ namespace tr {
             // Note: we call reScanGreaterToken so that we get an appropriately merged token
             // for cases like `> > =` becoming `>>=`
             if (isLeftHandSideExpression(expr) && isAssignmentOperator(reScanGreaterToken())) {
-                return makeBinaryExpression(expr, parseTokenNode<Expression>(), parseAssignmentExpressionOrHigher(), pos);
+                auto operatorToken = parseTokenNode<Expression>();
+                return makeBinaryExpression(expr, operatorToken, parseAssignmentExpressionOrHigher(), pos);
             }
 
             // It wasn't an assignment or a lambda.  This is a conditional expression:
@@ -7178,7 +7297,7 @@ namespace tr {
             parseSemicolon();
             auto node = factory.createVariableStatement(modifiers, declarationList);
             // Decorators are not allowed on a variable statement, so we keep track of them to report them in the grammar checker.
-            node->decorators = decorators;
+            node->setDecorators(decorators);
             return withJSDoc(finishNode(node, pos), hasJSDoc);
         }
 
@@ -7383,6 +7502,7 @@ namespace tr {
         shared<SourceFile> parseSourceFileWorker(ScriptTarget languageVersion, bool setParentNodes, ScriptKind scriptKind, function<void(shared<SourceFile>)> setExternalModuleIndicator) {
             ZoneScoped;
             auto isDeclarationFile = isDeclarationFileName(fileName);
+            declarationFile = isDeclarationFile;
             if (isDeclarationFile) {
                 contextFlags |= (int) NodeFlags::Ambient;
             }
@@ -7409,7 +7529,7 @@ namespace tr {
 //            sourceFile.nodeCount = nodeCount;
 //            sourceFile.identifierCount = identifierCount;
 //            sourceFile.identifiers = identifiers;
-//            sourceFile.parseDiagnostics = attachFileToDiagnostics(parseDiagnostics, sourceFile);
+            sourceFile->parseDiagnostics = std::move(parseDiagnostics);
 //            if (jsDocDiagnostics) {
 //                sourceFile.jsDocDiagnostics = attachFileToDiagnostics(jsDocDiagnostics, sourceFile);
 //            }
@@ -8882,7 +9002,8 @@ namespace tr {
 //            }
 //        }
 
-        shared<SourceFile> parseSourceFile(const string &fileName, const string &sourceText, ScriptTarget languageVersion, bool setParentNodes, optional<ScriptKind> _scriptKind, optional<function<void(shared<SourceFile>)>> setExternalModuleIndicatorOverride) {
+        //`textOwner` keeps `sourceText` alive instead of copying it, see initializeState() and parseFile()
+        shared<SourceFile> parseSourceFile(const string &fileName, string_view sourceText, ScriptTarget languageVersion, bool setParentNodes, optional<ScriptKind> _scriptKind, optional<function<void(shared<SourceFile>)>> setExternalModuleIndicatorOverride, std::shared_ptr<void> textOwner = nullptr) {
             ZoneScoped;
             auto scriptKind = ensureScriptKind(fileName, _scriptKind);
 
@@ -8898,7 +9019,7 @@ namespace tr {
             //                return result;
             //            }
 
-            initializeState(fileName, sourceText, languageVersion, scriptKind);
+            initializeState(fileName, sourceText, languageVersion, scriptKind, nullptr, std::move(textOwner));
 
             auto result = parseSourceFileWorker(languageVersion, setParentNodes, scriptKind, setExternalModuleIndicatorOverride ? *setExternalModuleIndicatorOverride : setExternalModuleIndicator);
 
@@ -8906,6 +9027,152 @@ namespace tr {
 
             return result;
         }
+
+        /**
+         * Parses the file at `path` from a read-only memory mapping (see fileMap()) instead of reading it into a string.
+         * The text is not copied: the SourceFile keeps the mapping alive and its text, identifiers and literals are
+         * views into it. The file must not be truncated while the SourceFile lives.
+         */
+        shared<SourceFile> parseFile(const string &path, ScriptTarget languageVersion = ScriptTarget::Latest, bool setParentNodes = false, optional<ScriptKind> scriptKind = {}) {
+            auto mapped = fileMap(path);
+            auto text = mapped->view();
+            return parseSourceFile(path, text, languageVersion, setParentNodes, scriptKind, {}, std::move(mapped));
+        }
+
+        void checkChangeRange(const shared<SourceFile> &sourceFile, const string &newText, const TextChangeRange &textChangeRange, bool aggressiveChecks) {
+            auto oldText = sourceFile->text;
+            if (oldText.size() - textChangeRange.span.length + textChangeRange.newLength != newText.size()) {
+                throw runtime_error(fmt::format("Change range does not match the new text of {}", sourceFile->fileName));
+            }
+
+            if (aggressiveChecks) {
+                auto text = string_view(newText);
+                Debug::asserts(oldText.substr(0, textChangeRange.span.start) == text.substr(0, textChangeRange.span.start));
+                Debug::asserts(oldText.substr(textSpanEnd(textChangeRange.span)) == text.substr(textSpanEnd(textChangeRangeNewSpan(textChangeRange))));
+            }
+        }
+
+        /**
+         * Produces a new SourceFile for `newText`, reusing all nodes of `sourceFile` the edit did not affect.
+         * `textChangeRange` is the span of the old text that was replaced and the length of its replacement.
+         * The result is the same as parseSourceFile() of `newText`.
+         *
+         * Note: this moves the nodes of `sourceFile` in place to their new positions and into the new tree,
+         * so the old SourceFile must not be used afterwards. Its other nodes and its atoms are released, only
+         * its arena stays alive with the new one, since the reused nodes (and their texts) live in it. So that
+         * an editor session does not keep every version's arena, after maxGenerations edits the text is
+         * parsed fully again.
+         */
+        shared<SourceFile> updateSourceFile(const shared<SourceFile> &sourceFile, const string &newText, const TextChangeRange &textChangeRange, bool aggressiveChecks = false) {
+            ZoneScoped;
+            checkChangeRange(sourceFile, newText, textChangeRange, aggressiveChecks);
+            if (textChangeRangeIsUnchanged(textChangeRange)) {
+                // if the text didn't change, then we can just return our current source file as-is.
+                return sourceFile;
+            }
+
+            if (sourceFile->statements->empty() || sourceFile->arena->generation >= maxGenerations) {
+                // If we don't have any statements in the current source file, then there's no real
+                // way to incrementally parse.  So just do a full parse instead. The same once the arenas
+                // of maxGenerations previous versions are kept alive.
+                return parseSourceFile(sourceFile->fileName, newText, sourceFile->languageVersion, true, sourceFile->scriptKind, sourceFile->setExternalModuleIndicator);
+            }
+
+            // Make sure we're not trying to incrementally update a source file more than once.  Once
+            // we do an update the original source file is considered unusable from that point onwards.
+            if (sourceFile->hasBeenIncrementallyParsed) throw runtime_error(fmt::format("{} was already incrementally parsed", sourceFile->fileName));
+            sourceFile->hasBeenIncrementallyParsed = true;
+
+            SyntaxCursor cursor(sourceFile);
+
+            // Make the actual change larger so that we know to reparse anything whose lookahead
+            // might have intersected the change.
+            auto changeRange = extendToAffectedRange(sourceFile, textChangeRange);
+            checkChangeRange(sourceFile, newText, changeRange, aggressiveChecks);
+
+            // The is the amount the nodes after the edit range need to be adjusted.  It can be
+            // positive (if the edit added characters), negative (if the edit deleted characters)
+            // or zero (if this was a pure overwrite with nothing added/removed).
+            auto delta = changeRange.newLength - changeRange.span.length;
+
+            // Move all nodes after the edit, so the ones we want to reuse are already at the right position in the
+            // new text, and mark the ones intersecting the change, which can not be reused.
+            cursor.markChange(changeRange.span.start, textSpanEnd(changeRange.span), textSpanEnd(textChangeRangeNewSpan(changeRange)), delta);
+
+            auto scriptKind = sourceFile->scriptKind;
+            initializeState(sourceFile->fileName, newText, sourceFile->languageVersion, scriptKind);
+            syntaxCursor = &cursor;
+            factory.arena->retain(sourceFile->arena);
+            factory.arena->generation = sourceFile->arena->generation + 1;
+            //reused identifiers keep their atoms, the old file is not used anymore
+            identifiers = std::move(sourceFile->atoms);
+
+            auto result = parseSourceFileWorker(sourceFile->languageVersion, true, scriptKind, sourceFile->setExternalModuleIndicator ? *sourceFile->setExternalModuleIndicator : setExternalModuleIndicator);
+
+            clearState();
+            //the nodes that were not reused
+            sourceFile->releaseStatements();
+
+            //reused subtrees are not finished again, at most as high as the old tree
+            result->nestingDepth += sourceFile->nestingDepth;
+            result->flags |= sourceFile->flags & (int) NodeFlags::PermanentlySetIncrementalFlags;
+            result->impliedNodeFormat = sourceFile->impliedNodeFormat;
+            return result;
+        }
+
+        /**
+         * Parses the statements of `body`, a function body of `sourceFile` skipped with lazyBodies, into it.
+         * The nodes go into the arena of the file and identifiers into its atoms, so the body is the same as
+         * without lazyBodies. Bodies nested in it are skipped again if lazyBodies is set.
+         *
+         * The state stays set up for the file, so parsing many of its bodies sets it up only once.
+         */
+        void parseLazyBody(const shared<SourceFile> &sourceFile, const shared<Block> &body) {
+            ZoneScoped;
+            if (!body->lazy) return;
+
+            if (lazyFile.lock() != sourceFile) {
+                initializeState(sourceFile->fileName, sourceFile->text, sourceFile->languageVersion, sourceFile->scriptKind, sourceFile);
+                lazyFile = sourceFile;
+                declarationFile = sourceFile->isDeclarationFile;
+            }
+            parseDiagnostics.clear();
+            parsingContext = 0;
+            notParenthesizedArrow.clear();
+            parseErrorBeforeNextFinishedNode = false;
+            topLevel = false;
+            openSubtrees.clear();
+            nestingDepth = 0;
+            contextFlags = *body->lazy;
+            identifiers = std::move(sourceFile->atoms);
+
+            sharedOpt<Block> block;
+            try {
+                scanner.setTextPos(body->pos);
+                nextToken();
+                block = parseBlock(/*ignoreMissingOpenBrace*/ false);
+            } catch (...) {
+                sourceFile->atoms = std::move(identifiers);
+                throw;
+            }
+            sourceFile->atoms = std::move(identifiers);
+            identifiers.clear();
+
+            if (block->end != body->end) {
+                throw runtime_error(fmt::format("Lazy body at {} of {} ends at {}, but was skipped to {}", body->pos, sourceFile->fileName, block->end, body->end));
+            }
+            //the diagnostics of the file are in source order and the ones of the body all lie within it
+            auto &diagnostics = sourceFile->parseDiagnostics;
+            auto at = std::upper_bound(diagnostics.begin(), diagnostics.end(), body->pos, [](int pos, auto &diagnostic) { return pos < diagnostic.start; });
+            diagnostics.insert(at, parseDiagnostics.begin(), parseDiagnostics.end());
+            //the body is at most as deep in the file as the file is high
+            sourceFile->nestingDepth += nestingDepth;
+            body->statements = block->statements;
+            body->multiLine = block->multiLine;
+            body->flags = block->flags;
+            body->transformFlags = block->transformFlags;
+            body->lazy.reset();
+        }
     };
 //
 //        export function parseIsolatedEntityName(content: string, languageVersion: ScriptTarget): EntityName | undefined {
@@ -9872,7 +10139,7 @@ namespace tr {
 
     inline shared<SourceFile> createSourceFile(
             string fileName,
-            string sourceText,
+            string_view sourceText,
             variant<ScriptTarget, CreateSourceFileOptions> languageVersionOrOptions,
             bool setParentNodes = false,
             optional<ScriptKind> scriptKind = {}
@@ -2,6 +2,7 @@
 #include <regex>
 #include "scanner.h"
 #include "utf.h"
+#include "ascii.h"
 #include "core.h"
 #include "utilities.h"
 #include "diagnostic_messages.h"
@@ -16,7 +17,7 @@ namespace tr {
     using tr::utf::fromCharCode;
     using namespace tr::hash;
 
-    bool isShebangTrivia(const string &text, int pos) {
+    bool isShebangTrivia(string_view text, int pos) {
         // Shebangs check must only be done at the start of the file
         //    Debug.assert(pos == 0);
         //    return shebangTriviaRegex.test(text);
@@ -31,6 +32,11 @@ namespace tr {
         string result;
         auto start = pos;
         while (true) {
+            if (quote.code == CharacterCodes::doubleQuote) {
+                pos = utf::skipAsciiUntil<'"', '\\', '\n', '\r'>(text, pos, end);
+            } else if (quote.code == CharacterCodes::singleQuote) {
+                pos = utf::skipAsciiUntil<'\'', '\\', '\n', '\r'>(text, pos, end);
+            }
             if (pos >= end) {
                 result += substring(text, start, pos);
                 tokenFlags |= TokenFlags::Unterminated;
@@ -402,7 +408,7 @@ namespace tr {
 // a <<<<<<< or >>>>>>> marker then it is also followed by a space.
     const unsigned long mergeConflictMarkerLength = size("<<<<<<<") - 1;
 
-    bool isConflictMarkerTrivia(const string &text, int pos) {
+    bool isConflictMarkerTrivia(string_view text, int pos) {
         ZoneScoped;
         assert(pos >= 0);
 
@@ -424,7 +430,7 @@ namespace tr {
         return false;
     }
 
-    int Scanner::error(const shared<DiagnosticMessage> &message, int errPos, int length) {
+    void Scanner::error(const shared<DiagnosticMessage> &message, int errPos, int length) {
         if (errPos == -1) errPos = pos;
 
         cout << "Error: " << message->code << ": " << message->message << " at " << errPos << "\n";
@@ -434,7 +440,7 @@ namespace tr {
         }
     }
 
-    int scanConflictMarkerTrivia(string &text, int pos) {
+    int scanConflictMarkerTrivia(string_view text, int pos) {
         ZoneScoped;
         auto ch = charCodeAt(text, pos);
         auto len = text.size();
@@ -460,7 +466,7 @@ namespace tr {
         return pos;
     }
 
-    int Scanner::scanConflictMarkerTrivia(string &text, int pos) {
+    int Scanner::scanConflictMarkerTrivia(string_view text, int pos) {
         error(Diagnostics::Merge_conflict_marker_encountered(), pos, mergeConflictMarkerLength);
         return scanConflictMarkerTrivia(text, pos);
     }
@@ -541,16 +547,16 @@ namespace tr {
 
     const regex shebangTriviaRegex("^#!.*");
 
-    int scanShebangTrivia(const string &text, int pos) {
-        smatch m;
-        if (regex_search(text, m, shebangTriviaRegex)) {
+    int scanShebangTrivia(string_view text, int pos) {
+        std::cmatch m;
+        if (regex_search(text.data(), text.data() + text.size(), m, shebangTriviaRegex)) {
             pos = pos + m[1].length();
         }
         return pos;
     }
 
     /* @internal */
-    int skipTrivia(string &text, int pos, optional<bool> stopAfterLineBreak, optional<bool> stopAtComments, optional<bool> inJSDoc) {
+    int skipTrivia(string_view text, int pos, optional<bool> stopAfterLineBreak, optional<bool> stopAtComments, optional<bool> inJSDoc) {
         ZoneScoped;
         if (positionIsSynthesized(pos)) {
             return pos;
@@ -938,7 +944,7 @@ namespace tr {
             checkForIdentifierStartAfterNumericLiteral(start, !decimalFragmentSet && !!(tokenFlags & TokenFlags::Scientific));
             return {
                     .type =  SyntaxKind::NumericLiteral,
-                    .value =  "" + stoi(result) // if value is not an integer, it can be safely coerced to a number
+                    .value =  fmt::format("{}", std::stod(result)) // if value is not an integer, it can be safely coerced to a number
             };
         } else {
             tokenValue = result;
@@ -1170,6 +1176,7 @@ namespace tr {
         auto ch = startCharacter;
         if (isIdentifierStart(ch, languageVersion)) {
             pos += ch.length;
+            pos = utf::skipAsciiIdentifierPart(text, pos, end);
             while (pos < end && isIdentifierPart(ch = charCodeAt(text, pos), languageVersion)) pos += ch.length;
             tokenValue = substring(text, tokenPos, pos);
             if (ch.code == CharacterCodes::backslash) {
@@ -1185,6 +1192,7 @@ namespace tr {
         startPos = pos;
         tokenFlags = TokenFlags::None;
         bool asteriskSeen = false;
+        bool lineBreak = false; //set by skipAsciiWhitespace()
 
         while (true) {
             tokenPos = pos;
@@ -1210,7 +1218,7 @@ namespace tr {
                 case CharacterCodes::carriageReturn:
                     tokenFlags |= TokenFlags::PrecedingLineBreak;
                     if (skipTrivia) {
-                        pos++;
+                        pos = utf::skipAsciiWhitespace(text, pos, end, &lineBreak);
                         continue;
                     } else {
                         if (ch.code == CharacterCodes::carriageReturn && pos + 1 < end &&
@@ -1247,9 +1255,15 @@ namespace tr {
                 case CharacterCodes::ideographicSpace:
                 case CharacterCodes::byteOrderMark:
                     if (skipTrivia) {
-                        pos++;
+                        if (ch.length == 1) {
+                            pos = utf::skipAsciiWhitespace(text, pos, end, &lineBreak);
+                            if (lineBreak) tokenFlags |= TokenFlags::PrecedingLineBreak;
+                        } else {
+                            pos++;
+                        }
                         continue;
                     } else {
+                        pos = utf::skipAsciiWhitespace(text, pos, end);
                         int size;
                         while (pos < end && isWhiteSpaceSingleLine(charCodeAt(text, pos, &size))) {
                             pos += size;
@@ -1348,6 +1362,7 @@ namespace tr {
                     if (charCodeAt(text, pos + 1).code == CharacterCodes::slash) {
                         pos += 2;
 
+                        pos = utf::skipAsciiUntil<'\n', '\r'>(text, pos, end);
                         while (pos < end) {
                             if (isLineBreak(charCodeAt(text, pos))) {
                                 break;
@@ -1378,6 +1393,8 @@ namespace tr {
                         auto commentClosed = false;
                         auto lastLineStart = tokenPos;
                         while (pos < end) {
+                            pos = utf::skipAsciiUntil<'*', '\n', '\r'>(text, pos, end);
+                            if (pos >= end) break;
                             auto ch = charCodeAt(text, pos);
 
                             if (ch.code == CharacterCodes::asterisk && charCodeAt(text, pos + 1).code == CharacterCodes::slash) {
@@ -1620,7 +1637,7 @@ namespace tr {
                     return token = SyntaxKind::Unknown;
                 }
                 case CharacterCodes::hash:
-                    if (pos != 0 && text[pos + 1] == '!') {
+                    if (pos != 0 && charCodeAt(text, pos + 1).code == CharacterCodes::exclamation) {
                         error(Diagnostics::can_only_be_used_at_the_start_of_a_file());
                         pos++;
                         return token = SyntaxKind::Unknown;
@@ -24,7 +24,7 @@ namespace tr {
                  int length
             )>;
 
-    int skipTrivia(string &text, int pos, optional<bool> stopAfterLineBreak = {}, optional<bool> stopAtComments = {}, optional<bool> inJSDoc = {});
+    int skipTrivia(string_view text, int pos, optional<bool> stopAfterLineBreak = {}, optional<bool> stopAtComments = {}, optional<bool> inJSDoc = {});
 
     /** @internal */
     inline auto &textToKeywordObj() {
@@ -420,7 +420,8 @@ namespace tr {
 
     class Scanner {
     public:
-        string text;
+        //not owned, the caller keeps the text alive while scanning (the parser scans the text of its SourceFile)
+        string_view text;
 
         // Current position (end position of text of current token)
         int pos{};
@@ -450,10 +451,16 @@ namespace tr {
 
         optional<ErrorCallback> onError;
 
-        explicit Scanner(const string &text): text(text) {
+        explicit Scanner(string_view text): text(text) {
             end = text.size();
         }
 
+        explicit Scanner(const char *text): Scanner(string_view(text)) {
+        }
+
+        //text is only viewed, a temporary string would dangle
+        explicit Scanner(string &&text) = delete;
+
         explicit Scanner(ScriptTarget languageVersion, bool skipTrivia): languageVersion(languageVersion), skipTrivia(skipTrivia) {
         }
 
@@ -480,12 +487,18 @@ namespace tr {
             onError = errorCallback;
         }
 
-        void setText(string newText = "", int start = 0, int length = -1) {
+        void setText(string_view newText = {}, int start = 0, int length = -1) {
             text = newText;
             end = length == -1 ? text.size() : start + length;
             setTextPos(start);
         }
 
+        void setText(const char *newText, int start = 0, int length = -1) {
+            setText(string_view(newText), start, length);
+        }
+
+        void setText(string &&newText, int start = 0, int length = -1) = delete;
+
         void setScriptTarget(ScriptTarget scriptTarget) {
             languageVersion = scriptTarget;
         }
@@ -508,7 +521,7 @@ namespace tr {
             return false;
         }
 
-        string getTokenValue() {
+        const string &getTokenValue() {
             return tokenValue;
         }
 
@@ -524,20 +537,20 @@ namespace tr {
             return startPos;
         }
 
-        template<typename T>
-        T lookAhead(const function<T()> &callback) {
+        template<typename T, typename F>
+        T lookAhead(const F &callback) {
             ZoneScoped;
             return speculationHelper<T>(callback, /*isLookahead*/ true);
         }
 
-        template<typename T>
-        T tryScan(const function<T()> &callback) {
+        template<typename T, typename F>
+        T tryScan(const F &callback) {
             ZoneScoped;
             return speculationHelper<T>(callback, /*isLookahead*/ false);
         }
 
-        template<typename T>
-        T speculationHelper(const function<T()> &callback, bool isLookahead) {
+        template<typename T, typename F>
+        T speculationHelper(const F &callback, bool isLookahead) {
             ZoneScoped;
             const auto savePos = pos;
             const auto saveStartPos = startPos;
@@ -668,13 +681,13 @@ namespace tr {
 
         bool isOctalDigit(const CharCode &code);
 
-        int error(const shared<DiagnosticMessage> &message, int errPos = -1, int length = -1);
+        void error(const shared<DiagnosticMessage> &message, int errPos = -1, int length = -1);
 
         vector<CommentDirective> appendIfCommentDirective(vector<CommentDirective> &commentDirectives, const string &text, const regex &commentDirectiveRegEx, int lineStart);
 
         int scanOctalDigits();
 
-        int scanConflictMarkerTrivia(string &text, int pos);
+        int scanConflictMarkerTrivia(string_view text, int pos);
 
         SyntaxKind getIdentifierToken();
     };
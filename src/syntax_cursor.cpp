@@ -1,27 +1,275 @@
 #include "syntax_cursor.h"
+#include "parser2.h"
 
 using namespace tr;
 
-Node SyntaxCursor::currentNode(int position) {
+namespace {
+    //TypeScript stops forEachChild when a visitor returns true. Our forEachChild visits all children, so the
+    //visitors below set `done` instead and ignore the remaining siblings.
+
+    struct ListElementFinder {
+        int position;
+        bool done = false;
+        NodeArray *array = nullptr;
+        int index = InvalidPosition::Value;
+        sharedOpt<Node> found;
+
+        void visitChildren(const shared<Node> &node) {
+            forEachChild(node, [this](const shared<Node> &child) -> sharedOpt<Node> {
+                visitNode(child);
+                return nullptr;
+            }, [this](const shared<NodeArray> &children) -> sharedOpt<Node> {
+                visitArray(children);
+                return nullptr;
+            });
+        }
+
+        void visitNode(const shared<Node> &node) {
+            if (done) return;
+            if (position >= node->pos && position < node->end) {
+                // Position was within this node.  Keep searching deeper to find the node.
+                visitChildren(node);
+                // don't proceed any further in the search.
+                done = true;
+            }
+        }
+
+        void visitArray(const shared<NodeArray> &children) {
+            if (done) return;
+            if (position >= children->pos && position < children->end) {
+                // position was in this array.  Search through this array to see if we find a
+                // viable element.
+                for (int i = 0; i < children->list.size(); i++) {
+                    auto &child = children->list[i];
+                    if (!child) continue;
+                    if (child->pos == position) {
+                        // Found the right node.  We're done.
+                        array = children.get();
+                        index = i;
+                        found = child;
+                        done = true;
+                        return;
+                    }
+                    if (child->pos < position && position < child->end) {
+                        // Position in somewhere within this child.  Search in it and
+                        // stop searching in this array.
+                        visitChildren(child);
+                        done = true;
+                        return;
+                    }
+                }
+            }
+        }
+    };
+
+    struct ChangeMarker {
+        int changeStart;
+        int changeRangeOldEnd;
+        int changeRangeNewEnd;
+        int delta;
+        std::unordered_set<Node *> &intersecting;
+
+        void moveNode(const shared<Node> &node) {
+            //synthesized, has no position in the text
+            if (node->pos < 0) return;
+            node->pos += delta;
+            node->end += delta;
+            forEachChild(node, [this](const shared<Node> &child) -> sharedOpt<Node> {
+                moveNode(child);
+                return nullptr;
+            }, [this](const shared<NodeArray> &children) -> sharedOpt<Node> {
+                moveArray(children);
+                return nullptr;
+            });
+        }
+
+        void moveArray(const shared<NodeArray> &children) {
+            //some lists are created without a position (e.g. the types of a union), their elements have one
+            if (children->pos >= 0) {
+                children->pos += delta;
+                children->end += delta;
+            }
+            for (auto &&node: children->list) moveNode(node);
+        }
+
+        template<typename T>
+        void adjustIntersectingElement(T &element) {
+            Debug::asserts(element.end >= changeStart, "Adjusting an element that was entirely before the change range");
+            Debug::asserts(element.pos <= changeRangeOldEnd, "Adjusting an element that was entirely after the change range");
+
+            // The element keeps its position if possible, or moves backward to the new end if it started in
+            // the deleted part of the change.
+            auto pos = std::min(element.pos, changeRangeNewEnd);
+
+            // If the end is after the change range, then we always adjust it by the delta amount.
+            // If it is in the change range, it keeps its end if possible, or moves backward to the new end.
+            auto end = element.end >= changeRangeOldEnd ? element.end + delta : std::min(element.end, changeRangeNewEnd);
+
+            Debug::asserts(pos <= end);
+            element.pos = pos;
+            element.end = end;
+        }
+
+        void visitChildren(const shared<Node> &node) {
+            forEachChild(node, [this](const shared<Node> &child) -> sharedOpt<Node> {
+                visitNode(child);
+                return nullptr;
+            }, [this](const shared<NodeArray> &children) -> sharedOpt<Node> {
+                visitArray(children);
+                return nullptr;
+            });
+        }
+
+        void visitNode(const shared<Node> &child) {
+            Debug::asserts(child->pos <= child->end);
+            if (child->pos > changeRangeOldEnd) {
+                // Node is entirely past the change range.  We need to move both its pos and
+                // end, forward or backward appropriately.
+                moveNode(child);
+                return;
+            }
+
+            // Check if the element intersects the change range.  If it does, then it is not
+            // reusable.  Also, we'll need to recurse to see what constituent portions we may
+            // be able to use.
+            if (child->end >= changeStart) {
+                intersecting.insert(child.get());
+                adjustIntersectingElement(*child);
+                visitChildren(child);
+            }
+            // Otherwise, the node is entirely before the change range.  No need to do anything with it.
+        }
+
+        void visitArray(const shared<NodeArray> &children) {
+            if (children->pos < 0) {
+                for (auto &&node: children->list) visitNode(node);
+                return;
+            }
+
+            Debug::asserts(children->pos <= children->end);
+            if (children->pos > changeRangeOldEnd) {
+                moveArray(children);
+                return;
+            }
+
+            if (children->end >= changeStart) {
+                adjustIntersectingElement(*children);
+                for (auto &&node: children->list) visitNode(node);
+            }
+        }
+    };
+
+    sharedOpt<Node> getLastChild(const shared<Node> &node) {
+        sharedOpt<Node> lastChild;
+        forEachChild(node, [&lastChild](const shared<Node> &child) -> sharedOpt<Node> {
+            if (nodeIsPresent(child)) lastChild = child;
+            return nullptr;
+        }, [&lastChild](const shared<NodeArray> &children) -> sharedOpt<Node> {
+            // As an optimization, jump straight to the end of the list.
+            for (auto i = (int) children->list.size() - 1; i >= 0; i--) {
+                if (nodeIsPresent(children->list[i])) {
+                    lastChild = children->list[i];
+                    break;
+                }
+            }
+            return nullptr;
+        });
+        return lastChild;
+    }
+
+    struct NearestNodeFinder {
+        int position;
+        bool done = false;
+        shared<Node> bestResult;
+        sharedOpt<Node> lastNodeEntirelyBeforePosition;
+
+        void visitChildren(const shared<Node> &node) {
+            forEachChild(node, [this](const shared<Node> &child) -> sharedOpt<Node> {
+                visit(child);
+                return nullptr;
+            }, nullptr);
+        }
+
+        void visit(const shared<Node> &child) {
+            // Missing nodes are effectively invisible to us.
+            if (done || nodeIsMissing(child)) return;
+
+            if (child->pos <= position) {
+                // This node starts before the position, and is closer to the position than
+                // the previous best node we found.  It is now the new best node.
+                if (child->pos >= bestResult->pos) bestResult = child;
+
+                if (position < child->end) {
+                    // The nearest node is either this child, or one of the children inside of it.
+                    visitChildren(child);
+                    done = true;
+                } else {
+                    // The child ends entirely before this position. Once we're done searching we recurse
+                    // down this node to see if we can find a good result in it (e.g. in `<complex expr 2>`
+                    // of `<complex expr 1> ? <complex expr 2> $ : <...>`).
+                    lastNodeEntirelyBeforePosition = child;
+                }
+            } else {
+                // We're now at a node that is entirely past the position we're searching for.
+                done = true;
+            }
+        }
+    };
+
+    shared<Node> findNearestNodeStartingBeforeOrAtPosition(const shared<SourceFile> &sourceFile, int position) {
+        NearestNodeFinder finder{position, false, sourceFile};
+        finder.visitChildren(sourceFile);
+
+        if (finder.lastNodeEntirelyBeforePosition) {
+            auto node = finder.lastNodeEntirelyBeforePosition;
+            while (auto lastChild = getLastChild(node)) node = lastChild;
+            if (node->pos > finder.bestResult->pos) return node;
+        }
+
+        return finder.bestResult;
+    }
+
+    void aggregateChildData(const shared<Node> &node) {
+        if (node->flags & (int) NodeFlags::HasAggregatedChildData) return;
+
+        auto hasError = (node->flags & (int) NodeFlags::ThisNodeHasError) != 0;
+        if (!hasError) {
+            forEachChild(node, [&hasError](const shared<Node> &child) -> sharedOpt<Node> {
+                if (!hasError && containsParseError(child)) hasError = true;
+                return nullptr;
+            }, nullptr);
+        }
+        if (hasError) node->flags |= (int) NodeFlags::ThisNodeOrAnySubNodesHasError;
+        node->flags |= (int) NodeFlags::HasAggregatedChildData;
+    }
+}
+
+SyntaxCursor::SyntaxCursor(const shared<SourceFile> &sourceFile): sourceFile(sourceFile) {
+    currentArray = sourceFile->statements.get();
+    Debug::asserts(currentArrayIndex < currentArray->length());
+    current = currentArray->list[currentArrayIndex];
+}
+
+sharedOpt<Node> SyntaxCursor::currentNode(int position) {
     // Only compute the current node if the position is different than the last time
     // we were asked.  The parser commonly asks for the node at the same position
     // twice.  Once to know if can read an appropriate list element at a certain point,
     // and then to actually read and consume the node.
-//    if (position != lastQueriedPosition) {
-//        // Much of the time the parser will need the very next node in the array that
-//        // we just returned a node from.So just simply check for that case and move
-//        // forward in the array instead of searching for the node again.
-//        if (current && current->end == position && currentArrayIndex < (currentArray->length() - 1)) {
-//            currentArrayIndex++;
-//            current = &currentArray->list[currentArrayIndex];
-//        }
-//
-//        // If we don't have a node, or the node we have isn't in the right position,
-//        // then try to find a viable node at the position requested.
-//        if (!current || current->pos != position) {
-//            findHighestListElementThatStartsAtPosition(position);
-//        }
-//    }
+    if (position != lastQueriedPosition) {
+        // Much of the time the parser will need the very next node in the array that
+        // we just returned a node from. So just simply check for that case and move
+        // forward in the array instead of searching for the node again.
+        if (current && current->end == position && currentArrayIndex < (currentArray->length() - 1)) {
+            currentArrayIndex++;
+            current = currentArray->list[currentArrayIndex];
+        }
+
+        // If we don't have a node, or the node we have isn't in the right position,
+        // then try to find a viable node at the position requested.
+        if (!current || current->pos != position) {
+            findHighestListElementThatStartsAtPosition(position);
+        }
+    }
 
     // Cache this query so that we don't do any extra work if the parser calls back
     // into us.  Note: this is very common as the parser will make pairs of calls like
@@ -30,61 +278,54 @@ Node SyntaxCursor::currentNode(int position) {
     // is called immediately after.
     lastQueriedPosition = position;
 
-    // Either we don'd have a node, or we have a node at the position being asked for.
-//    assert(!current || current->pos == position);
-    return *current;
+    // Either we don't have a node, or we have a node at the position being asked for.
+    Debug::asserts(!current || current->pos == position);
+    return current;
 }
 
 void SyntaxCursor::findHighestListElementThatStartsAtPosition(int position) {
-// Clear out any cached state about the last node we found.
-//    currentArray = nullptr;
-//    currentArrayIndex = InvalidPosition::Value;
-//    current = nullptr;
-//
-//    // Recurse into the source file to find the highest node at this position.
-//    forEachChild(sourceFile, visitNode, visitArray);
-//    return;
-//
-//    function visitNode(node: Node) {
-//        if (position >= node.pos && position < node.end) {
-//            // Position was within this node.  Keep searching deeper to find the node.
-//            forEachChild(node, visitNode, visitArray);
-//
-//            // don't proceed any further in the search.
-//            return true;
-//        }
-//
-//        // position wasn't in this node, have to keep searching.
-//        return false;
-//    }
-//
-//    function visitArray(array: NodeArray<Node>) {
-//        if (position >= array.pos && position < array.end) {
-//            // position was in this array.  Search through this array to see if we find a
-//            // viable element.
-//            for (let i = 0; i < array.length; i++) {
-//                const child = array[i];
-//                if (child) {
-//                    if (child.pos === position) {
-//                        // Found the right node.  We're done.
-//                        currentArray = array;
-//                        currentArrayIndex = i;
-//                        current = child;
-//                        return true;
-//                    }
-//                    else {
-//                        if (child.pos < position && position < child.end) {
-//                            // Position in somewhere within this child.  Search in it and
-//                            // stop searching in this array.
-//                            forEachChild(child, visitNode, visitArray);
-//                            return true;
-//                        }
-//                    }
-//                }
-//            }
-//        }
-//
-//        // position wasn't in this array, have to keep searching.
-//        return false;
-//    }
+    ListElementFinder finder{position};
+    finder.visitChildren(sourceFile);
+    currentArray = finder.array;
+    currentArrayIndex = finder.index;
+    current = finder.found;
+}
+
+void SyntaxCursor::markChange(int changeStart, int changeRangeOldEnd, int changeRangeNewEnd, int delta) {
+    ChangeMarker marker{changeStart, changeRangeOldEnd, changeRangeNewEnd, delta, intersecting};
+    marker.visitNode(sourceFile);
+}
+
+TextChangeRange tr::extendToAffectedRange(const shared<SourceFile> &sourceFile, const TextChangeRange &changeRange) {
+    // Consider the following code:
+    //      void foo() { /; }
+    //
+    // If the text changes with an insertion of / just before the semicolon then we end up with:
+    //      void foo() { //; }
+    //
+    // If we were to just use the changeRange a is, then we would not rescan the { token
+    // (as it does not intersect the actual original change range).  Because an edit may
+    // change the token touching it, we actually need to look back *at least* one token so
+    // that the prior token sees that change.
+    auto maxLookahead = 1;
+
+    auto start = changeRange.span.start;
+
+    // the first iteration aligns us with the change start. subsequent iteration move us to
+    // the left by maxLookahead tokens.  We only need to do this as long as we're not at the
+    // start of the tree.
+    for (int i = 0; start > 0 && i <= maxLookahead; i++) {
+        auto nearestNode = findNearestNodeStartingBeforeOrAtPosition(sourceFile, start);
+        Debug::asserts(nearestNode->pos <= start);
+        start = std::max(0, nearestNode->pos - 1);
+    }
+
+    auto finalSpan = TextSpan{start, textSpanEnd(changeRange.span) - start};
+    auto finalLength = changeRange.newLength + (changeRange.span.start - start);
+    return {finalSpan, finalLength};
+}
+
+bool tr::containsParseError(const shared<Node> &node) {
+    aggregateChildData(node);
+    return (node->flags & (int) NodeFlags::ThisNodeOrAnySubNodesHasError) != 0;
 }
@@ -1,43 +1,76 @@
 #pragma once
 
 #include <memory>
+#include <unordered_set>
 #include "types.h"
 
-using namespace std;
-
 namespace tr {
+    using types::TextSpan;
+    using types::TextChangeRange;
 
     enum InvalidPosition {
         Value = -1
     };
 
-    //not used
-//    struct IncrementalNode : Node, IncrementalElement {
-//        bool hasBeenIncrementallyParsed;
-//    };
+    inline int textSpanEnd(const TextSpan &span) {
+        return span.start + span.length;
+    }
 
-    class SyntaxCursor {
-        SourceFile *sourceFile;
-//        NodeArray *currentArray;
+    inline TextSpan textChangeRangeNewSpan(const TextChangeRange &range) {
+        return {range.span.start, range.newLength};
+    }
 
-        int currentArrayIndex = 0;
+    inline bool textChangeRangeIsUnchanged(const TextChangeRange &range) {
+        return range.span.length == 0 && range.newLength == 0;
+    }
 
-//        assert(currentArrayIndex < currentArray.length);
-        Node *current;
+    /**
+     * Allows finding nodes of the old SourceFile at a certain position in an efficient manner, used by
+     * the parser in incremental mode (see Parser::updateSourceFile()).
+     * The implementation takes advantage of the calling pattern it knows the parser will
+     * make in order to optimize finding nodes as quickly as possible.
+     *
+     * Before parsing, markChange() moves all nodes of the old tree to their positions in the new text
+     * and marks the nodes intersecting the change, which can not be reused.
+     */
+    class SyntaxCursor {
+        shared<SourceFile> sourceFile;
+        NodeArray *currentArray = nullptr;
+        int currentArrayIndex = 0;
+        sharedOpt<Node> current;
         int lastQueriedPosition = InvalidPosition::Value;
-    public:
-        SyntaxCursor(SourceFile *sourceFile) : sourceFile(sourceFile) {
-//            currentArray = &sourceFile->statements;
-//            current = &currentArray->list[currentArrayIndex];
-        }
 
-        Node currentNode(int position);
+        //IncrementalNode::intersectsChange of TypeScript. Only nodes along the changed range, so a set instead of a flag on each node.
+        std::unordered_set<Node *> intersecting;
 
         // Finds the highest element in the tree we can find that starts at the provided position.
         // The element must be a direct child of some node list in the tree.  This way after we
         // return it, we can easily return its next sibling in the list.
         void findHighestListElementThatStartsAtPosition(int position);
+
+    public:
+        explicit SyntaxCursor(const shared<SourceFile> &sourceFile);
+
+        //the old node starting at `position` that is an element of some list, or nullptr
+        sharedOpt<Node> currentNode(int position);
+
+        bool intersectsChange(Node *node) const {
+            return intersecting.contains(node);
+        }
+
+        /**
+         * Adjusts the positions of all nodes to the new text and marks the ones intersecting [changeStart, changeRangeOldEnd].
+         * See updateTokenPositionsAndMarkElements in TypeScript.
+         */
+        void markChange(int changeStart, int changeRangeOldEnd, int changeRangeNewEnd, int delta);
     };
 
-} // ts
+    /**
+     * Make the actual change larger so that we know to reparse anything whose lookahead
+     * might have intersected the change.
+     */
+    TextChangeRange extendToAffectedRange(const shared<SourceFile> &sourceFile, const TextChangeRange &changeRange);
 
+    //NodeFlags::ThisNodeOrAnySubNodesHasError, aggregated lazily from the children
+    bool containsParseError(const shared<Node> &node);
+}
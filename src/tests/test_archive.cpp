@@ -0,0 +1,59 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "../core.h"
+#include "../checker/archive.h"
+#include "./utils.h"
+
+using namespace tr;
+using namespace tr::checker;
+
+TEST_CASE("archiveModules") {
+    ArchiveWriter writer;
+    vector<string> paths;
+    for (auto i = 0; i<50; i++) {
+        auto path = fmt::format("node_modules/lib{}/index.d.ts", i);
+        writer.add(path, compile(fmt::format("const v{}: string = {};", i, i % 2 ? "'a'" : "1"), false));
+        paths.push_back(path);
+    }
+    REQUIRE_THROWS(writer.add(paths[0], compile("const a: string = 'a';", false)));
+
+    auto data = std::make_shared<string>(writer.build());
+    Archive archive(*data, data);
+    REQUIRE(archive.size() == 50);
+    REQUIRE(!archive.find("node_modules/lib50/index.d.ts"));
+
+    for (auto i = 0; i<50; i++) {
+        auto bin = archive.find(paths[i]);
+        REQUIRE(bin);
+        //zero-copy and aligned, so the bytecode header can be read in place
+        REQUIRE(bin->data() >= data->data());
+        REQUIRE((bin->data() - data->data()) % archive::alignment == 0);
+
+        auto module = archive.module(paths[i]);
+        vm2::run(module);
+        REQUIRE(module->errors.size() == (i % 2 ? 0 : 1));
+    }
+}
+
+TEST_CASE("archiveFile") {
+    auto file = (std::filesystem::temp_directory_path() / fmt::format("typerunner-archive-{}.tsa", getpid())).string();
+    ArchiveWriter writer;
+    writer.add("a.ts", compile("const a: string = 1;", false));
+    writer.add("b.ts", compile("const b: number = 1;", false));
+    writer.write(file);
+
+    shared<vm2::Module> module;
+    {
+        auto archive = Archive::open(file);
+        REQUIRE(archive->size() == 2);
+        module = archive->module("a.ts");
+    }
+    //the module keeps the mapping alive
+    vm2::run(module);
+    REQUIRE(module->errors.size() == 1);
+
+    fileWrite(file, "TRBA");
+    REQUIRE_THROWS(Archive::open(file));
+    std::filesystem::remove(file);
+}
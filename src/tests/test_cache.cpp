@@ -0,0 +1,94 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "../core.h"
+#include "../checker/cache.h"
+#include "./utils.h"
+
+using namespace tr;
+using namespace tr::checker;
+
+namespace fs = std::filesystem;
+
+fs::path emptyDirectory(const string &name) {
+    auto dir = fs::temp_directory_path() / fmt::format("typerunner-test-{}-{}", name, getpid());
+    fs::remove_all(dir);
+    return dir;
+}
+
+TEST_CASE("cacheHit") {
+    auto dir = emptyDirectory("hit");
+    BytecodeCache cache(dir);
+    string code = "const a: string = 'abc';";
+    REQUIRE(!cache.get(code));
+
+    auto bin = compile(code, false);
+    cache.put(code, bin);
+    auto cached = cache.get(code);
+    REQUIRE(cached);
+    REQUIRE(*cached == bin);
+
+    //same content, regardless where it comes from
+    BytecodeCache other(dir);
+    REQUIRE(other.get(string(code)));
+
+    //different options or content are different entries
+    BytecodeCache withOptions(dir, 1024 * 1024, "strict");
+    REQUIRE(!withOptions.get(code));
+    REQUIRE(!cache.get("const a: string = 'abcd';"));
+
+    //no temporary files left
+    for (auto &&item: fs::directory_iterator(dir)) {
+        REQUIRE(item.path().extension() == ".tsb");
+    }
+    fs::remove_all(dir);
+}
+
+TEST_CASE("cacheEviction") {
+    auto dir = emptyDirectory("eviction");
+    auto bin = compile("const a: string = 'a';", false);
+    //room for two entries
+    BytecodeCache cache(dir, bin.size() * 2 + bin.size() / 2);
+
+    cache.put("a", bin);
+    fs::last_write_time(cache.path(cache.key("a")), fs::file_time_type::clock::now() - std::chrono::hours(2));
+    cache.put("b", bin);
+    fs::last_write_time(cache.path(cache.key("b")), fs::file_time_type::clock::now() - std::chrono::hours(1));
+
+    //a is used again, so b is the least recently used
+    REQUIRE(cache.get("a"));
+    cache.put("c", bin);
+
+    REQUIRE(cache.get("a"));
+    REQUIRE(!cache.get("b"));
+    REQUIRE(cache.get("c"));
+    fs::remove_all(dir);
+}
+
+TEST_CASE("cacheCorrupt") {
+    auto dir = emptyDirectory("corrupt");
+    BytecodeCache cache(dir);
+    string code = "const a: string = 'abc';";
+    auto bin = compile(code, false);
+    bin[bin.size() - 2] = 0;
+    cache.put(code, bin);
+    REQUIRE(!cache.get(code));
+    fs::remove_all(dir);
+}
+
+TEST_CASE("cacheStaleTemp") {
+    auto dir = emptyDirectory("temp");
+    fs::create_directories(dir);
+    BytecodeCache cache(dir);
+    //left over by a writer that crashed before the rename, and one that is still writing
+    auto crashed = dir / "0000000000000001.tsb.1.0.tmp";
+    auto writing = dir / "0000000000000002.tsb.2.0.tmp";
+    fileWrite(crashed.string(), "x");
+    fileWrite(writing.string(), "x");
+    fs::last_write_time(crashed, fs::file_time_type::clock::now() - std::chrono::hours(2));
+
+    cache.evict();
+    REQUIRE(!fs::exists(crashed));
+    REQUIRE(fs::exists(writing));
+    fs::remove_all(dir);
+}
@@ -0,0 +1,152 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <random>
+#include <unordered_set>
+#include "../parser2.h"
+
+using namespace tr;
+
+//flags the incremental parser caches on reused nodes, see containsParseError()
+constexpr int cachedFlags = (int) NodeFlags::HasAggregatedChildData | (int) NodeFlags::ThisNodeOrAnySubNodesHasError;
+
+void dump(const shared<Node> &node, string &out) {
+    out += fmt::format("({} {}-{} {} {}", (int) node->kind, node->pos, node->end, node->flags & ~cachedFlags, node->transformFlags);
+    if (auto identifier = to<Identifier>(node)) out += fmt::format(" '{}'", identifier->escapedText);
+    if (node->kind == SyntaxKind::StringLiteral || node->kind == SyntaxKind::NumericLiteral) out += fmt::format(" '{}'", to<LiteralLike>(node)->text);
+    forEachChild(node, [&out](const shared<Node> &child) -> sharedOpt<Node> {
+        dump(child, out);
+        return nullptr;
+    }, [&out](const shared<NodeArray> &children) -> sharedOpt<Node> {
+        out += fmt::format("[{}-{} {}", children->pos, children->end, children->hasTrailingComma);
+        for (auto &&child: children->list) dump(child, out);
+        out += "]";
+        return nullptr;
+    });
+    out += ")";
+}
+
+string dump(const shared<Node> &node) {
+    string out;
+    dump(node, out);
+    return out;
+}
+
+shared<SourceFile> parse(Parser &parser, const string &code) {
+    return parser.parseSourceFile("app.ts", code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+}
+
+//only what the parser supports: no interface, enum, import/export, decorators and no statements the parser does not
+//implement (loops, switch, try), not even as part of an identifier a random edit can cut out
+const string code = R"(
+type User = {
+    id: number;
+    name: string;
+    tags?: string[];
+    [key: string]: unknown;
+};
+
+type Id<T> = T extends {id: infer I} ? I : never;
+type Names = Id<User> | "none";
+
+function find(users: User[], id: number): User | undefined {
+    const found = users.filter((user) => user.id === id);
+    if (found.length) {
+        return found[0];
+    } else {
+        return undefined;
+    }
+}
+
+class Store<T extends User> {
+    private items: T[] = [];
+    constructor(public readonly name: string) {}
+    add(item: T) {
+        this.items.push(item);
+        return this;
+    }
+    get size() { return this.items.length; }
+}
+
+const store = new Store<User>("users");
+let count = 0, label: string;
+async function load(id: number) {
+    const user = await fetchUser(id, {cache: true});
+    label = user ? `${user.name} (${id})` : "none";
+}
+)";
+
+TEST_CASE("reusesUnchangedNodes") {
+    Parser parser;
+    auto sourceFile = parse(parser, code);
+    std::unordered_set<Node *> old;
+    for (auto &&statement: sourceFile->statements->list) old.insert(statement.get());
+
+    //rename `count` in `let count = 0` to `counter`
+    auto pos = code.find("count = 0");
+    auto newText = code.substr(0, pos) + "counter" + code.substr(pos + 5);
+    auto result = parser.updateSourceFile(sourceFile, newText, {{(int) pos, 5}, 7}, true);
+
+    auto reused = 0;
+    for (auto &&statement: result->statements->list) if (old.contains(statement.get())) reused++;
+    //the edited statement and the one before it, the change is extended back by a token (see extendToAffectedRange())
+    CHECK(reused == result->statements->list.size() - 2);
+    CHECK(dump(result) == dump(parse(parser, newText)));
+    CHECK(result->text == newText);
+}
+
+TEST_CASE("randomizedEdits") {
+    vector<string> insertions{"", " ", "\n", "a", "x1", "{", "}", "(", ")", "[", "]", ";", ",", ":", "<", ">", "=", "=>", "?", ".", "\"", "'", "`",
+                              "/", "//", "/*", "*/", "0", "1.5", "const", "let v = 1;", "function f() {}", "class C {}", "async", "await ", "x: number", "<T>",
+                              "if (a) {", "else", "return;", "type T = ", "| string", "${", "a ? b : c"};
+    for (int seed = 0; seed<50; seed++) {
+        std::mt19937 random(seed);
+        Parser parser;
+        auto text = code;
+        auto sourceFile = parse(parser, text);
+
+        for (int i = 0; i<20; i++) {
+            auto start = (int) (random() % (text.size() + 1));
+            auto length = std::min((int) (random() % 12), (int) text.size() - start);
+            auto &insertion = insertions[random() % insertions.size()];
+            auto newText = text.substr(0, start) + insertion + text.substr(start + length);
+            string expected;
+            try {
+                expected = dump(parse(parser, newText));
+            } catch (std::exception &) {
+                //unsupported syntax
+                continue;
+            }
+
+            INFO("seed ", seed, " edit ", i, ": ", start, "+", length, " -> '", insertion, "'");
+            sourceFile = parser.updateSourceFile(sourceFile, newText, {{start, length}, (int) insertion.size()}, true);
+            REQUIRE(dump(sourceFile) == expected);
+            text = newText;
+        }
+    }
+}
+
+TEST_CASE("releasesPreviousVersions") {
+    Parser parser;
+    parser.maxGenerations = 4;
+    auto text = code;
+    auto sourceFile = parse(parser, text);
+    std::weak_ptr<SourceFile> first = sourceFile;
+    std::weak_ptr<Arena> firstArena = sourceFile->arena;
+
+    for (int i = 0; i<10; i++) {
+        auto newText = text + fmt::format("const v{} = {};\n", i, i);
+        sourceFile = parser.updateSourceFile(sourceFile, newText, {{(int) text.size(), 0}, (int) (newText.size() - text.size())}, true);
+        text = newText;
+        if (i == 0) {
+            //only the arena of the previous version stays alive, not the file with its tree and atoms
+            CHECK(first.expired());
+            //the control block of the file keeps its arena, see ArenaOwner
+            first.reset();
+        }
+        CHECK(sourceFile->arena->generation<=parser.maxGenerations);
+        CHECK(dump(sourceFile) == dump(parse(parser, newText)));
+    }
+    //parsed fully again after maxGenerations edits, which released the arenas of the first versions
+    CHECK(firstArena.expired());
+}
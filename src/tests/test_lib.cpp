@@ -0,0 +1,67 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "../core.h"
+#include "../checker/lib.h"
+#include "./utils.h"
+
+using namespace tr;
+using namespace tr::checker;
+
+std::string compileWithLib(std::string code) {
+    Parser parser;
+    auto result = parser.parseSourceFile("app.ts", code, ScriptTarget::Latest, false, ScriptKind::TS, {});
+    Compiler compiler;
+    compiler.lib = &vm2::lib->symbols;
+    auto bin = compiler.compileSourceFile(result).build();
+    printBin(bin);
+    return bin;
+}
+
+TEST_CASE("libSnapshot") {
+    auto file = (std::filesystem::temp_directory_path() / fmt::format("typerunner-lib-{}.tsb", getpid())).string();
+    auto bin = compileLib();
+    fileWrite(file, bin);
+
+    //mapped, not compiled
+    auto lib = loadLib(file);
+    REQUIRE(lib->bin == bin);
+    REQUIRE(lib->verified);
+    auto symbols = bytecode::symbols(lib->bin);
+    REQUIRE(symbols.contains(tr::hash::const_hash("Array")));
+    REQUIRE(symbols.contains(tr::hash::const_hash("PropertyKey")));
+
+    //invalid snapshots are ignored
+    fileWrite(file, "nope");
+    REQUIRE(loadLib(file)->bin == bin);
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("libGlobals") {
+    vm2::setLib(loadLib(""));
+    string code = R"(
+const a: PropertyKey = 1;
+const b: PropertyKey = true;
+)";
+    auto bin = compileWithLib(code);
+    auto module = make_shared<vm2::Module>(bin, "app.ts", code);
+    vm2::run(module);
+    module->printErrors();
+    REQUIRE(module->errors.size() == 1);
+
+    //cached results of the lib are reset with every run
+    module->clear();
+    vm2::run(module);
+    REQUIRE(module->errors.size() == 1);
+
+    //without lib the compiler does not know the global types
+    test(code, 4);
+
+    //bytecode compiled against a lib that has the type, but the VM has no lib
+    vm2::setLib(nullptr);
+    module = make_shared<vm2::Module>(bin, "app.ts", code);
+    vm2::run(module);
+    module->printErrors();
+    REQUIRE(module->errors.size() == 4);
+    REQUIRE(module->errors[0].message == "Cannot find name 'PropertyKey'");
+}
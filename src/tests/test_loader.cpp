@@ -0,0 +1,62 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <set>
+#include <thread>
+#include "../core.h"
+#include "../loader.h"
+
+using namespace tr;
+
+namespace fs = std::filesystem;
+
+vector<string> writeFiles(const fs::path &dir, unsigned int count) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    vector<string> paths;
+    for (unsigned int i = 0; i<count; i++) {
+        auto path = (dir / fmt::format("file{}.ts", i)).string();
+        fileWrite(path, fmt::format("type a{} = string;", i));
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+TEST_CASE("loadAll") {
+    auto dir = fs::temp_directory_path() / fmt::format("typerunner-test-loader-{}", getpid());
+    auto paths = writeFiles(dir, 100);
+    paths.push_back((dir / "missing.ts").string());
+
+    std::set<string> loaded;
+    vector<string> errors;
+    auto caller = std::this_thread::get_id();
+    //small batches, so several workers run
+    FileLoader(4, 8).load(paths, [&](LoadedFile &file) {
+        REQUIRE(std::this_thread::get_id() == caller);
+        if (!file.sourceFile) {
+            errors.push_back(file.path);
+            return;
+        }
+        REQUIRE(file.sourceFile->statements->list.size() == 1);
+        auto alias = to<TypeAliasDeclaration>(file.sourceFile->statements->list[0]);
+        auto index = file.path.substr(file.path.rfind("file") + 4);
+        REQUIRE(file.sourceFile->atoms.text(alias->name->atom) == "a" + index.substr(0, index.size() - 3));
+        loaded.insert(file.path);
+    });
+
+    REQUIRE(loaded.size() == 100);
+    REQUIRE(errors == vector<string>{(dir / "missing.ts").string()});
+    fs::remove_all(dir);
+}
+
+TEST_CASE("loadStopsOnThrow") {
+    auto dir = fs::temp_directory_path() / fmt::format("typerunner-test-loader-throw-{}", getpid());
+    auto paths = writeFiles(dir, 50);
+
+    unsigned int handled = 0;
+    REQUIRE_THROWS(FileLoader(4, 1).load(paths, [&](LoadedFile &file) {
+        if (++handled == 3) throw std::runtime_error("stop");
+    }));
+    REQUIRE(handled == 3);
+    fs::remove_all(dir);
+}
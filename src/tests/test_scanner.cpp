@@ -1,11 +1,14 @@
-#include <gtest/gtest.h>
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
 
 #include <iostream>
+#include <random>
 #include "../scanner.h"
+#include "../ascii.h"
 
 using namespace tr;
 
-TEST(scanner, basisc) {
+TEST_CASE("basic") {
 
     auto start = std::chrono::high_resolution_clock::now();
     Scanner scanner("const i = 123;const i2 = 123;const i3 = 123;const i4 = 123;const i5 = 123;const i6 = 123;const i7 = 123;const i8 = 123;");
@@ -37,4 +40,74 @@ TEST(scanner, basisc) {
 //    std::cout << enum_name(scanner.scan()) << "\n";
 //    std::cout << enum_name(scanner.scan()) << "\n";
 //    std::cout << enum_name(scanner.scan()) << "\n";
-}
\ No newline at end of file
+}
+TEST_CASE("asciiFastPath") {
+    //compares the SIMD fast paths with a byte by byte scan, at all offsets and around the vector sizes
+    std::mt19937 random(42);
+    const string alphabet = "abcXYZ019_$ \t\v\f\n\r*/'\"\\-#\x80\xC3\xE2";
+    for (int i = 0; i < 200; i++) {
+        string text;
+        auto size = random() % 100;
+        for (int j = 0; j < size; j++) {
+            //long runs of one class, so runs cross block boundaries
+            auto c = alphabet[random() % alphabet.size()];
+            auto repeat = random() % 4 == 0 ? random() % 40 : 1;
+            text.append(repeat, c);
+        }
+
+        for (int pos = 0; pos <= text.size(); pos++) {
+            int end = text.size();
+            auto expected = pos;
+            while (expected < end && utf::isAsciiIdentifierPart(text[expected])) expected++;
+            CHECK(utf::skipAsciiIdentifierPart(text, pos, end) == expected);
+
+            expected = pos;
+            while (expected < end && utf::isAsciiWhitespace(text[expected], false)) expected++;
+            CHECK(utf::skipAsciiWhitespace(text, pos, end) == expected);
+
+            expected = pos;
+            bool expectedLineBreak = false;
+            for (; expected < end && utf::isAsciiWhitespace(text[expected], true); expected++) {
+                if (text[expected] == '\n' || text[expected] == '\r') expectedLineBreak = true;
+            }
+            bool lineBreak = false;
+            CHECK(utf::skipAsciiWhitespace(text, pos, end, &lineBreak) == expected);
+            CHECK(lineBreak == expectedLineBreak);
+
+            expected = pos;
+            while (expected < end && (unsigned char) text[expected] < 0x80 && text[expected] != '*' && text[expected] != '\n' && text[expected] != '\r') expected++;
+            CHECK(utf::skipAsciiUntil<'*', '\n', '\r'>(text, pos, end) == expected);
+
+            //end before the text ends
+            if (pos < end) CHECK(utf::skipAsciiIdentifierPart(text, pos, pos + 1) <= pos + 1);
+        }
+    }
+}
+
+TEST_CASE("scannerNonAscii") {
+    //the fast paths stop at non-ASCII, the UTF-8 decoder takes over from there
+    auto longName = string(40, 'a');
+    Scanner scanner(ScriptTarget::Latest, true);
+    auto text = longName + "\u00fc" + longName + " /* " + longName + " \u2028 */ x // " + longName + "\u00e9\n'" + longName + "\u00e9' \"" + longName + "\n";
+    scanner.setText(text);
+
+    CHECK(scanner.scan() == SyntaxKind::Identifier);
+    CHECK(scanner.getTokenValue() == longName + "\u00fc" + longName);
+
+    //the line separator in the comment is a line break
+    CHECK(scanner.scan() == SyntaxKind::Identifier);
+    CHECK(scanner.getTokenValue() == "x");
+    CHECK(scanner.hasPrecedingLineBreak());
+
+    CHECK(scanner.scan() == SyntaxKind::StringLiteral);
+    CHECK(scanner.getTokenValue() == longName + "\u00e9");
+    CHECK(scanner.hasPrecedingLineBreak());
+
+    CHECK(scanner.scan() == SyntaxKind::StringLiteral);
+    CHECK(scanner.getTokenValue() == longName);
+    CHECK(scanner.isUnterminated());
+    CHECK(!scanner.hasPrecedingLineBreak());
+
+    CHECK(scanner.scan() == SyntaxKind::EndOfFileToken);
+    CHECK(scanner.hasPrecedingLineBreak());
+}
@@ -0,0 +1,147 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "../visitor.h"
+#include "./utils.h"
+
+using namespace tr;
+
+shared<SourceFile> parse(const string &code) {
+    Parser parser;
+    return parser.parseSourceFile("app.ts", code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+}
+
+string deepArrayType(unsigned int depth) {
+    string code = "type a = string";
+    for (unsigned int i = 0; i<depth; i++) code += "[]";
+    return code + ";";
+}
+
+TEST_CASE("walkOrder") {
+    auto file = parse("type a = string | number;");
+    vector<string> events;
+    auto result = walk(file, [&](const shared<Node> &node, unsigned int depth) {
+        events.push_back(fmt::format("pre {} {}", node->kind, depth));
+        return VisitResult::Continue;
+    }, [&](const shared<Node> &node, unsigned int depth) {
+        events.push_back(fmt::format("post {} {}", node->kind, depth));
+        return VisitResult::Continue;
+    });
+    REQUIRE(result);
+
+    vector<string> expected{
+            "pre SourceFile 0",
+            "pre TypeAliasDeclaration 1",
+            "pre Identifier 2", "post Identifier 2",
+            "pre UnionType 2",
+            "pre StringKeyword 3", "post StringKeyword 3",
+            "pre NumberKeyword 3", "post NumberKeyword 3",
+            "post UnionType 2",
+            "post TypeAliasDeclaration 1",
+            "pre EndOfFileToken 1", "post EndOfFileToken 1",
+            "post SourceFile 0",
+    };
+    REQUIRE(events == expected);
+}
+
+TEST_CASE("walkSkipAndStop") {
+    auto file = parse("type a = string | number; type b = boolean;");
+
+    vector<SyntaxKind> visited;
+    walk(file, [&](const shared<Node> &node, unsigned int depth) {
+        visited.push_back(node->kind);
+        return node->kind == SyntaxKind::UnionType ? VisitResult::Skip : VisitResult::Continue;
+    });
+    REQUIRE(std::count(visited.begin(), visited.end(), SyntaxKind::StringKeyword) == 0);
+    REQUIRE(std::count(visited.begin(), visited.end(), SyntaxKind::BooleanKeyword) == 1);
+
+    unsigned int posts = 0;
+    auto result = walk(file, [&](const shared<Node> &node, unsigned int depth) {
+        return node->kind == SyntaxKind::StringKeyword ? VisitResult::Stop : VisitResult::Continue;
+    }, [&](const shared<Node> &node, unsigned int depth) {
+        posts++;
+        return VisitResult::Continue;
+    });
+    REQUIRE_FALSE(result);
+    REQUIRE(posts == 1); //only the alias name, the walk stopped before leaving any other node
+}
+
+struct Counts {
+    unsigned int identifiers = 0;
+    unsigned int others = 0;
+};
+
+TEST_CASE("walkKindTable") {
+    auto file = parse("type a<T> = T | b; type b = string;");
+    KindTable<Counts> table;
+    table.on(SyntaxKind::Identifier, [](Counts &counts, const shared<Node> &, unsigned int) {
+        counts.identifiers++;
+        return VisitResult::Continue;
+    }).otherwise([](Counts &counts, const shared<Node> &, unsigned int) {
+        counts.others++;
+        return VisitResult::Continue;
+    });
+
+    Counts counts;
+    walk(file, [&](const shared<Node> &node, unsigned int depth) {
+        return table(counts, node, depth);
+    });
+    REQUIRE(counts.identifiers == 5);
+    REQUIRE(counts.others == 9);
+}
+
+TEST_CASE("walkDeep") {
+    auto file = parse(deepArrayType(20000));
+    unsigned int maxDepth = 0;
+    walk(file, [&](const shared<Node> &node, unsigned int depth) {
+        maxDepth = std::max(maxDepth, depth);
+        return VisitResult::Continue;
+    });
+    //SourceFile > TypeAliasDeclaration > 20000 ArrayType > StringKeyword
+    REQUIRE(maxDepth == 20000 + 2);
+    //so the file is released without recursion, see SourceFile::releaseStatements()
+    CHECK(file->nestingDepth >= maxDepth);
+}
+
+TEST_CASE("nestingDepth") {
+    //shallow files are released as usual
+    CHECK(parse(deepArrayType(10))->nestingDepth < 256);
+
+    //never below the height of the tree, also with bodies parsed later
+    string code = "function f() {\n" + deepArrayType(1000) + "\n}";
+    Parser parser;
+    parser.lazyBodies = true;
+    auto file = parser.parseSourceFile("app.ts", code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+    CHECK(file->nestingDepth < 256);
+    parser.parseLazyBody(file, to<Block>(to<FunctionDeclaration>(file->statements->list[0])->body));
+    unsigned int maxDepth = 0;
+    walk(file, [&](const shared<Node> &node, unsigned int depth) {
+        maxDepth = std::max(maxDepth, depth);
+        return VisitResult::Continue;
+    });
+    CHECK(file->nestingDepth >= maxDepth);
+}
+
+TEST_CASE("compileTooDeep") {
+    test(deepArrayType(100), 0);
+
+    //reported instead of overflowing the stack in Compiler::handle()
+    auto module = test(deepArrayType(20000), 1);
+    REQUIRE(module->errors[0].message == "Expression is nested too deeply to be checked");
+}
+
+TEST_CASE("compileTooDeepLazyBody") {
+    //SourceFile > FunctionDeclaration > Block > TypeAliasDeclaration > 997 ArrayType > StringKeyword, so the
+    //body is within maxDepth on its own but not at its depth in the file
+    string code = "function f() {\n" + deepArrayType(997) + "\nreturn 1;\n}";
+    test(code, 1);
+
+    Parser parser;
+    parser.lazyBodies = true;
+    auto file = parser.parseSourceFile("app.ts", code, types::ScriptTarget::Latest, false, ScriptKind::TS, {});
+    checker::Compiler compiler;
+    auto module = make_shared<vm2::Module>(compiler.compileSourceFile(file).build(), "app.ts", code);
+    vm2::run(module);
+    REQUIRE(module->errors.size() == 1);
+    REQUIRE(module->errors[0].message == "Expression is nested too deeply to be checked");
+}
@@ -1,6 +1,7 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 #include <memory>
+#include <cstring>
 
 #include "../core.h"
 #include "../hash.h"
@@ -44,8 +45,9 @@ const v2: number = 123;
     run(module);
     REQUIRE(module->errors.size() == 0);
     tr::vm2::gcStackAndFlush();
-    //only v1, v2
-    REQUIRE(tr::vm2::pool.active == 2);
+    //only v1, v2, which are constants and live in the module
+    REQUIRE(tr::vm2::pool.active == 0);
+    REQUIRE(module->constantPool.types.size() == 2);
 
     testBench(code, 0);
 }
@@ -96,6 +98,219 @@ const v3: a<true> = false;
     testBench(code, 1);
 }
 
+TEST_CASE("vm2Constant") {
+    string code = R"(
+type Person = {name: string, age: number};
+const a: Person = {name: 'Peter', age: 52};
+const b: Person = {name: 'Peter', age: '52'};
+    )";
+    auto module = std::make_shared<vm2::Module>(tr::compile(code), "app.ts", code);
+    run(module);
+    REQUIRE(module->errors.size() == 1);
+    REQUIRE(module->subroutines[1].flags & instructions::SubroutineFlag::Constant);
+    auto person = module->subroutines[1].result;
+    REQUIRE(person != nullptr);
+
+    //the materialized type survives the next run and is not built again
+    module->clear();
+    run(module);
+    REQUIRE(module->errors.size() == 1);
+    REQUIRE(module->subroutines[1].result == person);
+
+    testBench(code, 1);
+}
+
+TEST_CASE("vm2StorageDedup") {
+    string code = R"(
+type A = {name: string, title: 'name'};
+const a: A = {name: 'Peter', title: 'name'};
+    )";
+    auto bin = tr::compile(code);
+    auto result = checker::parseBin(bin);
+    //"A", "name", "title", "a", "Peter"
+    REQUIRE(result.storages.size() == 5);
+    test(code, 0);
+}
+
+TEST_CASE("vm2SymbolScope") {
+    string code = R"(
+type A<T> = [T extends string ? T : never, T];
+const a: A<string> = ['a', 'a'];
+    )";
+    auto result = checker::parseBin(tr::compile(code));
+    auto &ops = result.subroutines[1].operations;
+    //T after the conditional type is the type argument again, not the distributed T
+    REQUIRE(ops[ops.size() - 4].text == "Loads 0 0");
+}
+
+TEST_CASE("vm2BuildLarge") {
+    string code;
+    for (unsigned int i = 0; i<200; i++) {
+        code += fmt::format("type T{} = {{name: string, age: number, id: {}}};\n", i, i);
+        code += fmt::format("const v{}: T{} = {{name: 'Peter', age: 52, id: {}}};\n", i, i, i);
+    }
+    auto bin = tr::compile(code, false);
+    auto result = checker::parseBin(bin);
+    REQUIRE(result.subroutines.size() == 1 + 400);
+    test(code, 0);
+    testBuildBench(code, 10);
+}
+
+TEST_CASE("vm2BytecodeHeader") {
+    string code = R"(
+const a: string = 'abc';
+    )";
+    auto bin = tr::compile(code);
+    auto &header = bytecode::readHeader(bin);
+    REQUIRE(header.subroutineCount == 2);
+    REQUIRE(header.codeOffset + header.codeSize == header.sourceMapOffset);
+    REQUIRE(header.sourceMapOffset + header.sourceMapSize == bin.size());
+    REQUIRE_NOTHROW(bytecode::verifyChecksum(bin));
+
+    auto corrupt = bin;
+    corrupt[header.codeOffset] = OP::Never;
+    REQUIRE_THROWS(run(std::make_shared<vm2::Module>(corrupt, "app.ts", code)));
+
+    auto wrongMagic = bin;
+    wrongMagic[0] = 'X';
+    REQUIRE_THROWS(bytecode::readHeader(wrongMagic));
+
+    REQUIRE_THROWS(bytecode::readHeader(bin.substr(0, bin.size() - 1)));
+}
+
+TEST_CASE("vm2SourceMap") {
+    string code = R"(
+const v1: string = 123;
+const v2: number = 123;
+const v3: string = 'abc';
+    )";
+    auto bin = tr::compile(code, false);
+    auto &header = bytecode::readHeader(bin);
+    auto map = bytecode::readSourceMap(bytecode::sourceMap(bin), header.codeOffset);
+    REQUIRE(!map.empty());
+    //delta encoded, instead of 3 uint32 per entry
+    REQUIRE(header.sourceMapSize<map.size() * 3 * 4 / 2);
+    auto debug = checker::parseBin(bin);
+    REQUIRE(debug.sourceMap.size() == map.size());
+
+    auto module = std::make_shared<vm2::Module>(bin, "app.ts", code);
+    run(module);
+    REQUIRE(module->errors.size() == 1);
+    REQUIRE(module->findIdentifier(module->errors[0].ip) == "v1");
+
+    //detached, the checksum stays valid and it runs the same, only without positions
+    auto stripped = bytecode::withoutSourceMap(bin);
+    REQUIRE(stripped.size() == bin.size() - header.sourceMapSize);
+    REQUIRE_NOTHROW(bytecode::verifyChecksum(stripped));
+    auto strippedModule = std::make_shared<vm2::Module>(stripped, "app.ts", code);
+    run(strippedModule);
+    REQUIRE(strippedModule->errors.size() == 1);
+    REQUIRE(strippedModule->findIdentifier(strippedModule->errors[0].ip) == "");
+
+    //loaded separately
+    auto separate = std::make_shared<string>(bytecode::sourceMap(bin));
+    strippedModule->attachSourceMap(*separate, separate);
+    REQUIRE(strippedModule->findIdentifier(strippedModule->errors[0].ip) == "v1");
+
+    //a map of another build is rejected
+    auto other = tr::compile("const v2: number = 'abc';", false);
+    strippedModule->attachSourceMap(bytecode::sourceMap(other));
+    REQUIRE(strippedModule->findIdentifier(strippedModule->errors[0].ip) == "");
+}
+
+TEST_CASE("vm2Verifier") {
+    string code = R"(
+type A = 'a' | 'b' extends string ? 1 : 2;
+const a: string = 'abc';
+const b: A = 1;
+    )";
+    auto bin = tr::compile(code, false);
+    REQUIRE_NOTHROW(checker::verify(bin));
+
+    auto result = checker::parseBin(bin);
+    auto find = [&](OP op) -> unsigned int {
+        for (auto &&routine: result.subroutines) {
+            for (auto &&operation: routine.operations) {
+                if ((OP) bin[operation.address] == op) return operation.address;
+            }
+        }
+        return 0;
+    };
+    auto corrupt = [&](OP op, unsigned int offset, uint32_t value) {
+        auto address = find(op);
+        REQUIRE(address);
+        auto copy = bin;
+        std::memcpy(copy.data() + address + offset, &value, sizeof(value));
+        return copy;
+    };
+
+    //jump into its own parameters
+    REQUIRE_THROWS(checker::verify(corrupt(OP::Jump, 1, 2)));
+    //jump out of the subroutine
+    REQUIRE_THROWS(checker::verify(corrupt(OP::ExtendsJumpCondition, 1 + 1, 10000)));
+    //not a storage entry
+    REQUIRE_THROWS(checker::verify(corrupt(OP::StringLiteral, 1, vm::readUint32(bin, find(OP::StringLiteral) + 1) + 1)));
+    //subroutine does not exist
+    REQUIRE_THROWS(checker::verify(corrupt(OP::Call, 1, 1000)));
+
+    //unsupported OP
+    auto unsupported = bin;
+    unsupported[find(OP::Return)] = OP::Intersection;
+    REQUIRE_THROWS(checker::verify(unsupported));
+
+    //stack underflow: the assignment has nothing to assign
+    auto unbalanced = bin;
+    unbalanced[find(OP::String)] = OP::Pop;
+    REQUIRE_THROWS(checker::verify(unbalanced));
+
+    //the VM refuses it before executing anything, even with a valid checksum
+    ((bytecode::Header *) unbalanced.data())->checksum = bytecode::checksum(unbalanced);
+    REQUIRE_THROWS(run(std::make_shared<vm2::Module>(unbalanced, "app.ts", code)));
+}
+
+TEST_CASE("vm2ModuleMapped") {
+    string code = R"(
+const v1: string = 123;
+    )";
+    auto dir = std::filesystem::temp_directory_path();
+    auto sourcePath = (dir / fmt::format("typerunner-mapped-{}.ts", getpid())).string();
+    auto binPath = sourcePath + ".tsb";
+    fileWrite(sourcePath, code);
+    fileWrite(binPath, tr::compile(code));
+
+    auto mapped = fileMap(binPath);
+    auto module = std::make_shared<vm2::Module>(mapped->view(), mapped, "app.ts", sourcePath);
+    REQUIRE(module->bin.data() == mapped->view().data());
+    run(module);
+    REQUIRE(module->errors.size() == 1);
+    //source is loaded on demand
+    REQUIRE(module->findIdentifier(module->errors[0].ip) == "v1");
+
+    std::filesystem::remove(sourcePath);
+    std::filesystem::remove(binPath);
+}
+
+TEST_CASE("vm2Superinstructions") {
+    string code = R"(
+type Person = {name: string, age: number, title: 'mr' | 'mrs'};
+type IsString<T> = T extends string ? true : false;
+const a: Person = {name: 'Peter', age: 52, title: 'mr'};
+const b: Person = {name: 'Peter', age: 52, title: 'dr'};
+    )";
+    auto bin = tr::compile(code);
+    auto result = checker::parseBin(bin);
+    checker::printOpStats(bin);
+    REQUIRE(result.opCounts[OP::StringPropertySignature] == 1);
+    REQUIRE(result.opCounts[OP::NumberPropertySignature] == 1);
+    REQUIRE(result.opCounts[OP::StringLiteralPropertySignature] == 1 + 3 + 3);
+    REQUIRE(result.opCounts[OP::PropertySignature] == 0);
+    REQUIRE(result.opCounts[OP::LoadsDistribute] == 1);
+    REQUIRE(result.opCounts[OP::ExtendsJumpCondition] == 1);
+    REQUIRE(result.opCounts[OP::Extends] == 0);
+
+    test(code, 1);
+}
+
 TEST_CASE("vm2Base2") {
     string code = R"(
 type a<T> = T extends string ? 'yes' : 'no';
@@ -291,9 +506,11 @@ TEST_CASE("vm2Tuple2") {
 type A = [1, 2];
 const var1: A = [1, 2];
 )";
-    test(code, 0);
+    auto module = test(code, 0);
     tr::vm2::gcFlush();
-    REQUIRE(tr::vm2::pool.active == 1 + (2 + 2));
+    //A is constant, var1 shares its type
+    REQUIRE(tr::vm2::pool.active == 0);
+    REQUIRE(module->constantPool.types.size() == 1 + (2 + 2));
 }
 
 TEST_CASE("vm2Tuple3") {
@@ -304,7 +521,9 @@ const var1: A = [1, 2];
 )";
     auto module = test(code, 0);
     tr::vm2::gcFlush();
-    REQUIRE(tr::vm2::pool.active == (1 + 2) + (1 + 2)); //[1], [1, 2], where "1" in second tuple is shared with first "1" in [1]
+    //T is constant, A spreads it at runtime: [1, 2], where "1" in the tuple is shared with the "1" in constant [1]
+    REQUIRE(tr::vm2::pool.active == 1 + 2);
+    REQUIRE(module->constantPool.types.size() == 1 + 2); //[1]
     testBench(code);
 }
 
@@ -316,7 +535,8 @@ const var1: A = [1, 2];
 )";
     auto module = test(code, 0);
     tr::vm2::gcFlush();
-    REQUIRE(tr::vm2::pool.active == (1 + 2 + 2)); //$1, [$1, 2]
+    REQUIRE(tr::vm2::pool.active == 0);
+    REQUIRE(module->constantPool.types.size() == (1 + 2 + 2)); //$1, [$1, 2]
 }
 
 TEST_CASE("vm2Tuple31") {
@@ -389,9 +609,10 @@ TEST_CASE("vm2Fn4") {
 type F1 = [0];
 const var1: F1 = [0];
 )";
-    test(code, 0);
+    auto module = test(code, 0);
     tr::vm2::gcStackAndFlush();
-    REQUIRE(tr::vm2::pool.active == 3); //[0]
+    REQUIRE(tr::vm2::pool.active == 0);
+    REQUIRE(module->constantPool.types.size() == 3); //[0]
 }
 
 TEST_CASE("vm2Fn4_1") {
@@ -431,10 +652,10 @@ type T = [];
 const var1: F1<T> = [0];
 const var2: T = [];
 )";
-    test(code, 0);
+    auto module = test(code, 0);
     tr::vm2::gcFlush();
     //a new tuple is generated, but the same amount of active elements is active
-    REQUIRE(tr::vm2::pool.active == 1 + 3); //[] + [0]
+    REQUIRE(tr::vm2::pool.active + module->constantPool.types.size() == 1 + 3); //[] + [0]
 }
 
 TEST_CASE("vm2FnArg") {
@@ -627,6 +848,32 @@ TEST_CASE("function5") {
     testBench(code, 1);
 }
 
+TEST_CASE("functionLazyBody") {
+    string code = R"(
+    function doIt() {
+        return 1;
+    }
+    function declared(): number {
+        return 'no';
+    }
+    const var1: number = doIt();
+    const var2: string = doIt();
+    const var3: number = declared();
+)";
+    Parser parser;
+    parser.lazyBodies = true;
+    auto result = parser.parseSourceFile("app.ts", code, ScriptTarget::Latest, false, ScriptKind::TS, {});
+    checker::Compiler compiler;
+    auto module = make_shared<vm2::Module>(compiler.compileSourceFile(result).build(), "app.ts", code);
+    vm2::run(module);
+    module->printErrors();
+    CHECK(module->errors.size() == 1);
+
+    //parsed to infer the return type, the declared one is taken as is
+    CHECK(!to<Block>(to<FunctionDeclaration>(result->statements->list[0])->body)->lazy);
+    CHECK(to<Block>(to<FunctionDeclaration>(result->statements->list[1])->body)->lazy);
+}
+
 TEST_CASE("controlFlow1") {
     string code = R"(
     function boolFunc(t: true) {}
@@ -35,6 +35,27 @@ namespace tr {
         std::cout << fmt::format("{} iterations (it): warm {:.9f}ms/it", iterations, warmTime.count() / iterations);
     }
 
+    /**
+     * Benchmarks the compiler alone: parsing+compiling to a Program, and Program::build() to the binary.
+     */
+    void testBuildBench(string code, int iterations = 1000) {
+        Parser parser;
+        auto result = parser.parseSourceFile("app.ts", code, ScriptTarget::Latest, false, ScriptKind::TS, {});
+        checker::Compiler compiler;
+        auto program = compiler.compileSourceFile(result);
+        auto size = program.buildSize();
+
+        auto compileTime = benchRun(iterations, [&code] {
+            compile(code, false);
+        });
+
+        auto buildTime = benchRun(iterations, [&program] {
+            program.build();
+        });
+
+        std::cout << fmt::format("{} iterations (it), {} bytes: compile {:.9f}ms/it, build {:.9f}ms/it", iterations, size, compileTime.count() / iterations, buildTime.count() / iterations);
+    }
+
     void testBench(string code, unsigned int expectedErrors = 0, int iterations = 1000) {
         auto bin = compile(code);
         auto module = make_shared<vm2::Module>(bin, "app.ts", code);
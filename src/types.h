@@ -10,6 +10,8 @@
 #include <type_traits>
 #include <stdexcept>
 #include "core.h"
+#include "arena.h"
+#include "atoms.h"
 #include "enum.h"
 #include <fmt/core.h>
 #include <fmt/format.h>
@@ -86,6 +88,17 @@ namespace tr::types {
         CommentDirectiveType type;
     };
 
+    struct TextSpan {
+        int start = 0;
+        int length = 0;
+    };
+
+    //the text of `span` was replaced by a text of `newLength` characters
+    struct TextChangeRange {
+        TextSpan span;
+        int newLength = 0;
+    };
+
     enum class LanguageVariant {
         Standard,
         JSX
@@ -399,7 +412,7 @@ namespace tr::types {
         TemplateLiteralLikeFlags = ContainsInvalidEscape,
     };
 
-    enum class SyntaxKind {
+    enum class SyntaxKind: unsigned short {
         Unknown,
         EndOfFileToken,
         SingleLineCommentTrivia,
@@ -1201,8 +1214,8 @@ namespace tr {
 
     struct NodeArray {
         vector<shared<Node>> list;
-        int pos;
-        int end;
+        int pos = -1;
+        int end = -1;
         bool hasTrailingComma = false;
         bool isMissingList = false; //replaces `MissingList extends NodeArray {bool isMissingList;}`
         /* @internal */ int transformFlags = 0;   // Flags for transforms, possibly undefined
@@ -1314,30 +1327,44 @@ namespace tr {
 //        typeNode?: TypeNode;                         // VariableDeclaration type
     };
 
+    /**
+     * Fields of Node that are set only for few nodes: decorators are rare and the others are used by transforms.
+     * A node allocates it on the first write, so the common node stays small.
+     */
+    struct NodeExtra {
+        sharedOpt<NodeTypeArray(Decorator)> decorators;           // Array of decorators (in document order)
+        /* @internal */ sharedOpt<Node> original;                  // The original BaseNode if this is an updated node.
+        /* @internal */ sharedOpt<EmitNode> emitNode;              // Associated EmitNode (initialized by transforms)
+    };
+
     /**
      * All BaseNode pointers are owned by SourceFile. If SourceFile destroys, all its Nodes are destroyed as well.
      *
      * There are a big variety of sub types: All have in common that they are the owner of their data (except *parent).
      */
-    class Node: public SourceMapRange {
+    class Node: public types::TextRange {
     protected:
-        sharedOpt<Node> parent = nullptr;
+        Node *parent = nullptr; //not owning, the parent owns this node
+        std::unique_ptr<NodeExtra> extra;
+
+        NodeExtra &writeExtra() {
+            if (!extra) extra = std::make_unique<NodeExtra>();
+            return *extra;
+        }
+
     public:
         SyntaxKind kind = SyntaxKind::Unknown;
         constexpr static auto KIND = SyntaxKind::Unknown;
-        /* types::NodeFlags */ int flags;
-        /* @internal */ /* types::ModifierFlags */ int modifierFlagsCache;
+        /* types::NodeFlags */ int flags = 0;
+        /* @internal */ /* types::ModifierFlags */ int modifierFlagsCache = 0;
+        /* @internal */ /* types::TransformFlags */ int transformFlags = 0; // Flags for transforms
         sharedOpt<NodeTypeArray(Modifier)> modifiers;            // Array of modifiers
-        sharedOpt<NodeTypeArray(Decorator)> decorators;           // Array of decorators (in document order)
-        /* @internal */ /* types::TransformFlags */ int transformFlags; // Flags for transforms
 //        /* @internal */ id?: NodeId;                          // Unique id (used to look up NodeLinks)
-        /* @internal */ sharedOpt<Node> original;                      // The original BaseNode if this is an updated node.
 //        /* @internal */ symbol: Symbol;                       // Symbol declared by BaseNode (initialized by binding)
 //        /* @internal */ locals?: SymbolTable;                 // Locals associated with BaseNode (initialized by binding)
 //        /* @internal */ nextContainer?: Node;                 // Next container in declaration order (initialized by binding)
 //        /* @internal */ localSymbol?: Symbol;                 // Local symbol declared by BaseNode (initialized by binding only for exported nodes)
 //        /* @internal */ flowNode?: FlowNode;                  // Associated FlowNode (initialized by binding)
-        /* @internal */ sharedOpt<EmitNode> emitNode; //?: ;                  // Associated EmitNode (initialized by transforms)
 //        /* @internal */ contextualType?: Type;                // Used to temporarily assign a contextual type during overload resolution
 //        /* @internal */ inferenceContext?: InferenceContext;  // Inference context for contextual type
 
@@ -1348,15 +1375,40 @@ namespace tr {
             return parent != nullptr;
         }
 
-        void setParent(shared<Node> p) {
+        void setParent(Node *p) {
             parent = p;
         }
 
-        sharedOpt<Node> getParent() {
+        Node *getParent() {
             if (!hasParent()) throw std::runtime_error("Node has no parent set");
             return parent;
         }
 
+        sharedOpt<NodeArray> getDecorators() {
+            return extra ? extra->decorators : nullptr;
+        }
+
+        void setDecorators(sharedOpt<NodeArray> decorators) {
+            if (decorators || extra) writeExtra().decorators = std::move(decorators);
+        }
+
+        sharedOpt<Node> getOriginal() {
+            return extra ? extra->original : nullptr;
+        }
+
+        //owning: an original is always an older node, it never links back to its update, so this forms no cycle
+        void setOriginal(sharedOpt<Node> original) {
+            if (original || extra) writeExtra().original = std::move(original);
+        }
+
+        sharedOpt<EmitNode> getEmitNode() {
+            return extra ? extra->emitNode : nullptr;
+        }
+
+        void setEmitNode(sharedOpt<EmitNode> emitNode) {
+            if (emitNode || extra) writeExtra().emitNode = std::move(emitNode);
+        }
+
         //using dynamic_cast
         template<class T>
         T &cast() {
@@ -1390,6 +1442,13 @@ namespace tr {
         return reinterpret_pointer_cast<T>(p);
     }
 
+    template<class T>
+    T *to(Node *p) {
+        if (!p) return nullptr;
+        if (T::KIND != SyntaxKind::Unknown && p->kind != T::KIND) return nullptr;
+        return reinterpret_cast<T *>(p);
+    }
+
     inline sharedOpt<Node> operator||(sharedOpt<Node> a, sharedOpt<Node> b) {
         if (a) return a;
         return b;
@@ -1419,8 +1478,8 @@ namespace tr {
 #define UnionProperty(name, Types...) shared<Node> name = make_shared<FIRST_ARG((Types))>()
 #define OptionalUnionProperty(name, Types...) sharedOpt<Node> name
 
-//Parent properties can not have initializer as it would lead to circular ref. We expect from the user to set it where required.
-#define ParentProperty(Types...) shared<UnionNode<Types>> parent
+//Parent properties only document the possible parents. The parent itself is the non-owning Node::parent, set where required.
+#define ParentProperty(Types...) using ParentTypes = UnionNode<Types>
 #define Property(name, Type) shared<Type> name = make_shared<Type>()
 #define OptionalProperty(name, Type) sharedOpt<Type> name
 
@@ -1447,7 +1506,7 @@ namespace tr {
     struct PrimaryExpression: MemberExpression {};
 
     struct PrivateIdentifier: BrandKind<SyntaxKind::PrivateIdentifier, PrimaryExpression> {
-        string escapedText;
+        string_view escapedText;
     };
 
     template<SyntaxKind T>
@@ -1563,7 +1622,8 @@ namespace tr {
     struct ModifiersArray: NodeTypeArray(Modifier) {};
 
     struct LiteralLike: PrimaryExpression {
-        std::string text;
+        //a view into the source or an escaped copy owned by the SourceFile, see Factory::store()
+        string_view text;
         optional<bool> isUnterminated;
         optional<bool> hasExtendedUnicodeEscape;
     };
@@ -1601,8 +1661,11 @@ namespace tr {
         /**
          * This is called `escaped` because in TS compiler they prefixed it with __ because of naming issues with __proto__, etc,
          * so regular objects can be used as hash map. We do not need that. `escapedText` is thus just the text, not escaped at all.
+         *
+         * Like LiteralLike::text a view into the source, valid as long as the SourceFile lives.
          */
-        string escapedText;
+        string_view escapedText;
+        unsigned int atom = 0; //id in SourceFile::atoms, 0 if not created by the parser
         optional<SyntaxKind> originalKeywordKind;// Original syntaxKind which get set so that we can report an error later
 
         optional<bool> isInJSDocNamespace;
@@ -1634,6 +1697,8 @@ namespace tr {
     struct Block: BrandKind<SyntaxKind::Block, Statement> {
         shared<NodeTypeArray(Statement)> statements;
         /*@internal*/ bool multiLine;
+        //context flags of a function body skipped by Parser::lazyBodies, statements is empty until Parser::parseLazyBody()
+        optional<int> lazy;
     };
 
     struct TemplateLiteralLike: LiteralLike {
@@ -1760,7 +1825,7 @@ namespace tr {
     struct DefaultClause;
 
     struct CaseBlock: BrandKind<SyntaxKind::CaseBlock, Node> {
-        shared<SwitchStatement> parent;
+        ParentProperty(SwitchStatement);
         shared<NodeTypeArray(CaseClause, DefaultClause)> clauses;
     };
 
@@ -1771,13 +1836,13 @@ namespace tr {
     };
 
     struct CaseClause: BrandKind<SyntaxKind::CaseClause, Node> {
-        Property(parent, CaseBlock);
+        ParentProperty(CaseBlock);
         Property(expression, Expression);
         shared<NodeTypeArray(Statement)> statements;
     };
 
     struct DefaultClause: BrandKind<SyntaxKind::DefaultClause, Node> {
-        shared<CaseBlock> parent;
+        ParentProperty(CaseBlock);
         shared<NodeTypeArray(Statement)> statements;
     };
 
@@ -1849,7 +1914,7 @@ namespace tr {
     };
 
     struct CatchClause: BrandKind<SyntaxKind::CatchClause, Node> {
-        shared<TryStatement> parent;
+        ParentProperty(TryStatement);
         OptionalProperty(variableDeclaration, VariableDeclaration);
         Property(block, Block);
     };
@@ -2072,7 +2137,7 @@ namespace tr {
     };
 
     struct EnumMember: BrandKind<SyntaxKind::EnumMember, NamedDeclaration, Node> {
-        Property(parent, EnumDeclaration);
+        ParentProperty(EnumDeclaration);
         // This does include ComputedPropertyName, but the parser will give an error
         // if it parses a ComputedPropertyName in an EnumMember
         UnionProperty(name, PropertyName);
@@ -2110,7 +2175,7 @@ namespace tr {
     };
 
     struct ModuleBlock: BrandKind<SyntaxKind::ModuleBlock, Statement> {
-        shared<ModuleDeclaration> parent;
+        ParentProperty(ModuleDeclaration);
         shared<NodeTypeArray(Statement)> statements;
     };
 
@@ -2139,8 +2204,8 @@ namespace tr {
         sharedOpt<NodeUnion(ModuleReference)> moduleReference;
     };
 
-    struct ExternalModuleReference: BrandKind<SyntaxKind::ImportEqualsDeclaration, Node> {
-        Property(parent, ImportEqualsDeclaration);
+    struct ExternalModuleReference: BrandKind<SyntaxKind::ExternalModuleReference, Node> {
+        ParentProperty(ImportEqualsDeclaration);
         Property(expression, Expression);
     };
 
@@ -2148,20 +2213,20 @@ namespace tr {
 
     struct ImportClause;
     struct NamespaceImport: BrandKind<SyntaxKind::NamespaceImport, NamedDeclaration, Node> {
-        shared<ImportClause> parent;
+        ParentProperty(ImportClause);
         Property(name, Identifier);
     };
 
     struct NamedImports;
     struct ImportSpecifier: BrandKind<SyntaxKind::ImportSpecifier, NamedDeclaration, Node> {
-        shared<NamedImports> parent;
+        ParentProperty(NamedImports);
         OptionalProperty(propertyName, Identifier);  // Name preceding "as" keyword (or undefined when "as" is absent)
         Property(name, Identifier);           // Declared name
         bool isTypeOnly;
     };
 
     struct NamedImports: BrandKind<SyntaxKind::NamedImports, Node> {
-        shared<ImportClause> parent;
+        ParentProperty(ImportClause);
         shared<NodeTypeArray(ImportSpecifier)> elements;
     };
 
@@ -2172,7 +2237,7 @@ namespace tr {
 
     struct AssertClause;
     struct AssertEntry: BrandKind<SyntaxKind::AssertEntry, Node> {
-        shared<AssertClause> parent;
+        ParentProperty(AssertClause);
         UnionProperty(name, AssertionKey);
         Property(value, Expression);
     };
@@ -2210,20 +2275,20 @@ namespace tr {
     };
 
     struct NamespaceExport: BrandKind<SyntaxKind::NamespaceExport, NamedDeclaration, Node> {
-        shared<ExportDeclaration> parent;
+        ParentProperty(ExportDeclaration);
         Property(name, Identifier);
     };
 
     struct NamedExports;
     struct ExportSpecifier: BrandKind<SyntaxKind::ExportSpecifier, NamedDeclaration, Node> {
-        shared<NamedExports> parent;
+        ParentProperty(NamedExports);
         bool isTypeOnly;
         OptionalProperty(propertyName, Identifier);  // Name preceding "as" keyword (or undefined when "as" is absent)
         Property(name, Identifier);           // Declared name
     };
 
     struct NamedExports: BrandKind<SyntaxKind::NamedExports, Node> {
-        shared<ExportDeclaration> parent;
+        ParentProperty(ExportDeclaration);
         shared<NodeTypeArray(ExportSpecifier)> elements;
     };
 
@@ -2274,7 +2339,7 @@ namespace tr {
  * Unless `isExportEquals` is set, this node was parsed as an `export default`.
  */
     struct ExportAssignment: BrandKind<SyntaxKind::ExportAssignment, DeclarationStatement> {
-        shared<SourceFile> parent;
+        ParentProperty(SourceFile);
         bool isExportEquals;
         Property(expression, Expression);
     };
@@ -2282,7 +2347,7 @@ namespace tr {
     struct ImportTypeNode;
 
     struct ImportTypeAssertionContainer: BrandKind<SyntaxKind::ImportTypeAssertionContainer, Node> {
-        shared<ImportTypeNode> parent;
+        ParentProperty(ImportTypeNode);
         Property(assertClause, AssertClause);
         bool multiLine = false;
     };
@@ -2306,13 +2371,13 @@ namespace tr {
 #define ObjectTypeDeclaration ClassLikeDeclaration, InterfaceDeclaration, TypeLiteralNode
 
     struct MethodSignature: BrandKind<SyntaxKind::MethodSignature, SignatureDeclarationBase, TypeElement, Node> {
-        shared<NodeUnion(ObjectTypeDeclaration)> parent;
+        ParentProperty(NodeUnion(ObjectTypeDeclaration));
         UnionProperty(name, PropertyName);
     };
 
     struct IndexSignatureDeclaration: BrandKind<SyntaxKind::IndexSignature, SignatureDeclarationBase, ClassElement, TypeElement, Node> {
         using TypeElement::name;
-        shared<NodeUnion(ObjectTypeDeclaration)> parent;
+        ParentProperty(NodeUnion(ObjectTypeDeclaration));
 //        sharedOpt<NodeTypeArray(Decorator)> decorators;           // Array of decorators (in document order)
 //        sharedOpt<NodeTypeArray(Modifier)> modifiers;            // Array of modifiers
         Property(type, TypeNode);
@@ -2351,7 +2416,7 @@ namespace tr {
 
     struct ConstructorDeclaration: BrandKind<SyntaxKind::Constructor, FunctionLikeDeclarationBase, ClassElement, Node> {
         using ClassElement::name;
-        shared<NodeUnion(ClassLikeDeclaration)> parent;
+        ParentProperty(NodeUnion(ClassLikeDeclaration));
         OptionalProperty(body, FunctionBody);
 
         /* @internal */ sharedOpt<NodeTypeArray(TypeParameterDeclaration)> typeParameters; // Present for use with reporting a grammar error
@@ -2536,7 +2601,7 @@ namespace tr {
     };
 
     struct TemplateMiddle: BrandKind<SyntaxKind::TemplateMiddle, TemplateLiteralLike> {
-        shared<NodeUnion(TemplateSpan, TemplateLiteralTypeSpan)> parent;
+        ParentProperty(NodeUnion(TemplateSpan, TemplateLiteralTypeSpan));
         /* @internal */
         optional<types::TokenFlags> templateFlags;
     };
@@ -2548,7 +2613,7 @@ namespace tr {
     };
 
     struct TemplateLiteralTypeSpan: BrandKind<SyntaxKind::TemplateLiteralTypeSpan, TypeNode> {
-        shared<TemplateLiteralTypeNode> parent;
+        ParentProperty(TemplateLiteralTypeNode);
         Property(type, TypeNode);
         UnionProperty(literal, TemplateMiddle, TemplateTail);
     };
@@ -2573,7 +2638,7 @@ namespace tr {
     };
 
     struct TemplateSpan: BrandKind<SyntaxKind::TemplateSpan, Node> {
-        Property(parent, TemplateExpression);
+        ParentProperty(TemplateExpression);
         Property(expression, Expression);
         UnionProperty(literal, TemplateMiddle, TemplateTail);
     };
@@ -2697,32 +2762,32 @@ namespace tr {
     };
 
     struct JsxAttribute: BrandKind<SyntaxKind::JsxAttribute, ObjectLiteralElement, Node> {
-        shared<JsxAttributes> parent;
+        ParentProperty(JsxAttributes);
         Property(name, Identifier);
         /// JSX attribute initializers are optional; <X y /> is sugar for <X y={true} />
         OptionalUnionProperty(initializer, JsxAttributeValue);
     };
 
     struct JsxAttributes: BrandKind<SyntaxKind::JsxAttributes, PrimaryExpression> {
-        OptionalUnionProperty(parent, JsxOpeningLikeElement);
+        ParentProperty(JsxOpeningLikeElement);
         shared<NodeTypeArray(JsxAttributeLike)> properties;
     };
 
     // The opening element of a <Tag>...</Tag> JsxElement
     struct JsxOpeningElement: BrandKind<SyntaxKind::JsxOpeningElement, Expression> {
-        shared<JsxElement> parent;
+        ParentProperty(JsxElement);
         UnionProperty(tagName, JsxTagNameExpression);
         sharedOpt<NodeTypeArray(TypeNode)> typeArguments;
         Property(attributes, JsxAttributes);
     };
 
     struct JsxText: BrandKind<SyntaxKind::JsxText, LiteralLike> {
-        shared<NodeUnion(JsxElement, JsxFragment)> parent;
+        ParentProperty(NodeUnion(JsxElement, JsxFragment));
         bool containsOnlyTriviaWhiteSpaces;
     };
 
     struct JsxClosingElement: BrandKind<SyntaxKind::JsxClosingElement, Node> {
-        shared<JsxElement> parent;
+        ParentProperty(JsxElement);
         UnionProperty(tagName, JsxTagNameExpression);
     };
 
@@ -2748,12 +2813,12 @@ namespace tr {
     struct JsxFragment;
     /// The opening element of a <>...</> JsxFragment
     struct JsxOpeningFragment: BrandKind<SyntaxKind::JsxOpeningFragment, Expression> {
-        shared<JsxFragment> parent;
+        ParentProperty(JsxFragment);
     };
 
     /// The closing element of a <>...</> JsxFragment
     struct JsxClosingFragment: BrandKind<SyntaxKind::JsxClosingFragment, Expression> {
-        shared<JsxFragment> parent;
+        ParentProperty(JsxFragment);
     };
 
     /// A JSX expression of the form <>...</>
@@ -2764,7 +2829,7 @@ namespace tr {
     };
 
     struct JsxSpreadAttribute: BrandKind<SyntaxKind::JsxSpreadAttribute, ObjectLiteralElement, Node> {
-        Property(parent, JsxAttributes);
+        ParentProperty(JsxAttributes);
         Property(expression, Expression);
     };
 
@@ -2781,7 +2846,7 @@ namespace tr {
 //    using ClassMemberModifier = NodeType<AccessibilityModifier, ReadonlyKeyword, StaticKeyword>;
 
     struct Decorator: BrandKind<SyntaxKind::Decorator, Node> {
-        Property(parent, NamedDeclaration);
+        ParentProperty(NamedDeclaration);
         Property(expression, Expression);
     };
 
@@ -2789,7 +2854,11 @@ namespace tr {
 
     struct SourceFile: BrandKind<SyntaxKind::SourceFile, Node> {
         string fileName;
-        string text;
+        string_view text; //owned by the arena of the file or a mapping retained by it, see Parser::initializeState()
+        AtomTable atoms; //all identifier texts of the file, see Identifier::atom
+        std::shared_ptr<Arena> arena; //all nodes of the file, also the ones parsed later (see Parser::parseLazyBody())
+        bool hasBeenIncrementallyParsed = false; //nodes were moved into a new file, see Parser::updateSourceFile()
+        unsigned int nestingDepth = 0; //at least the height of the tree, see Parser::finishNode() and releaseStatements()
 
         shared<NodeTypeArray(Statement)> statements;
         Property(endOfFileToken, EndOfFileToken);
@@ -2873,7 +2942,7 @@ namespace tr {
 //
 //        // File-level diagnostics reported by the parser (includes diagnostics about /// references
 //        // as well as code diagnostics).
-//        /* @internal */ parseDiagnostics: DiagnosticWithLocation[];
+        /* @internal */ vector<types::DiagnosticWithDetachedLocation> parseDiagnostics; //in source order, also of bodies parsed later (see Parser::parseLazyBody())
 //
 //        // File-level diagnostics reported by the binder.
 //        /* @internal */ bindDiagnostics: DiagnosticWithLocation[];
@@ -2912,5 +2981,9 @@ namespace tr {
 //        /* @internal */ exportedModulesFromDeclarationEmit?: ExportedModulesFromDeclarationEmit;
 //        /* @internal */ endFlowNode?: FlowNode;
 
+        //releases the nodes without recursion, see parser2.cpp
+        void releaseStatements();
+
+        ~SourceFile();
     };
 }
@@ -4,7 +4,7 @@
  * Note that an arbitrary `charCodeAt(text, position+1)` does not work since the current code point might be longer than one byte.
  * We probably should introduction `int position, int offset` so that `charCodeAt(text, position, 1)` returns the correct unicode code point.
  */
-tr::utf::CharCode tr::utf::charCodeAt(const std::string &text, int position, int *size) {
+tr::utf::CharCode tr::utf::decodeCharCode(std::string_view text, int position, int *size) {
     //from - https://stackoverflow.com/a/40054802/979328
     int length = 1;
     int first = text[position];
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <locale>
 #include <codecvt>
 
@@ -150,8 +151,20 @@ namespace tr::utf {
         int length;
     };
 
-    // Updates size if non-nullptr is given
-    CharCode charCodeAt(const std::string &text, int position, int *size = nullptr);
+    //the UTF-8 decoder, see charCodeAt()
+    CharCode decodeCharCode(std::string_view text, int position, int *size);
+
+    // Updates size if non-nullptr is given. Reading at the end yields 0 like the terminator of a std::string,
+    // since text can be a view without one (e.g. a memory-mapped file, see fileMap()).
+    inline CharCode charCodeAt(std::string_view text, int position, int *size = nullptr) {
+        //most source is ASCII, so only other bytes go through the decoder
+        unsigned char first = (std::size_t) position < text.size() ? text[position] : 0;
+        if (first <= CharacterCodes::maxAsciiCharacter) {
+            if (size != nullptr) *size = 1;
+            return {first, 1};
+        }
+        return decodeCharCode(text, position, size);
+    }
 
     std::string fromCharCode(int cp);
 
@@ -195,7 +208,7 @@ namespace tr::utf {
         return isWhiteSpaceSingleLine(ch) || isLineBreak(ch);
     }
 
-    inline unsigned int eatWhitespace(const std::string &text, unsigned int pos) {
+    inline unsigned int eatWhitespace(std::string_view text, unsigned int pos) {
         auto end = text.size();
         while (pos < end) {
             auto charCode = charCodeAt(text, pos);
@@ -30,27 +30,30 @@ namespace tr {
     /**
      * Gets a custom text range to use when emitting source maps.
      */
-    shared<SourceMapRange> getSourceMapRange(shared<Node> node) {
-        if (!node->emitNode) return node;
-        return node->emitNode->sourceMapRange;
+    shared<TextRange> getSourceMapRange(shared<Node> node) {
+        auto emitNode = node->getEmitNode();
+        if (!emitNode || !emitNode->sourceMapRange) return node;
+        return emitNode->sourceMapRange;
     }
     /**
      * Gets a custom text range to use when emitting comments.
      */
     shared<TextRange> getCommentRange(shared<Node> node) {
-        if (!node->emitNode) return node;
-        if (!node->emitNode->commentRange) return node;
-        return node->emitNode->commentRange;
+        auto emitNode = node->getEmitNode();
+        if (!emitNode || !emitNode->commentRange) return node;
+        return emitNode->commentRange;
     }
 
     optional<vector<SynthesizedComment>> getSyntheticLeadingComments(shared<Node> node) {
-        if (!node->emitNode) return nullopt;
-        return node->emitNode->leadingComments;
+        auto emitNode = node->getEmitNode();
+        if (!emitNode) return nullopt;
+        return emitNode->leadingComments;
     }
 
     optional<vector<SynthesizedComment>> getSyntheticTrailingComments(shared<Node> node) {
-        if (!node->emitNode) return nullopt;
-        return node->emitNode->trailingComments;
+        auto emitNode = node->getEmitNode();
+        if (!emitNode) return nullopt;
+        return emitNode->trailingComments;
     }
 
     bool positionIsSynthesized(int pos) {
@@ -323,17 +326,27 @@ namespace tr {
         //todo: Find generic way to logicalOrLastValue
 //        return getScriptKindFromFileName(fileName) || ScriptKind::TS;
     }
+    //`literal.templateFlags` of TS. The parser creates all template parts as TemplateLiteralLike
+    //(see Factory::createTemplateLiteralLikeNode()), so the flags are read there and not from TemplateHead etc.
+    static bool hasTemplateFlags(const shared<Node> &literal) {
+        switch (literal->kind) {
+            case SyntaxKind::NoSubstitutionTemplateLiteral:
+            case SyntaxKind::TemplateHead:
+            case SyntaxKind::TemplateMiddle:
+            case SyntaxKind::TemplateTail: return !!reinterpret_pointer_cast<TemplateLiteralLike>(literal)->templateFlags;
+            default: return false;
+        }
+    }
+
     /** @internal */
     bool hasInvalidEscape(shared<NodeUnion(TemplateLiteralTypes)> templateLiteral) {
         if (isNoSubstitutionTemplateLiteral(templateLiteral)) {
-            return !!to<NoSubstitutionTemplateLiteral>(templateLiteral)->templateFlags;
+            return hasTemplateFlags(templateLiteral);
         }
 
-        return !!to<TemplateExpression>(templateLiteral)->head->templateFlags
+        return hasTemplateFlags(to<TemplateExpression>(templateLiteral)->head)
                || some<TemplateSpan>(to<TemplateExpression>(templateLiteral)->templateSpans, [](shared<TemplateSpan> span) {
-            if (span->literal->kind == SyntaxKind::TemplateTail) return !!to<TemplateTail>(span->literal)->templateFlags;
-            if (span->literal->kind == SyntaxKind::TemplateMiddle) return !!to<TemplateMiddle>(span->literal)->templateFlags;
-            return false;
+            return hasTemplateFlags(span->literal);
         });
 
 //        return templateLiteral && !!(isNoSubstitutionTemplateLiteral(templateLiteral)
@@ -598,7 +611,7 @@ namespace tr {
         return !nodeIsMissing(node);
     }
 
-    string getTextOfNodeFromSourceText(string &sourceText, shared<Node> node, bool includeTrivia) {
+    string getTextOfNodeFromSourceText(string_view sourceText, shared<Node> node, bool includeTrivia) {
         if (nodeIsMissing(node)) {
             return "";
         }
@@ -630,7 +643,7 @@ namespace tr {
     }
 
     string idText(shared<NodeUnion(Identifier | PrivateIdentifier)> identifierOrPrivateName) {
-        return unescapeLeadingUnderscores(getEscapedName(identifierOrPrivateName));
+        return unescapeLeadingUnderscores(string(getEscapedName(identifierOrPrivateName)));
     }
 
     shared<Expression> getLeftmostExpression(shared<Expression> node, bool stopAtCallExpressions) {
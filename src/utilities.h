@@ -51,7 +51,7 @@ namespace tr {
     /**
      * Gets a custom text range to use when emitting source maps.
      */
-    shared<SourceMapRange> getSourceMapRange(shared<Node> node);
+    shared<TextRange> getSourceMapRange(shared<Node> node);
 
     /**
      * Gets a custom text range to use when emitting comments.
@@ -361,7 +361,7 @@ namespace tr {
 
     bool nodeIsPresent(sharedOpt<Node> node);
 
-    string getTextOfNodeFromSourceText(string &sourceText, shared<Node> node, bool includeTrivia = false);
+    string getTextOfNodeFromSourceText(string_view sourceText, shared<Node> node, bool includeTrivia = false);
 
     int getFullWidth(shared<Node> node);
 
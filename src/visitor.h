@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include "types.h"
+#include "parser2.h"
+
+namespace tr {
+    enum class VisitResult {
+        Continue, //visit the children
+        Skip, //do not visit the children, the post hook is still called
+        Stop, //end the walk
+    };
+
+    inline VisitResult noVisit(const shared<Node> &, unsigned int) {
+        return VisitResult::Continue;
+    }
+
+    /**
+     * Depth-first walk over the AST with an explicit stack instead of recursion, so arbitrarily deep trees
+     * (e.g. `string[][]...` with thousands of `[]`, which the parser builds in a loop) do not overflow the native stack.
+     *
+     * `pre(node, depth)` is called before the children of a node and `post(node, depth)` after them, depth of `root` is 0.
+     * Children are visited in source order (see forEachChild()). Both return a VisitResult, pre can skip the children
+     * of a node and both can stop the walk. Hooks are template parameters, so they are inlined like the callbacks
+     * of forEachChild(). Returns false when stopped.
+     */
+    template<typename Pre, typename Post = decltype(&noVisit)>
+    bool walk(const shared<Node> &root, const Pre &pre, const Post &post = noVisit) {
+        struct Frame {
+            shared<Node> node;
+            unsigned int depth;
+            bool entered;
+        };
+        std::vector<Frame> stack;
+        stack.push_back({root, 0, false});
+
+        while (!stack.empty()) {
+            auto &frame = stack.back();
+            if (frame.entered) {
+                auto node = std::move(frame.node);
+                auto depth = frame.depth;
+                stack.pop_back();
+                if (post(node, depth) == VisitResult::Stop) return false;
+                continue;
+            }
+
+            frame.entered = true;
+            auto result = pre(frame.node, frame.depth);
+            if (result == VisitResult::Stop) return false;
+            if (result == VisitResult::Skip) continue;
+
+            //frame is invalidated by the pushes
+            auto node = frame.node;
+            auto depth = frame.depth + 1;
+            auto first = stack.size();
+            forEachChild(node, [&stack, depth](const shared<Node> &child) -> sharedOpt<Node> {
+                stack.push_back({child, depth, false});
+                return nullptr;
+            }, nullptr);
+            //last pushed is visited first, so reverse to keep the source order
+            std::reverse(stack.begin() + first, stack.end());
+        }
+        return true;
+    }
+
+    /**
+     * Hooks for walk() looked up by SyntaxKind in a table, so dispatch is one indexed load instead of a switch
+     * or if/else chain over the kinds. Kinds without hook get `fallback`, or continue the walk when there is none.
+     *
+     *     KindTable<Context> table;
+     *     table.on(SyntaxKind::Identifier, [](Context &context, const shared<Node> &node, unsigned int depth) { ...; return VisitResult::Continue; });
+     *     walk(file, [&](const shared<Node> &node, unsigned int depth) { return table(context, node, depth); });
+     */
+    template<typename Context>
+    class KindTable {
+    public:
+        using Hook = VisitResult (*)(Context &context, const shared<Node> &node, unsigned int depth);
+
+    private:
+        std::array<Hook, (std::size_t) SyntaxKind::Count> hooks{};
+        Hook fallback = nullptr;
+
+    public:
+        KindTable &on(SyntaxKind kind, Hook hook) {
+            hooks[(std::size_t) kind] = hook;
+            return *this;
+        }
+
+        KindTable &otherwise(Hook hook) {
+            fallback = hook;
+            return *this;
+        }
+
+        VisitResult operator()(Context &context, const shared<Node> &node, unsigned int depth) const {
+            auto hook = hooks[(std::size_t) node->kind];
+            if (!hook) hook = fallback;
+            return hook ? hook(context, node, depth) : VisitResult::Continue;
+        }
+    };
+}